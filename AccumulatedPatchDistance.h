@@ -0,0 +1,68 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef AccumulatedPatchDistance_H
+#define AccumulatedPatchDistance_H
+
+// ITK
+#include "itkImageRegion.h"
+
+/** Computes the distance between one pair of patches from their pixels, which are handed to it one pair of rows
+  * at a time. FusedDistanceEvaluator uses these to compute several distances that read the same image in a
+  * single pass over the pixels.
+  */
+template <typename TImage>
+class PatchDistanceAccumulator
+{
+public:
+
+  /** Destructor. */
+  virtual ~PatchDistanceAccumulator(){}
+
+  /** Get the image whose pixels have to be accumulated. */
+  virtual const TImage* GetImage() const = 0;
+
+  /** Start a new pair of patches. */
+  virtual void Begin() = 0;
+
+  /** Add a row of the source patch and the corresponding row of the target patch. */
+  virtual void AddRow(const typename TImage::PixelType* const sourceRow,
+                      const typename TImage::PixelType* const targetRow, const unsigned int numberOfPixels) = 0;
+
+  /** Get the distance of the rows added since Begin(), the same value as Distance(sourceRegion, targetRegion). */
+  virtual float GetDistance() const = 0;
+};
+
+/** An interface for PatchDistance functors that can be computed by a PatchDistanceAccumulator.
+  * FusedDistanceEvaluator checks for this interface with dynamic_cast, like BoundedPatchDistance.
+  */
+template <typename TImage>
+class AccumulatedPatchDistance
+{
+public:
+
+  /** Destructor. */
+  virtual ~AccumulatedPatchDistance(){}
+
+  /** Create an accumulator for this distance. The caller owns it. It reads the settings (such as the image) of the
+    * functor when it is used, so it stays valid when they are changed. */
+  virtual PatchDistanceAccumulator<TImage>* CreateAccumulator() = 0;
+};
+
+#endif
@@ -0,0 +1,316 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+// ITK
+#include "itkImage.h"
+#include "itkImageFileReader.h"
+
+// STL
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Submodules
+#include "PatchComparison/Mask/ITKHelpers/ITKHelpers.h"
+#include "PatchComparison/Mask/Mask.h"
+
+// Custom
+#include "CachedHistogramDistance.h"
+#include "DerivedImageCache.h"
+#include "IntegralHistogramCache.h"
+#include "LabSSD.h"
+#include "MatchPairFile.h"
+#include "PairWriter.h"
+#include "ParallelSelfPatchCompare.h"
+#include "PartialSSD.h"
+
+typedef itk::Image<itk::CovariantVector<unsigned char, 3>, 2> ImageType;
+
+/** The centers of the hole pixels that have a valid 4-neighbor, in raster order. */
+static std::vector<itk::Index<2> > FindBoundaryPixels(const Mask* const mask)
+{
+  const itk::ImageRegion<2> fullRegion = mask->GetLargestPossibleRegion();
+  const itk::Offset<2> neighborOffsets[4] = {{{-1, 0}}, {{1, 0}}, {{0, -1}}, {{0, 1}}};
+
+  std::vector<itk::Index<2> > boundaryPixels;
+  for(itk::IndexValueType row = fullRegion.GetIndex()[1]; row <= fullRegion.GetUpperIndex()[1]; ++row)
+  {
+    for(itk::IndexValueType column = fullRegion.GetIndex()[0]; column <= fullRegion.GetUpperIndex()[0]; ++column)
+    {
+      itk::Index<2> pixel = {{column, row}};
+      if(mask->IsValid(pixel))
+      {
+        continue;
+      }
+
+      for(unsigned int neighborId = 0; neighborId < 4; ++neighborId)
+      {
+        itk::Index<2> neighbor = pixel + neighborOffsets[neighborId];
+        if(fullRegion.IsInside(neighbor) && mask->IsValid(neighbor))
+        {
+          boundaryPixels.push_back(pixel);
+          break;
+        }
+      }
+    }
+  }
+
+  return boundaryPixels;
+}
+
+/** Read the target centers, one "x y" per line. */
+static std::vector<itk::Index<2> > ReadTargetCenters(const std::string& fileName)
+{
+  std::ifstream fileStream(fileName.c_str());
+  if(!fileStream)
+  {
+    throw std::runtime_error("Could not open " + fileName + "!");
+  }
+
+  std::vector<itk::Index<2> > targetCenters;
+  std::string line;
+  while(std::getline(fileStream, line))
+  {
+    std::stringstream ss(line);
+    itk::Index<2> center;
+    if(ss >> center[0] >> center[1])
+    {
+      targetCenters.push_back(center);
+    }
+  }
+
+  return targetCenters;
+}
+
+/** A command line (no GUI, no X server) version of the top patches search. For each target patch it finds the
+  * best matching source patches (entirely in the valid part of the mask) with ParallelSelfPatchCompare, which uses
+  * all of the cores, and writes all of the (target, source) pairs and their scores to the binary pair file
+  * (MatchPairFile) that ViewAllMatches maps.
+  * The targets are the patches centered on the boundary of the hole (the hole pixels that have a valid
+  * 4-neighbor), or the centers listed in a file (one "x y" per line).
+  * The search can be any backend of ParallelSelfPatchCompare; the PatchMatch nearest neighbor field is computed
+  * for the first target and then reused for all of the others.
+  * If the output file name ends with ".txt", the pair centers are written as text with PairWriter instead (without
+  * the scores).
+  */
+
+int main(int argc, char** argv)
+{
+  if(argc < 6 || argc > 11)
+  {
+    std::cerr << "Required arguments: image.png mask.png patchRadius numberOfMatches output.pairs "
+                 "[distance (SSD, LabSSD, or HSVHistogram; default SSD)] "
+                 "[targets.txt (- for the boundary of the hole, the default)] "
+                 "[search (Exhaustive, FFT, PatchMatch, PCA, or Pyramid; default Exhaustive)] "
+                 "[patchMatchIterations (default 5)] [randomSeed (default 0)]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::stringstream ss;
+  for(int i = 1; i < 6; ++i)
+  {
+    ss << argv[i] << " ";
+  }
+
+  std::string imageFileName;
+  std::string maskFileName;
+  unsigned int patchRadius;
+  unsigned int numberOfMatches;
+  std::string outputFileName;
+  ss >> imageFileName >> maskFileName >> patchRadius >> numberOfMatches >> outputFileName;
+  if(ss.fail() || numberOfMatches == 0)
+  {
+    std::cerr << "The patch radius and number of matches must be positive integers!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string distanceName = (argc > 6) ? argv[6] : "SSD";
+  std::string targetsFileName = (argc > 7) ? argv[7] : "-";
+  std::string searchName = (argc > 8) ? argv[8] : "Exhaustive";
+
+  std::stringstream patchMatchStream;
+  patchMatchStream << ((argc > 9) ? argv[9] : "5") << " " << ((argc > 10) ? argv[10] : "0");
+  unsigned int patchMatchIterations;
+  unsigned int randomSeed;
+  patchMatchStream >> patchMatchIterations >> randomSeed;
+  if(patchMatchStream.fail() || patchMatchIterations == 0)
+  {
+    std::cerr << "The number of PatchMatch iterations must be a positive integer and the random seed a "
+                 "non-negative integer!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The names are in the same order as ParallelSelfPatchCompare::BackendEnum.
+  const char* searchNames[] = {"Exhaustive", "FFT", "PatchMatch", "PCA", "Pyramid"};
+  const unsigned int numberOfSearchNames = sizeof(searchNames) / sizeof(searchNames[0]);
+  unsigned int searchId = 0;
+  while(searchId < numberOfSearchNames && searchName != searchNames[searchId])
+  {
+    ++searchId;
+  }
+  if(searchId == numberOfSearchNames)
+  {
+    std::cerr << "Unknown search " << searchName << "! Use Exhaustive, FFT, PatchMatch, PCA, or Pyramid."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "imageFileName: " << imageFileName << std::endl;
+  std::cout << "maskFileName: " << maskFileName << std::endl;
+  std::cout << "patchRadius: " << patchRadius << std::endl;
+  std::cout << "numberOfMatches: " << numberOfMatches << std::endl;
+  std::cout << "outputFileName: " << outputFileName << std::endl;
+  std::cout << "distance: " << distanceName << std::endl;
+  std::cout << "search: " << searchName << std::endl;
+
+  typedef itk::ImageFileReader<ImageType> ReaderType;
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(imageFileName);
+  reader->Update();
+
+  ImageType::Pointer image = ImageType::New();
+  ITKHelpers::DeepCopy(reader->GetOutput(), image.GetPointer());
+
+  Mask::Pointer mask = Mask::New();
+  mask->Read(maskFileName);
+  if(mask->GetLargestPossibleRegion() != image->GetLargestPossibleRegion())
+  {
+    std::cerr << "The image and mask must be the same size!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The images the distances read are derived from the image once, up front.
+  DerivedImageCache<ImageType> derivedImages;
+  derivedImages.SetImage(image);
+  IntegralHistogramCache<ImageType> histogramCache;
+
+  PatchDistance<ImageType>* distanceFunctor = NULL;
+  if(distanceName == "SSD")
+  {
+    distanceFunctor = new PartialSSD<ImageType>;
+    distanceFunctor->SetImage(image);
+  }
+  else if(distanceName == "LabSSD")
+  {
+    LabSSD<ImageType>* labSSDFunctor = new LabSSD<ImageType>;
+    labSSDFunctor->SetImage(image);
+    labSSDFunctor->SetLabImage(derivedImages.GetFloatLabImage());
+    distanceFunctor = labSSDFunctor;
+  }
+  else if(distanceName == "HSVHistogram")
+  {
+    // The integral histograms are built by the first search.
+    histogramCache.SetImage(derivedImages.GetHSVImage());
+
+    CachedHistogramDistance<ImageType>* histogramFunctor = new CachedHistogramDistance<ImageType>;
+    histogramFunctor->SetImage(derivedImages.GetHSVImage());
+    histogramFunctor->SetHistogramCache(&histogramCache);
+    distanceFunctor = histogramFunctor;
+  }
+  else
+  {
+    std::cerr << "Unknown distance " << distanceName << "! Use SSD, LabSSD, or HSVHistogram." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<itk::Index<2> > targetCenters = (targetsFileName == "-") ?
+                                              FindBoundaryPixels(mask) : ReadTargetCenters(targetsFileName);
+  std::cout << "There are " << targetCenters.size() << " targets." << std::endl;
+
+  ParallelSelfPatchCompare<ImageType> selfPatchCompare;
+  selfPatchCompare.SetImage(image);
+  selfPatchCompare.SetMask(mask);
+  selfPatchCompare.SetPatchDistanceFunctor(distanceFunctor);
+  selfPatchCompare.SetNumberOfPatchesToKeep(numberOfMatches);
+  selfPatchCompare.SetBackend(static_cast<ParallelSelfPatchCompare<ImageType>::BackendEnum>(searchId));
+  selfPatchCompare.SetPatchMatchIterations(patchMatchIterations);
+  selfPatchCompare.SetRandomSeed(randomSeed);
+
+  std::vector<PairWriter::PairType> pairs;
+  std::vector<float> scores;
+  unsigned int numberOfSkippedTargets = 0;
+  unsigned int numberOfExhaustiveTargets = 0;
+  std::string fallbackReason;
+  for(size_t targetId = 0; targetId < targetCenters.size(); ++targetId)
+  {
+    itk::ImageRegion<2> targetRegion = ITKHelpers::GetRegionInRadiusAroundPixel(targetCenters[targetId], patchRadius);
+    if(!image->GetLargestPossibleRegion().IsInside(targetRegion))
+    {
+      ++numberOfSkippedTargets;
+      continue;
+    }
+
+    selfPatchCompare.SetTargetRegion(targetRegion);
+    selfPatchCompare.ComputePatchScores();
+    if(selfPatchCompare.GetUsedBackend() != selfPatchCompare.GetBackend())
+    {
+      ++numberOfExhaustiveTargets;
+      fallbackReason = selfPatchCompare.GetFallbackReason();
+    }
+
+    const std::vector<ParallelSelfPatchCompare<ImageType>::PatchDataType>& patchData = selfPatchCompare.GetPatchData();
+    for(size_t matchId = 0; matchId < patchData.size(); ++matchId)
+    {
+      pairs.push_back(PairWriter::PairType(targetRegion, patchData[matchId].first));
+      scores.push_back(patchData[matchId].second);
+    }
+
+    if((targetId + 1) % 100 == 0)
+    {
+      std::cout << "Finished " << targetId + 1 << " of " << targetCenters.size() << " targets." << std::endl;
+    }
+  }
+
+  if(numberOfSkippedTargets > 0)
+  {
+    std::cout << "Skipped " << numberOfSkippedTargets << " targets whose patch is not entirely inside the image."
+              << std::endl;
+  }
+
+  if(numberOfExhaustiveTargets > 0)
+  {
+    std::cout << "Searched " << numberOfExhaustiveTargets << " targets exhaustively instead: " << fallbackReason
+              << std::endl;
+  }
+
+  const std::string textExtension = ".txt";
+  if(outputFileName.size() >= textExtension.size() &&
+     outputFileName.compare(outputFileName.size() - textExtension.size(), textExtension.size(), textExtension) == 0)
+  {
+    PairWriter::Write(outputFileName, pairs);
+  }
+  else
+  {
+    std::vector<MatchPairFile::Record> records(pairs.size());
+    for(size_t pairId = 0; pairId < pairs.size(); ++pairId)
+    {
+      records[pairId] = MatchPairFile::MakeRecord(pairs[pairId], scores[pairId]);
+    }
+    MatchPairFile::Write(outputFileName, patchRadius, records);
+  }
+  std::cout << "Wrote " << pairs.size() << " pairs to " << outputFileName << std::endl;
+
+  delete distanceFunctor;
+
+  return EXIT_SUCCESS;
+}
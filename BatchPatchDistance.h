@@ -0,0 +1,59 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef BatchPatchDistance_H
+#define BatchPatchDistance_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// Submodules
+#include "PatchComparison/PatchDistance.h"
+
+/** An interface for PatchDistance functors that can compare one target patch to many source patches in a single
+  * call. Work that only depends on the target (copying its pixels, computing its histogram or statistics) is then
+  * done once per call instead of once per source patch, and there is one virtual call per batch instead of one per
+  * source. ParallelSelfPatchCompare checks for this interface with dynamic_cast, like BoundedPatchDistance.
+  */
+template <typename TImage>
+class BatchPatchDistance
+{
+public:
+
+  /** Destructor. */
+  virtual ~BatchPatchDistance(){}
+
+  /** Compute the distance between the target region and the region of the same size at each of the
+    * 'numberOfSources' source corners, and write them to 'distances'. The distance of a source is the same value
+    * Distance(sourceRegion, targetRegion) returns, except that if it is larger than 'bound' some (other) value larger
+    * than 'bound' may be written (see BoundedPatchDistance). Use the largest float as the bound for exact
+    * distances. */
+  virtual void BatchDistance(const itk::ImageRegion<2>& targetRegion, const itk::Index<2>* const sourceCorners,
+                             const unsigned int numberOfSources, const float bound, float* const distances) = 0;
+
+  /** Compute a batch of distances with any functor. This uses BatchDistance() if the functor implements this
+    * interface, and calls Distance() for each source otherwise. */
+  static void ComputeDistances(PatchDistance<TImage>* const functor, const itk::ImageRegion<2>& targetRegion,
+                               const itk::Index<2>* const sourceCorners, const unsigned int numberOfSources,
+                               const float bound, float* const distances);
+};
+
+#include "BatchPatchDistance.hpp"
+
+#endif
@@ -0,0 +1,47 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef BatchPatchDistance_HPP
+#define BatchPatchDistance_HPP
+
+#include "BatchPatchDistance.h"
+
+template <typename TImage>
+void BatchPatchDistance<TImage>::ComputeDistances(PatchDistance<TImage>* const functor,
+                                                  const itk::ImageRegion<2>& targetRegion,
+                                                  const itk::Index<2>* const sourceCorners,
+                                                  const unsigned int numberOfSources, const float bound,
+                                                  float* const distances)
+{
+  BatchPatchDistance<TImage>* batchFunctor = dynamic_cast<BatchPatchDistance<TImage>*>(functor);
+  if(batchFunctor)
+  {
+    batchFunctor->BatchDistance(targetRegion, sourceCorners, numberOfSources, bound, distances);
+    return;
+  }
+
+  itk::ImageRegion<2> sourceRegion(targetRegion.GetSize());
+  for(unsigned int sourceId = 0; sourceId < numberOfSources; ++sourceId)
+  {
+    sourceRegion.SetIndex(sourceCorners[sourceId]);
+    distances[sourceId] = functor->Distance(sourceRegion, targetRegion);
+  }
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef BoundedPatchDistance_H
+#define BoundedPatchDistance_H
+
+// ITK
+#include "itkImageRegion.h"
+
+/** An interface for PatchDistance functors whose distance only grows as more pixels are visited (such as SSD),
+  * so that they can stop early once a candidate can no longer be one of the best patches.
+  * ParallelSelfPatchCompare checks for this interface with dynamic_cast and passes the score a candidate
+  * has to beat. The distances must be non-negative.
+  */
+template <typename TImage>
+class BoundedPatchDistance
+{
+public:
+
+  /** Destructor. */
+  virtual ~BoundedPatchDistance(){}
+
+  /** Compute the distance between two regions, stopping as soon as it is known to be larger than 'bound'.
+    * If the distance is <= bound, the exact distance (the same value as Distance()) is returned.
+    * Otherwise some value > bound is returned. */
+  virtual float BoundedDistance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2,
+                                const float bound) = 0;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef CachedAverageValueDifference_H
+#define CachedAverageValueDifference_H
+
+// Submodules
+#include "PatchComparison/PatchDistance.h"
+
+// Custom
+#include "BatchPatchDistance.h"
+#include "PatchStatisticsCache.h"
+
+/** The sum over the channels of the absolute difference between the means of the valid pixels of two patches.
+  * This is the cached counterpart of AverageValueDifference. It reads the means from a PatchStatisticsCache,
+  * so once its tables are built, it costs the same for any patch size. Single comparisons walk the two patches
+  * instead; the first BatchDistance() (i.e. the first search) builds the tables.
+  */
+template <typename TImage>
+class CachedAverageValueDifference : public PatchDistance<TImage>, public BatchPatchDistance<TImage>
+{
+public:
+
+  /** Constructor. */
+  CachedAverageValueDifference();
+
+  /** Set the cache to read the statistics from. */
+  void SetStatisticsCache(PatchStatisticsCache<TImage>* const statisticsCache);
+
+  /** Compute the difference between the means of the two regions. */
+  float Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2);
+
+  /** Compare the target to many sources. The means of the target are only read once. */
+  void BatchDistance(const itk::ImageRegion<2>& targetRegion, const itk::Index<2>* const sourceCorners,
+                     const unsigned int numberOfSources, const float bound, float* const distances);
+
+  /** Get the name of the distance. */
+  std::string GetDistanceName();
+
+private:
+
+  /** The cache to read the statistics from. */
+  PatchStatisticsCache<TImage>* StatisticsCache;
+};
+
+#include "CachedAverageValueDifference.hpp"
+
+#endif
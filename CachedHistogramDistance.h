@@ -0,0 +1,71 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef CachedHistogramDistance_H
+#define CachedHistogramDistance_H
+
+// Submodules
+#include "PatchComparison/PatchDistance.h"
+
+// Custom
+#include "BatchPatchDistance.h"
+#include "BoundedPatchDistance.h"
+#include "IntegralHistogramCache.h"
+
+/** The sum over the channels of the L1 difference between the normalized histograms of two patches.
+  * This plays the role of HistogramDistance, but reads the histograms from an IntegralHistogramCache, so a
+  * comparison costs a few lookups per bin instead of visiting every pixel of both patches. This makes it fast
+  * enough to compare against every source patch of an image. The cache is updated as needed: single comparisons
+  * only set up its bins, and the first batch (i.e. the first search) builds its tables.
+  */
+template <typename TImage>
+class CachedHistogramDistance : public PatchDistance<TImage>, public BoundedPatchDistance<TImage>,
+                                public BatchPatchDistance<TImage>
+{
+public:
+
+  /** Constructor. */
+  CachedHistogramDistance();
+
+  /** Set the cache to read the histograms from. */
+  void SetHistogramCache(IntegralHistogramCache<TImage>* const histogramCache);
+
+  /** Compute the difference between the histograms of the two regions. */
+  float Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2);
+
+  /** Compute the difference, stopping after the first channel at which it exceeds 'bound'. */
+  float BoundedDistance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2,
+                        const float bound);
+
+  /** Compare the target to many sources. The histograms of the target are only read once. */
+  void BatchDistance(const itk::ImageRegion<2>& targetRegion, const itk::Index<2>* const sourceCorners,
+                     const unsigned int numberOfSources, const float bound, float* const distances);
+
+  /** Get the name of the distance. */
+  std::string GetDistanceName();
+
+private:
+
+  /** The cache to read the histograms from. */
+  IntegralHistogramCache<TImage>* HistogramCache;
+};
+
+#include "CachedHistogramDistance.hpp"
+
+#endif
@@ -0,0 +1,127 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef CachedHistogramDistance_HPP
+#define CachedHistogramDistance_HPP
+
+#include "CachedHistogramDistance.h"
+
+// STL
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+template <typename TImage>
+CachedHistogramDistance<TImage>::CachedHistogramDistance() : HistogramCache(NULL)
+{
+}
+
+template <typename TImage>
+void CachedHistogramDistance<TImage>::SetHistogramCache(IntegralHistogramCache<TImage>* const histogramCache)
+{
+  this->HistogramCache = histogramCache;
+}
+
+template <typename TImage>
+float CachedHistogramDistance<TImage>::Distance(const itk::ImageRegion<2>& region1,
+                                                const itk::ImageRegion<2>& region2)
+{
+  return BoundedDistance(region1, region2, std::numeric_limits<float>::max());
+}
+
+template <typename TImage>
+float CachedHistogramDistance<TImage>::BoundedDistance(const itk::ImageRegion<2>& region1,
+                                                       const itk::ImageRegion<2>& region2, const float bound)
+{
+  if(!this->HistogramCache)
+  {
+    throw std::runtime_error("CachedHistogramDistance: Must call SetHistogramCache() before Distance()!");
+  }
+
+  // A few comparisons do not need the tables.
+  this->HistogramCache->UpdateBinRanges();
+
+  const unsigned int numberOfComponents = this->HistogramCache->GetNumberOfComponents();
+
+  double difference = 0;
+  for(unsigned int component = 0; component < numberOfComponents; ++component)
+  {
+    difference += this->HistogramCache->GetHistogramDifference(region1, region2, component);
+
+    // Every channel adds a non-negative amount, so the remaining channels cannot bring the sum back under the bound.
+    if(static_cast<float>(difference) > bound && component + 1 < numberOfComponents)
+    {
+      return std::numeric_limits<float>::infinity();
+    }
+  }
+
+  return difference;
+}
+
+template <typename TImage>
+void CachedHistogramDistance<TImage>::BatchDistance(const itk::ImageRegion<2>& targetRegion,
+                                                    const itk::Index<2>* const sourceCorners,
+                                                    const unsigned int numberOfSources, const float bound,
+                                                    float* const distances)
+{
+  if(!this->HistogramCache)
+  {
+    throw std::runtime_error("CachedHistogramDistance: Must call SetHistogramCache() before BatchDistance()!");
+  }
+
+  // A search compares against every source patch, so build the tables (once, the first time).
+  this->HistogramCache->Update();
+
+  const unsigned int numberOfComponents = this->HistogramCache->GetNumberOfComponents();
+
+  std::vector<std::vector<double> > targetHistograms(numberOfComponents);
+  for(unsigned int component = 0; component < numberOfComponents; ++component)
+  {
+    this->HistogramCache->GetNormalizedHistogram(targetRegion, component, targetHistograms[component]);
+  }
+
+  itk::ImageRegion<2> sourceRegion(targetRegion.GetSize());
+  for(unsigned int sourceId = 0; sourceId < numberOfSources; ++sourceId)
+  {
+    sourceRegion.SetIndex(sourceCorners[sourceId]);
+
+    // The same order of operations as BoundedDistance(), so the results are identical.
+    double difference = 0;
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      difference += this->HistogramCache->GetHistogramDifference(sourceRegion, targetHistograms[component],
+                                                                 component);
+      if(static_cast<float>(difference) > bound && component + 1 < numberOfComponents)
+      {
+        difference = std::numeric_limits<float>::infinity();
+        break;
+      }
+    }
+
+    distances[sourceId] = difference;
+  }
+}
+
+template <typename TImage>
+std::string CachedHistogramDistance<TImage>::GetDistanceName()
+{
+  return "Histogram Distance";
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef CachedVarianceDifference_HPP
+#define CachedVarianceDifference_HPP
+
+#include "CachedVarianceDifference.h"
+
+// STL
+#include <cmath>
+#include <stdexcept>
+
+template <typename TImage>
+CachedVarianceDifference<TImage>::CachedVarianceDifference() : StatisticsCache(NULL)
+{
+}
+
+template <typename TImage>
+void CachedVarianceDifference<TImage>::SetStatisticsCache(PatchStatisticsCache<TImage>* const statisticsCache)
+{
+  this->StatisticsCache = statisticsCache;
+}
+
+template <typename TImage>
+float CachedVarianceDifference<TImage>::Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2)
+{
+  if(!this->StatisticsCache)
+  {
+    throw std::runtime_error("CachedVarianceDifference: Must call SetStatisticsCache() before Distance()!");
+  }
+
+  typename PatchStatisticsCache<TImage>::StatisticsType statistics1 = this->StatisticsCache->GetVariance(region1);
+  typename PatchStatisticsCache<TImage>::StatisticsType statistics2 = this->StatisticsCache->GetVariance(region2);
+
+  double difference = 0;
+  for(unsigned int component = 0; component < statistics1.GetSize(); ++component)
+  {
+    difference += std::fabs(statistics1[component] - statistics2[component]);
+  }
+
+  return difference;
+}
+
+template <typename TImage>
+void CachedVarianceDifference<TImage>::BatchDistance(const itk::ImageRegion<2>& targetRegion,
+                                                     const itk::Index<2>* const sourceCorners,
+                                                     const unsigned int numberOfSources, const float,
+                                                     float* const distances)
+{
+  if(!this->StatisticsCache)
+  {
+    throw std::runtime_error("CachedVarianceDifference: Must call SetStatisticsCache() before BatchDistance()!");
+  }
+
+  // A search compares against every source patch, so build the tables (once, the first time).
+  this->StatisticsCache->Update();
+
+  typename PatchStatisticsCache<TImage>::StatisticsType targetStatistics = this->StatisticsCache->GetVariance(targetRegion);
+
+  itk::ImageRegion<2> sourceRegion(targetRegion.GetSize());
+  for(unsigned int sourceId = 0; sourceId < numberOfSources; ++sourceId)
+  {
+    sourceRegion.SetIndex(sourceCorners[sourceId]);
+    typename PatchStatisticsCache<TImage>::StatisticsType sourceStatistics = this->StatisticsCache->GetVariance(sourceRegion);
+
+    double difference = 0;
+    for(unsigned int component = 0; component < sourceStatistics.GetSize(); ++component)
+    {
+      difference += std::fabs(sourceStatistics[component] - targetStatistics[component]);
+    }
+
+    distances[sourceId] = difference;
+  }
+}
+
+template <typename TImage>
+std::string CachedVarianceDifference<TImage>::GetDistanceName()
+{
+  return "Variance Difference";
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+// STL
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Custom
+#include "MatchPairFile.h"
+#include "PairReader.h"
+
+/** Convert a text match file (read by PairReader) to a binary pair file (see MatchPairFile), which ViewAllMatches
+  * maps instead of parsing. The text files have no scores, so the scores are written as NaN. */
+int main(int argc, char** argv)
+{
+  if(argc != 4)
+  {
+    std::cerr << "Required arguments: matches.txt patchRadius output.pairs" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::stringstream ss;
+  for(int i = 1; i < argc; ++i)
+  {
+    ss << argv[i] << " ";
+  }
+
+  std::string matchFileName;
+  unsigned int patchRadius;
+  std::string outputFileName;
+  ss >> matchFileName >> patchRadius >> outputFileName;
+  if(ss.fail())
+  {
+    std::cerr << "The patch radius must be a non-negative integer!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "matchFileName: " << matchFileName << std::endl;
+  std::cout << "patchRadius: " << patchRadius << std::endl;
+  std::cout << "outputFileName: " << outputFileName << std::endl;
+
+  itk::Size<2> patchSize = {{patchRadius*2 + 1, patchRadius*2 + 1}};
+  typedef std::pair<itk::ImageRegion<2>, itk::ImageRegion<2> > PairType;
+  std::vector<PairType> pairs = PairReader::Read(matchFileName, patchSize);
+
+  std::vector<MatchPairFile::Record> records(pairs.size());
+  for(size_t pairId = 0; pairId < pairs.size(); ++pairId)
+  {
+    const itk::ImageRegion<2>& targetRegion = pairs[pairId].first;
+    const itk::ImageRegion<2>& sourceRegion = pairs[pairId].second;
+
+    MatchPairFile::Record& record = records[pairId];
+    record.TargetX = targetRegion.GetIndex()[0] + patchRadius;
+    record.TargetY = targetRegion.GetIndex()[1] + patchRadius;
+    record.SourceX = sourceRegion.GetIndex()[0] + patchRadius;
+    record.SourceY = sourceRegion.GetIndex()[1] + patchRadius;
+    record.Score = std::numeric_limits<float>::quiet_NaN();
+  }
+
+  MatchPairFile::Write(outputFileName, patchRadius, records);
+  std::cout << "Wrote " << records.size() << " pairs to " << outputFileName << std::endl;
+
+  return EXIT_SUCCESS;
+}
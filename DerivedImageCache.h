@@ -0,0 +1,153 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef DerivedImageCache_H
+#define DerivedImageCache_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <vector>
+
+// Custom
+#include "LabConversion.h"
+
+/** Images derived from an RGB image (HSV, CIELab, and a Gaussian blur) that are computed the first time they
+  * are requested and then kept until the image changes, so that reconfiguring the distance functors (e.g. when
+  * the patch radius changes) does not convert the image again. The conversions are split into blocks of rows
+  * that are processed on all of the cores.
+  * The derived images have the same type as the image, so each channel is stored with the precision of the
+  * image. The Get functions are not thread safe; call them before handing the images to other threads.
+  */
+template <typename TImage>
+class DerivedImageCache
+{
+public:
+
+  /** Constructor. */
+  DerivedImageCache();
+
+  /** Set the (RGB) image to derive the images from. */
+  void SetImage(TImage* const image);
+
+  /** Set the standard deviation (in pixels) of the Gaussian blur. */
+  void SetBlurSigma(const float blurSigma);
+
+  /** Discard the derived images, e.g. if the image was modified in place. They are also discarded if the image or
+    * its modified time change. */
+  void Invalidate();
+
+  /** Get the image in HSV. Each channel is scaled so that its values in the image span 0 to 255. */
+  TImage* GetHSVImage();
+
+  /** Get the image in CIELab (D65 white point). L is scaled from [0, 100] to [0, 255], and 128 is added to a and b. */
+  TImage* GetLabImage();
+
+  /** Get the image in CIELab as floats (see LabConversion). This is only available for 8-bit RGB images. */
+  LabConversion::LabImageType* GetFloatLabImage();
+
+  /** Get the image blurred (separately in each channel) with a Gaussian of standard deviation BlurSigma. */
+  TImage* GetBlurredImage();
+
+private:
+
+  /** The derived images. */
+  enum DerivedImageEnum {HSV, LAB, BLURRED, NUMBER_OF_DERIVED_IMAGES};
+
+  /** The steps that are run on all of the rows, one after the other. */
+  enum PassEnum {HSV_CONVERSION, HSV_SCALING, LAB_CONVERSION, HORIZONTAL_BLUR, VERTICAL_BLUR};
+
+  /** A block of consecutive rows. */
+  struct RowBlock
+  {
+    unsigned int FirstRow;
+    unsigned int EndRow;
+  };
+
+  /** The function object handed to QtConcurrent. It runs a pass on a block of rows. */
+  struct RowBlockProcessor
+  {
+    typedef void result_type;
+
+    RowBlockProcessor(DerivedImageCache* const owner, const PassEnum pass, TImage* const output) :
+      Owner(owner), Pass(pass), Output(output){}
+
+    void operator()(const RowBlock& rowBlock) const
+    {
+      this->Owner->ProcessRows(rowBlock, this->Pass, this->Output);
+    }
+
+    DerivedImageCache* Owner;
+    PassEnum Pass;
+    TImage* Output;
+  };
+
+  /** Discard the derived images if the image has changed. */
+  void CheckImage();
+
+  /** Allocate an image of the same size as the image. */
+  typename TImage::Pointer CreateDerivedImage() const;
+
+  /** Run a pass on all of the rows, writing either to WorkBuffer or to 'output'. */
+  void RunPass(const PassEnum pass, TImage* const output);
+
+  /** Run a pass on a block of rows. */
+  void ProcessRows(const RowBlock& rowBlock, const PassEnum pass, TImage* const output);
+
+  /** Convert an RGB value (0 to 255) to HSV (each 0 to 1). */
+  static void RGBToHSV(const float rgb[3], float hsv[3]);
+
+  /** The image. */
+  TImage* Image;
+
+  /** The image the derived images were computed from. */
+  TImage* CachedImage;
+
+  /** The modified time of the image when the derived images were computed. */
+  unsigned long CachedImageMTime;
+
+  /** The standard deviation of the Gaussian blur. */
+  float BlurSigma;
+
+  /** The derived images (NULL until they are requested). */
+  typename TImage::Pointer DerivedImages[NUMBER_OF_DERIVED_IMAGES];
+
+  /** The floating point Lab image (NULL until it is requested). */
+  LabConversion::LabImageType::Pointer FloatLabImage;
+
+  /** The region of the image. */
+  itk::ImageRegion<2> FullRegion;
+
+  /** Three floats per pixel, in raster order, holding the intermediate results of a conversion. */
+  std::vector<float> WorkBuffer;
+
+  /** The minimum of each channel of WorkBuffer, used by HSV_SCALING. */
+  float ChannelMinimum[3];
+
+  /** The factor that maps each channel of WorkBuffer to 0 to 255, used by HSV_SCALING. */
+  float ChannelScale[3];
+
+  /** The weights of the Gaussian, from the center outwards. */
+  std::vector<float> BlurKernel;
+};
+
+#include "DerivedImageCache.hpp"
+
+#endif
@@ -0,0 +1,370 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef DerivedImageCache_HPP
+#define DerivedImageCache_HPP
+
+#include "DerivedImageCache.h"
+
+// Qt
+#include <QThread>
+#include <QtConcurrentMap>
+
+// ITK
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+template <typename TImage>
+DerivedImageCache<TImage>::DerivedImageCache() : Image(NULL), CachedImage(NULL), CachedImageMTime(0), BlurSigma(2.0f)
+{
+}
+
+template <typename TImage>
+void DerivedImageCache<TImage>::SetImage(TImage* const image)
+{
+  this->Image = image;
+}
+
+template <typename TImage>
+void DerivedImageCache<TImage>::SetBlurSigma(const float blurSigma)
+{
+  if(blurSigma != this->BlurSigma)
+  {
+    this->BlurSigma = blurSigma;
+    this->DerivedImages[BLURRED] = NULL;
+  }
+}
+
+template <typename TImage>
+void DerivedImageCache<TImage>::Invalidate()
+{
+  for(unsigned int derivedImageId = 0; derivedImageId < NUMBER_OF_DERIVED_IMAGES; ++derivedImageId)
+  {
+    this->DerivedImages[derivedImageId] = NULL;
+  }
+  this->FloatLabImage = NULL;
+  this->WorkBuffer.clear();
+}
+
+template <typename TImage>
+void DerivedImageCache<TImage>::CheckImage()
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("DerivedImageCache: Must call SetImage() before requesting a derived image!");
+  }
+
+  if(this->Image->GetNumberOfComponentsPerPixel() != 3)
+  {
+    throw std::runtime_error("DerivedImageCache: The image must have 3 (RGB) channels!");
+  }
+
+  if(this->Image != this->CachedImage || this->Image->GetMTime() != this->CachedImageMTime)
+  {
+    Invalidate();
+    this->CachedImage = this->Image;
+    this->CachedImageMTime = this->Image->GetMTime();
+  }
+
+  this->FullRegion = this->Image->GetLargestPossibleRegion();
+}
+
+template <typename TImage>
+typename TImage::Pointer DerivedImageCache<TImage>::CreateDerivedImage() const
+{
+  typename TImage::Pointer derivedImage = TImage::New();
+  derivedImage->SetRegions(this->FullRegion);
+  derivedImage->SetNumberOfComponentsPerPixel(3);
+  derivedImage->Allocate();
+  return derivedImage;
+}
+
+template <typename TImage>
+TImage* DerivedImageCache<TImage>::GetHSVImage()
+{
+  CheckImage();
+  if(this->DerivedImages[HSV])
+  {
+    return this->DerivedImages[HSV];
+  }
+
+  RunPass(HSV_CONVERSION, NULL);
+
+  // Stretch each channel to 0 to 255 so that it uses the full range of the pixel type.
+  for(unsigned int component = 0; component < 3; ++component)
+  {
+    float minimum = std::numeric_limits<float>::max();
+    float maximum = -std::numeric_limits<float>::max();
+    for(size_t valueId = component; valueId < this->WorkBuffer.size(); valueId += 3)
+    {
+      minimum = std::min(minimum, this->WorkBuffer[valueId]);
+      maximum = std::max(maximum, this->WorkBuffer[valueId]);
+    }
+    this->ChannelMinimum[component] = minimum;
+    this->ChannelScale[component] = maximum > minimum ? 255.0f / (maximum - minimum) : 0.0f;
+  }
+
+  this->DerivedImages[HSV] = CreateDerivedImage();
+  RunPass(HSV_SCALING, this->DerivedImages[HSV]);
+  this->WorkBuffer.clear();
+
+  return this->DerivedImages[HSV];
+}
+
+template <typename TImage>
+TImage* DerivedImageCache<TImage>::GetLabImage()
+{
+  CheckImage();
+  if(this->DerivedImages[LAB])
+  {
+    return this->DerivedImages[LAB];
+  }
+
+  this->DerivedImages[LAB] = CreateDerivedImage();
+  RunPass(LAB_CONVERSION, this->DerivedImages[LAB]);
+
+  return this->DerivedImages[LAB];
+}
+
+template <typename TImage>
+LabConversion::LabImageType* DerivedImageCache<TImage>::GetFloatLabImage()
+{
+  CheckImage();
+  if(!this->FloatLabImage)
+  {
+    this->FloatLabImage = LabConversion::LabImageType::New();
+    LabConversion::ConvertImage(this->Image, this->FloatLabImage);
+  }
+
+  return this->FloatLabImage;
+}
+
+template <typename TImage>
+TImage* DerivedImageCache<TImage>::GetBlurredImage()
+{
+  CheckImage();
+  if(this->DerivedImages[BLURRED])
+  {
+    return this->DerivedImages[BLURRED];
+  }
+
+  // The kernel extends to 3 standard deviations on each side.
+  const int kernelRadius = std::max(static_cast<int>(std::ceil(3.0f * this->BlurSigma)), 1);
+  this->BlurKernel.resize(kernelRadius + 1);
+  float kernelSum = 0;
+  for(int offset = 0; offset <= kernelRadius; ++offset)
+  {
+    this->BlurKernel[offset] = std::exp(-0.5f * offset * offset / (this->BlurSigma * this->BlurSigma));
+    kernelSum += (offset == 0 ? 1 : 2) * this->BlurKernel[offset];
+  }
+  for(int offset = 0; offset <= kernelRadius; ++offset)
+  {
+    this->BlurKernel[offset] /= kernelSum;
+  }
+
+  this->DerivedImages[BLURRED] = CreateDerivedImage();
+  RunPass(HORIZONTAL_BLUR, NULL);
+  RunPass(VERTICAL_BLUR, this->DerivedImages[BLURRED]);
+  this->WorkBuffer.clear();
+
+  return this->DerivedImages[BLURRED];
+}
+
+template <typename TImage>
+void DerivedImageCache<TImage>::RunPass(const PassEnum pass, TImage* const output)
+{
+  const unsigned int width = this->FullRegion.GetSize()[0];
+  const unsigned int height = this->FullRegion.GetSize()[1];
+  if(pass == HSV_CONVERSION || pass == HORIZONTAL_BLUR)
+  {
+    this->WorkBuffer.resize(static_cast<size_t>(width) * height * 3);
+  }
+
+  const unsigned int blocksPerThread = 8;
+  unsigned int rowsPerBlock = std::max<unsigned int>(height / (blocksPerThread * std::max(QThread::idealThreadCount(), 1)), 1);
+  std::vector<RowBlock> rowBlocks;
+  for(unsigned int row = 0; row < height; row += rowsPerBlock)
+  {
+    RowBlock rowBlock;
+    rowBlock.FirstRow = row;
+    rowBlock.EndRow = std::min<unsigned int>(row + rowsPerBlock, height);
+    rowBlocks.push_back(rowBlock);
+  }
+
+  QtConcurrent::blockingMap(rowBlocks, RowBlockProcessor(this, pass, output));
+}
+
+template <typename TImage>
+void DerivedImageCache<TImage>::ProcessRows(const RowBlock& rowBlock, const PassEnum pass, TImage* const output)
+{
+  typedef typename TImage::PixelType::ValueType ComponentType;
+
+  const unsigned int width = this->FullRegion.GetSize()[0];
+  const unsigned int height = this->FullRegion.GetSize()[1];
+
+  itk::Index<2> blockCorner = this->FullRegion.GetIndex();
+  blockCorner[1] += rowBlock.FirstRow;
+  itk::Size<2> blockSize = {{width, rowBlock.EndRow - rowBlock.FirstRow}};
+  itk::ImageRegion<2> blockRegion(blockCorner, blockSize);
+
+  float* const workBuffer = this->WorkBuffer.empty() ? NULL : &this->WorkBuffer[0];
+
+  if(pass == HSV_CONVERSION || pass == LAB_CONVERSION || pass == HORIZONTAL_BLUR)
+  {
+    // These passes read the image.
+    itk::ImageRegionConstIterator<TImage> inputIterator(this->Image, blockRegion);
+    itk::ImageRegionIterator<TImage> outputIterator;
+    if(output)
+    {
+      outputIterator = itk::ImageRegionIterator<TImage>(output, blockRegion);
+    }
+
+    std::vector<float> rowValues(3 * width);
+    for(unsigned int row = rowBlock.FirstRow; row < rowBlock.EndRow; ++row)
+    {
+      for(unsigned int column = 0; column < width; ++column, ++inputIterator)
+      {
+        typename TImage::PixelType pixel = inputIterator.Get();
+        for(unsigned int component = 0; component < 3; ++component)
+        {
+          rowValues[3 * column + component] = pixel[component];
+        }
+      }
+
+      float* const workRow = workBuffer + static_cast<size_t>(row) * width * 3;
+      for(unsigned int column = 0; column < width; ++column)
+      {
+        const float* rgb = &rowValues[3 * column];
+        if(pass == HSV_CONVERSION)
+        {
+          RGBToHSV(rgb, workRow + 3 * column);
+        }
+        else if(pass == LAB_CONVERSION)
+        {
+          const unsigned char rgb8[3] = {static_cast<unsigned char>(rgb[0]), static_cast<unsigned char>(rgb[1]),
+                                         static_cast<unsigned char>(rgb[2])};
+          float lab[3];
+          LabConversion::RGBToLab(rgb8, lab);
+          const float packed[3] = {lab[0] * 2.55f, lab[1] + 128.0f, lab[2] + 128.0f};
+
+          typename TImage::PixelType pixel = outputIterator.Get();
+          for(unsigned int component = 0; component < 3; ++component)
+          {
+            pixel[component] = static_cast<ComponentType>(std::min(std::max(packed[component] + 0.5f, 0.0f), 255.0f));
+          }
+          outputIterator.Set(pixel);
+          ++outputIterator;
+        }
+        else // HORIZONTAL_BLUR
+        {
+          const int kernelRadius = this->BlurKernel.size() - 1;
+          for(unsigned int component = 0; component < 3; ++component)
+          {
+            float sum = this->BlurKernel[0] * rgb[component];
+            for(int offset = 1; offset <= kernelRadius; ++offset)
+            {
+              // Repeat the pixels at the edges.
+              int left = std::max(static_cast<int>(column) - offset, 0);
+              int right = std::min(static_cast<int>(column) + offset, static_cast<int>(width) - 1);
+              sum += this->BlurKernel[offset] * (rowValues[3 * left + component] + rowValues[3 * right + component]);
+            }
+            workRow[3 * column + component] = sum;
+          }
+        }
+      }
+    }
+    return;
+  }
+
+  // The other passes read WorkBuffer and write the output image.
+  itk::ImageRegionIterator<TImage> outputIterator(output, blockRegion);
+  const int kernelRadius = this->BlurKernel.size() - 1;
+  for(unsigned int row = rowBlock.FirstRow; row < rowBlock.EndRow; ++row)
+  {
+    for(unsigned int column = 0; column < width; ++column, ++outputIterator)
+    {
+      const size_t valueId = (static_cast<size_t>(row) * width + column) * 3;
+      typename TImage::PixelType pixel = outputIterator.Get();
+      for(unsigned int component = 0; component < 3; ++component)
+      {
+        float value = 0;
+        if(pass == HSV_SCALING)
+        {
+          // Truncated, like a cast of the scaled floating point image.
+          value = (workBuffer[valueId + component] - this->ChannelMinimum[component]) * this->ChannelScale[component];
+        }
+        else // VERTICAL_BLUR
+        {
+          value = this->BlurKernel[0] * workBuffer[valueId + component];
+          for(int offset = 1; offset <= kernelRadius; ++offset)
+          {
+            size_t above = std::max(static_cast<int>(row) - offset, 0);
+            size_t below = std::min(static_cast<int>(row) + offset, static_cast<int>(height) - 1);
+            value += this->BlurKernel[offset] * (workBuffer[(above * width + column) * 3 + component] +
+                                                 workBuffer[(below * width + column) * 3 + component]);
+          }
+          value += 0.5f;
+        }
+        pixel[component] = static_cast<ComponentType>(std::min(std::max(value, 0.0f), 255.0f));
+      }
+      outputIterator.Set(pixel);
+    }
+  }
+}
+
+template <typename TImage>
+void DerivedImageCache<TImage>::RGBToHSV(const float rgb[3], float hsv[3])
+{
+  const float maximum = std::max(std::max(rgb[0], rgb[1]), rgb[2]);
+  const float minimum = std::min(std::min(rgb[0], rgb[1]), rgb[2]);
+  const float delta = maximum - minimum;
+
+  float hue = 0;
+  if(delta > 0)
+  {
+    if(maximum == rgb[0])
+    {
+      hue = (rgb[1] - rgb[2]) / delta;
+      if(hue < 0)
+      {
+        hue += 6;
+      }
+    }
+    else if(maximum == rgb[1])
+    {
+      hue = 2 + (rgb[2] - rgb[0]) / delta;
+    }
+    else
+    {
+      hue = 4 + (rgb[0] - rgb[1]) / delta;
+    }
+  }
+
+  hsv[0] = hue / 6.0f;
+  hsv[1] = maximum > 0 ? delta / maximum : 0;
+  hsv[2] = maximum / 255.0f;
+}
+
+#endif
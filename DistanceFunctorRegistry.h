@@ -0,0 +1,110 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef DistanceFunctorRegistry_H
+#define DistanceFunctorRegistry_H
+
+// Qt
+class QLabel;
+
+// STL
+#include <string>
+#include <vector>
+
+// Submodules
+#include "PatchComparison/PatchDistance.h"
+
+// Custom
+#include "FusedDistanceEvaluator.h"
+#include "TopPatchesWidget.h"
+
+/** Owns the distance functors of the GUI, together with the label that displays each functor's score and
+  * (optionally) the window that displays its top patches. The entries are created once and then reconfigured in
+  * place (e.g. when the patch radius or the image changes), so reconfiguring does not leak functors, labels, or
+  * windows. Everything is deleted when the registry is cleared or destroyed.
+  */
+template <typename TImage>
+class DistanceFunctorRegistry
+{
+public:
+
+  /** A functor and the widgets that display its results. */
+  struct Entry
+  {
+    /** The name the entry is looked up by. */
+    std::string Name;
+
+    /** The functor. */
+    PatchDistance<TImage>* Functor;
+
+    /** The label that displays the score of the current source and target patches. */
+    QLabel* ScoreLabel;
+
+    /** The window that displays the top patches, or NULL. */
+    TopPatchesWidget<TImage>* TopPatchesWindow;
+  };
+
+  /** Constructor. */
+  DistanceFunctorRegistry();
+
+  /** Destructor. Deletes all of the entries. */
+  ~DistanceFunctorRegistry();
+
+  /** Take ownership of a functor, its score label, and its top patches window (which can be NULL). */
+  void Add(const std::string& name, PatchDistance<TImage>* const functor, QLabel* const scoreLabel,
+           TopPatchesWidget<TImage>* const topPatchesWindow);
+
+  /** Get the functor of an entry, cast to its actual type. Returns NULL if there is no such entry or the
+    * functor is of another type. */
+  template <typename TFunctor>
+  TFunctor* GetFunctor(const std::string& name) const;
+
+  /** Compute the distance of every entry between the source and target regions, in the order of the entries.
+    * The functors that read the same image share a single pass over the pixels (see FusedDistanceEvaluator). */
+  void ComputeDistances(const itk::ImageRegion<2>& sourceRegion, const itk::ImageRegion<2>& targetRegion,
+                        std::vector<float>& distances);
+
+  /** Get the number of entries. */
+  unsigned int GetNumberOfEntries() const;
+
+  /** Get an entry. */
+  const Entry& GetEntry(const unsigned int entryId) const;
+
+  /** True if there are no entries. */
+  bool IsEmpty() const;
+
+  /** Delete all of the functors, labels, and windows. */
+  void Clear();
+
+private:
+
+  /** The registry owns pointers, so it cannot be copied. */
+  DistanceFunctorRegistry(const DistanceFunctorRegistry&);
+  void operator=(const DistanceFunctorRegistry&);
+
+  /** The entries, in the order they were added. */
+  std::vector<Entry> Entries;
+
+  /** Computes the distances of all of the functors of the entries. */
+  FusedDistanceEvaluator<TImage> Evaluator;
+};
+
+#include "DistanceFunctorRegistry.hpp"
+
+#endif
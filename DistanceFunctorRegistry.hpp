@@ -0,0 +1,133 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef DistanceFunctorRegistry_HPP
+#define DistanceFunctorRegistry_HPP
+
+#include "DistanceFunctorRegistry.h"
+
+// Qt
+#include <QLabel>
+
+// STL
+#include <stdexcept>
+
+template <typename TImage>
+DistanceFunctorRegistry<TImage>::DistanceFunctorRegistry()
+{
+}
+
+template <typename TImage>
+DistanceFunctorRegistry<TImage>::~DistanceFunctorRegistry()
+{
+  Clear();
+}
+
+template <typename TImage>
+void DistanceFunctorRegistry<TImage>::Add(const std::string& name, PatchDistance<TImage>* const functor,
+                                          QLabel* const scoreLabel, TopPatchesWidget<TImage>* const topPatchesWindow)
+{
+  if(!functor || !scoreLabel)
+  {
+    throw std::runtime_error("DistanceFunctorRegistry: Every entry needs a functor and a score label!");
+  }
+
+  for(size_t entryId = 0; entryId < this->Entries.size(); ++entryId)
+  {
+    if(this->Entries[entryId].Name == name)
+    {
+      throw std::runtime_error("DistanceFunctorRegistry: There is already an entry named " + name + "!");
+    }
+  }
+
+  Entry entry;
+  entry.Name = name;
+  entry.Functor = functor;
+  entry.ScoreLabel = scoreLabel;
+  entry.TopPatchesWindow = topPatchesWindow;
+  this->Entries.push_back(entry);
+
+  this->Evaluator.AddFunctor(functor);
+}
+
+template <typename TImage>
+template <typename TFunctor>
+TFunctor* DistanceFunctorRegistry<TImage>::GetFunctor(const std::string& name) const
+{
+  for(size_t entryId = 0; entryId < this->Entries.size(); ++entryId)
+  {
+    if(this->Entries[entryId].Name == name)
+    {
+      return dynamic_cast<TFunctor*>(this->Entries[entryId].Functor);
+    }
+  }
+
+  return NULL;
+}
+
+template <typename TImage>
+void DistanceFunctorRegistry<TImage>::ComputeDistances(const itk::ImageRegion<2>& sourceRegion,
+                                                       const itk::ImageRegion<2>& targetRegion,
+                                                       std::vector<float>& distances)
+{
+  distances.resize(this->Entries.size());
+  if(distances.empty())
+  {
+    return;
+  }
+
+  this->Evaluator.ComputeDistances(sourceRegion, targetRegion, &distances[0]);
+}
+
+template <typename TImage>
+unsigned int DistanceFunctorRegistry<TImage>::GetNumberOfEntries() const
+{
+  return this->Entries.size();
+}
+
+template <typename TImage>
+const typename DistanceFunctorRegistry<TImage>::Entry&
+DistanceFunctorRegistry<TImage>::GetEntry(const unsigned int entryId) const
+{
+  return this->Entries[entryId];
+}
+
+template <typename TImage>
+bool DistanceFunctorRegistry<TImage>::IsEmpty() const
+{
+  return this->Entries.empty();
+}
+
+template <typename TImage>
+void DistanceFunctorRegistry<TImage>::Clear()
+{
+  this->Evaluator.Clear();
+
+  // The windows are deleted first, since they use the functors (and wait for a running search to stop).
+  for(size_t entryId = 0; entryId < this->Entries.size(); ++entryId)
+  {
+    delete this->Entries[entryId].TopPatchesWindow;
+    delete this->Entries[entryId].ScoreLabel; // This also removes it from its layout
+    delete this->Entries[entryId].Functor;
+  }
+
+  this->Entries.clear();
+}
+
+#endif
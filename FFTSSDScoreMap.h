@@ -0,0 +1,134 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef FFTSSDScoreMap_H
+#define FFTSSDScoreMap_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// VNL
+#include <vnl/vnl_matrix.h>
+
+// Qt
+#include <QAtomicInt>
+
+// STL
+#include <complex>
+#include <vector>
+
+/** Compute the SSD between a target patch and the patch at every position of the image at once.
+  * The SSD is split into sum(s^2) + sum(t^2) - 2*sum(s*t). The cross correlation sum(s*t) is computed for every
+  * position with one FFT per channel of the target patch and a single inverse FFT, and sum(s^2) is
+  * read from an integral image. The spectrum of the image and the integral image only depend on the
+  * image, so they are cached until the image (or its modified time) changes.
+  * This costs O(N log N) per query instead of the O(N r^2) of comparing every patch directly.
+  */
+template <typename TImage>
+class FFTSSDScoreMap
+{
+public:
+
+  /** Constructor. */
+  FFTSSDScoreMap();
+
+  /** Set the image to compute scores on. */
+  void SetImage(TImage* const image);
+
+  /** Set a flag that is checked between the transforms of the channels of the target patch. When it becomes
+    * non-zero, ComputeScores() stops. NULL (the default) means it cannot be canceled. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+  /** Compute the SSD between the target patch and the patch with its corner at every valid position.
+    * 'scores' is filled in raster order, with 'scoreSize' (the number of valid corners in each direction) columns
+    * and rows. The corner of scores[0] is the corner of the image. Returns false (and leaves 'scores' unset)
+    * if the computation was canceled. */
+  bool ComputeScores(const itk::ImageRegion<2>& targetRegion, std::vector<double>& scores,
+                     itk::Size<2>& scoreSize);
+
+  /** The largest possible difference between a score of the last completed ComputeScores() and the exact SSD of
+    * that patch, from the energies of the image and target patch, the size of the transforms, and the length of the
+    * sums of the integral image. */
+  double GetMaximumError() const;
+
+  /** Release the cached spectrum, integral image and query buffers. */
+  void ClearCache();
+
+private:
+
+  /** The type of a complex value of the spectra. */
+  typedef std::complex<double> ComplexType;
+
+  /** The type of the spectrum of one channel. */
+  typedef vnl_matrix<ComplexType> SpectrumType;
+
+  /** The function object handed to QtConcurrent to transform one channel. */
+  struct ForwardTransform
+  {
+    typedef void result_type;
+
+    void operator()(SpectrumType& spectrum) const;
+  };
+
+  /** True if the cancel flag is set. */
+  bool IsCancelRequested() const;
+
+  /** Recompute the image spectrum and integral image if the image has changed. */
+  void UpdateCache();
+
+  /** The smallest size >= minimumSize that has only 2, 3, and 5 as prime factors (required by vnl_fft). */
+  static unsigned int GetFFTSize(const unsigned int minimumSize);
+
+  /** The image to compute scores on. */
+  TImage* Image;
+
+  /** The image that the cache was computed from. */
+  TImage* CachedImage;
+
+  /** The modified time of the image when the cache was computed. */
+  unsigned long CachedImageMTime;
+
+  /** The number of rows of the padded image that is transformed. */
+  unsigned int PaddedRows;
+
+  /** The number of columns of the padded image that is transformed. */
+  unsigned int PaddedColumns;
+
+  /** The spectrum of each channel of the (zero padded) image. */
+  std::vector<SpectrumType> ChannelSpectra;
+
+  /** The integral image of the sum over channels of the squared pixel values, with an extra
+    * row and column of zeros at the top and left. */
+  std::vector<double> SquaredSumIntegral;
+
+  /** The buffer that each channel of the target patch is padded into and transformed in, reused between queries. */
+  SpectrumType QueryBuffer;
+
+  /** The sum over channels of the products of the image and target spectra, reused between queries. */
+  SpectrumType CorrelationBuffer;
+
+  /** The error bound of the last completed ComputeScores(). */
+  double MaximumError;
+
+  /** The flag that cancels ComputeScores(), or NULL. */
+  const QAtomicInt* CancelFlag;
+};
+
+#include "FFTSSDScoreMap.hpp"
+
+#endif
@@ -0,0 +1,278 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef FFTSSDScoreMap_HPP
+#define FFTSSDScoreMap_HPP
+
+#include "FFTSSDScoreMap.h"
+
+// ITK
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+// VNL
+#include <vnl/algo/vnl_fft_2d.h>
+
+// Qt
+#include <QtConcurrentMap>
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+template <typename TImage>
+FFTSSDScoreMap<TImage>::FFTSSDScoreMap() : Image(NULL), CachedImage(NULL), CachedImageMTime(0),
+PaddedRows(0), PaddedColumns(0), MaximumError(0), CancelFlag(NULL)
+{
+}
+
+template <typename TImage>
+void FFTSSDScoreMap<TImage>::SetImage(TImage* const image)
+{
+  this->Image = image;
+}
+
+template <typename TImage>
+void FFTSSDScoreMap<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->CancelFlag = cancelFlag;
+}
+
+template <typename TImage>
+bool FFTSSDScoreMap<TImage>::IsCancelRequested() const
+{
+  return this->CancelFlag && static_cast<int>(*this->CancelFlag) != 0;
+}
+
+template <typename TImage>
+double FFTSSDScoreMap<TImage>::GetMaximumError() const
+{
+  return this->MaximumError;
+}
+
+template <typename TImage>
+void FFTSSDScoreMap<TImage>::ClearCache()
+{
+  this->ChannelSpectra.clear();
+  this->SquaredSumIntegral.clear();
+  this->QueryBuffer.clear();
+  this->CorrelationBuffer.clear();
+  this->CachedImage = NULL;
+  this->CachedImageMTime = 0;
+}
+
+template <typename TImage>
+unsigned int FFTSSDScoreMap<TImage>::GetFFTSize(const unsigned int minimumSize)
+{
+  for(unsigned int size = std::max(minimumSize, 1u); ; ++size)
+  {
+    unsigned int remainder = size;
+    while(remainder % 2 == 0) { remainder /= 2; }
+    while(remainder % 3 == 0) { remainder /= 3; }
+    while(remainder % 5 == 0) { remainder /= 5; }
+    if(remainder == 1)
+    {
+      return size;
+    }
+  }
+}
+
+template <typename TImage>
+void FFTSSDScoreMap<TImage>::ForwardTransform::operator()(SpectrumType& spectrum) const
+{
+  vnl_fft_2d<double> fft(spectrum.rows(), spectrum.cols());
+  fft.fwd_transform(spectrum);
+}
+
+template <typename TImage>
+void FFTSSDScoreMap<TImage>::UpdateCache()
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("FFTSSDScoreMap: Must call SetImage() before computing scores!");
+  }
+
+  if(this->Image == this->CachedImage && this->Image->GetMTime() == this->CachedImageMTime &&
+     !this->ChannelSpectra.empty())
+  {
+    return;
+  }
+
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+  const unsigned int width = fullRegion.GetSize()[0];
+  const unsigned int height = fullRegion.GetSize()[1];
+  const unsigned int numberOfComponents = this->Image->GetNumberOfComponentsPerPixel();
+
+  // The correlation is circular, but the wrapped around values only land on corners where the patch
+  // would leave the image, so padding to at least the image size is enough.
+  this->PaddedRows = GetFFTSize(height);
+  this->PaddedColumns = GetFFTSize(width);
+
+  this->ChannelSpectra.assign(numberOfComponents, SpectrumType(this->PaddedRows, this->PaddedColumns, ComplexType(0, 0)));
+
+  std::vector<double> squaredSum(width * height, 0);
+
+  itk::ImageRegionConstIteratorWithIndex<TImage> imageIterator(this->Image, fullRegion);
+  while(!imageIterator.IsAtEnd())
+  {
+    unsigned int column = imageIterator.GetIndex()[0] - fullRegion.GetIndex()[0];
+    unsigned int row = imageIterator.GetIndex()[1] - fullRegion.GetIndex()[1];
+    typename TImage::PixelType pixel = imageIterator.Get();
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      double value = pixel[component];
+      this->ChannelSpectra[component](row, column) = ComplexType(value, 0);
+      squaredSum[row * width + column] += value * value;
+    }
+    ++imageIterator;
+  }
+
+  QtConcurrent::blockingMap(this->ChannelSpectra, ForwardTransform());
+
+  this->SquaredSumIntegral.assign((width + 1) * (height + 1), 0);
+  for(unsigned int row = 0; row < height; ++row)
+  {
+    double rowSum = 0;
+    for(unsigned int column = 0; column < width; ++column)
+    {
+      rowSum += squaredSum[row * width + column];
+      this->SquaredSumIntegral[(row + 1) * (width + 1) + column + 1] =
+        this->SquaredSumIntegral[row * (width + 1) + column + 1] + rowSum;
+    }
+  }
+
+  this->CachedImage = this->Image;
+  this->CachedImageMTime = this->Image->GetMTime();
+}
+
+template <typename TImage>
+bool FFTSSDScoreMap<TImage>::ComputeScores(const itk::ImageRegion<2>& targetRegion, std::vector<double>& scores,
+                                           itk::Size<2>& scoreSize)
+{
+  UpdateCache();
+
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+  const unsigned int width = fullRegion.GetSize()[0];
+  const unsigned int height = fullRegion.GetSize()[1];
+  const unsigned int patchWidth = targetRegion.GetSize()[0];
+  const unsigned int patchHeight = targetRegion.GetSize()[1];
+  const unsigned int numberOfComponents = this->ChannelSpectra.size();
+
+  if(patchWidth > width || patchHeight > height)
+  {
+    scoreSize.Fill(0);
+    scores.clear();
+    this->MaximumError = 0;
+    return true;
+  }
+
+  if(this->QueryBuffer.rows() != this->PaddedRows || this->QueryBuffer.cols() != this->PaddedColumns)
+  {
+    this->QueryBuffer.set_size(this->PaddedRows, this->PaddedColumns);
+    this->CorrelationBuffer.set_size(this->PaddedRows, this->PaddedColumns);
+  }
+  this->CorrelationBuffer.fill(ComplexType(0, 0));
+
+  vnl_fft_2d<double> fft(this->PaddedRows, this->PaddedColumns);
+  double targetSquaredSum = 0;
+
+  // Transform one channel of the target patch at a time in the same buffer and add its product with the image
+  // spectrum to the correlation. The correlation of all of the channels is the inverse transform of this sum,
+  // so only one inverse transform is needed.
+  for(unsigned int component = 0; component < numberOfComponents; ++component)
+  {
+    if(IsCancelRequested())
+    {
+      return false;
+    }
+
+    this->QueryBuffer.fill(ComplexType(0, 0));
+
+    itk::ImageRegionConstIteratorWithIndex<TImage> targetIterator(this->Image, targetRegion);
+    while(!targetIterator.IsAtEnd())
+    {
+      unsigned int column = targetIterator.GetIndex()[0] - targetRegion.GetIndex()[0];
+      unsigned int row = targetIterator.GetIndex()[1] - targetRegion.GetIndex()[1];
+      double value = targetIterator.Get()[component];
+      this->QueryBuffer(row, column) = ComplexType(value, 0);
+      targetSquaredSum += value * value;
+      ++targetIterator;
+    }
+
+    fft.fwd_transform(this->QueryBuffer);
+
+    const SpectrumType& channelSpectrum = this->ChannelSpectra[component];
+    for(unsigned int row = 0; row < this->PaddedRows; ++row)
+    {
+      for(unsigned int column = 0; column < this->PaddedColumns; ++column)
+      {
+        this->CorrelationBuffer(row, column) += channelSpectrum(row, column) *
+                                                std::conj(this->QueryBuffer(row, column));
+      }
+    }
+  }
+
+  if(IsCancelRequested())
+  {
+    return false;
+  }
+
+  fft.bwd_transform(this->CorrelationBuffer);
+  const double normalization = 1.0 / (static_cast<double>(this->PaddedRows) * this->PaddedColumns);
+
+  // The round off of a transform based correlation is at most a small multiple of epsilon * log2(size) times the
+  // product of the norms of the two signals (summed over the channels, this is bounded by the square root of the
+  // product of the energies). The score subtracts twice the correlation. The integral image of an integer image is
+  // exact; otherwise each of its entries is a sum of rows of up to 'width' values, summed over up to 'height' rows.
+  typedef typename TImage::PixelType::ValueType ComponentType;
+  const double epsilon = std::numeric_limits<double>::epsilon();
+  const double imageSquaredSum = this->SquaredSumIntegral.back();
+  const double transformSize = static_cast<double>(this->PaddedRows) * this->PaddedColumns;
+  const double correlationErrorFactor = 10.0;
+  this->MaximumError = 2.0 * correlationErrorFactor * epsilon * std::log(transformSize) / std::log(2.0) *
+                       std::sqrt(imageSquaredSum * targetSquaredSum);
+  if(!std::numeric_limits<ComponentType>::is_integer)
+  {
+    this->MaximumError += epsilon * (4.0 * (width + height) * imageSquaredSum +
+                                     patchWidth * patchHeight * numberOfComponents * targetSquaredSum);
+  }
+
+  scoreSize[0] = width - patchWidth + 1;
+  scoreSize[1] = height - patchHeight + 1;
+  scores.resize(scoreSize[0] * scoreSize[1]);
+
+  for(unsigned int row = 0; row < scoreSize[1]; ++row)
+  {
+    for(unsigned int column = 0; column < scoreSize[0]; ++column)
+    {
+      double sourceSquaredSum = this->SquaredSumIntegral[(row + patchHeight) * (width + 1) + column + patchWidth] -
+                                this->SquaredSumIntegral[row * (width + 1) + column + patchWidth] -
+                                this->SquaredSumIntegral[(row + patchHeight) * (width + 1) + column] +
+                                this->SquaredSumIntegral[row * (width + 1) + column];
+      double crossCorrelation = this->CorrelationBuffer(row, column).real() * normalization;
+
+      // Round off can make perfect matches very slightly negative.
+      scores[row * scoreSize[0] + column] = std::max(sourceSquaredSum + targetSquaredSum - 2.0 * crossCorrelation, 0.0);
+    }
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef FFTSSDSearchBackend_H
+#define FFTSSDSearchBackend_H
+
+// Custom
+#include "FFTSSDScoreMap.h"
+#include "SearchBackend.h"
+
+/** The FFT_SSD backend of ParallelSelfPatchCompare. The scores of all of the patches are computed at once with
+  * FFTSSDScoreMap, whose image spectrum is kept between queries. Every patch whose FFT score is within the round off
+  * bound of the FFT of the K-th best one is then re-scored with the functor, so the results match the exhaustive
+  * scan. Only SSD functors on the image of the query are supported.
+  */
+template <typename TImage>
+class FFTSSDSearchBackend : public SearchBackend<TImage>
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SearchBackend<TImage>::PatchDataType PatchDataType;
+
+  /** Everything about one query. */
+  typedef typename SearchBackend<TImage>::Query Query;
+
+  /** True if the functor is an SSD functor. */
+  bool SupportsPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor) const;
+
+  /** True if the functor is supported and a bounded number of patches is kept. */
+  bool CanComputePatchScores(const Query& query, std::string& reason);
+
+  /** Compute the scores with FFTSSDScoreMap and re-score the best ones with the functor. */
+  std::vector<PatchDataType> ComputePatchScores(const Query& query);
+
+  /** Set a flag that is checked between the transforms of the channels of the target patch. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+private:
+
+  /** The cached image spectrum. */
+  FFTSSDScoreMap<TImage> ScoreMap;
+};
+
+#include "FFTSSDSearchBackend.hpp"
+
+#endif
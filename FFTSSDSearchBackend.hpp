@@ -0,0 +1,107 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef FFTSSDSearchBackend_HPP
+#define FFTSSDSearchBackend_HPP
+
+#include "FFTSSDSearchBackend.h"
+
+// STL
+#include <algorithm>
+#include <limits>
+
+// Submodules
+#include "PatchComparison/SSD.h"
+
+template <typename TImage>
+bool FFTSSDSearchBackend<TImage>::SupportsPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor) const
+{
+  return dynamic_cast<SSD<TImage>*>(patchDistanceFunctor) != NULL;
+}
+
+template <typename TImage>
+bool FFTSSDSearchBackend<TImage>::CanComputePatchScores(const Query& query, std::string& reason)
+{
+  if(!SupportsPatchDistanceFunctor(query.PatchDistanceFunctor) || query.NumberOfPatchesToKeep == 0)
+  {
+    reason = "The FFT_SSD backend requires an SSD functor and a bounded number of patches to keep.";
+    return false;
+  }
+  return true;
+}
+
+template <typename TImage>
+void FFTSSDSearchBackend<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->ScoreMap.SetCancelFlag(cancelFlag);
+}
+
+template <typename TImage>
+std::vector<typename FFTSSDSearchBackend<TImage>::PatchDataType>
+FFTSSDSearchBackend<TImage>::ComputePatchScores(const Query& query)
+{
+  this->ScoreMap.SetImage(query.Image);
+
+  std::vector<double> scores;
+  itk::Size<2> scoreSize;
+  if(!this->ScoreMap.ComputeScores(query.TargetRegion, scores, scoreSize))
+  {
+    return std::vector<PatchDataType>();
+  }
+
+  // The K-th best FFT score. The exact scores of K patches are at most this plus the error of the FFT scores.
+  TopPatchCollector<PatchDataType> bestFFTPatches(query.NumberOfPatchesToKeep);
+  this->AddScoreMap(query, scores, scoreSize, std::numeric_limits<double>::max(), bestFFTPatches);
+
+  // The functor may accumulate in float, so its scores can differ from the exact ones by up to 'functorError'
+  // relative to the score (all of the terms are positive). A patch can only be one of the best K by the functor if
+  // its functor score is at most the K-th best one, which is at most (kthScore + maximumError) * (1 + functorError).
+  // Its FFT score is then at most the threshold below. Every such patch (including any ties of the K-th) is
+  // re-scored, so the results are exactly those of the exhaustive scan. In flat images many patches can be within
+  // the threshold, which makes this as slow as the exhaustive scan, but never wrong.
+  double threshold = std::numeric_limits<double>::max();
+  if(bestFFTPatches.IsFull())
+  {
+    const double maximumError = this->ScoreMap.GetMaximumError();
+    const double floatEpsilon = std::numeric_limits<float>::epsilon();
+    const double functorError = floatEpsilon * query.TargetRegion.GetNumberOfPixels() *
+                                query.Image->GetNumberOfComponentsPerPixel();
+    // The K-th score was rounded to float by the collector.
+    const double kthScore = bestFFTPatches.GetAdmissionThreshold() * (1.0 + floatEpsilon);
+    threshold = (kthScore + maximumError) * (1.0 + functorError) / std::max(1.0 - functorError, 0.5) + maximumError;
+  }
+
+  TopPatchCollector<PatchDataType> candidates;
+  this->AddScoreMap(query, scores, scoreSize, threshold, candidates);
+
+  std::vector<PatchDataType> candidatePatchData = candidates.GetSortedPatchData();
+
+  TopPatchCollector<PatchDataType> topPatches(query.NumberOfPatchesToKeep);
+  for(size_t candidateId = 0; candidateId < candidatePatchData.size(); ++candidateId)
+  {
+    itk::ImageRegion<2> candidateRegion = candidatePatchData[candidateId].first;
+    float distance = query.PatchDistanceFunctor->Distance(candidateRegion, query.TargetRegion);
+    topPatches.Add(PatchDataType(candidateRegion, distance),
+                   this->GetRasterOrder(query.Image, candidateRegion.GetIndex()));
+  }
+
+  return topPatches.GetSortedPatchData();
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef FusedDistanceEvaluator_H
+#define FusedDistanceEvaluator_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <vector>
+
+// Submodules
+#include "PatchComparison/PatchDistance.h"
+
+// Custom
+#include "AccumulatedPatchDistance.h"
+
+/** Computes the distances of several functors between the same pair of patches. Calling Distance() on each
+  * functor would read the source and target pixels once per functor. Instead, all of the functors that implement
+  * AccumulatedPatchDistance and read the same image share a single pass over the pixels, in which each pair of
+  * rows is handed to all of their accumulators. The other functors are computed with Distance().
+  * TImage must store its pixels contiguously (an itk::Image, not an itk::VectorImage).
+  */
+template <typename TImage>
+class FusedDistanceEvaluator
+{
+public:
+
+  /** Constructor. */
+  FusedDistanceEvaluator();
+
+  /** Destructor. Deletes the accumulators. */
+  ~FusedDistanceEvaluator();
+
+  /** Add a functor (which is not owned). */
+  void AddFunctor(PatchDistance<TImage>* const functor);
+
+  /** Remove all of the functors. */
+  void Clear();
+
+  /** Get the number of functors. */
+  unsigned int GetNumberOfFunctors() const;
+
+  /** Compute Distance(sourceRegion, targetRegion) of each functor, in the order they were added. 'distances' must
+    * have room for GetNumberOfFunctors() values. */
+  void ComputeDistances(const itk::ImageRegion<2>& sourceRegion, const itk::ImageRegion<2>& targetRegion,
+                        float* const distances);
+
+private:
+
+  /** The evaluator owns the accumulators, so it cannot be copied. */
+  FusedDistanceEvaluator(const FusedDistanceEvaluator&);
+  void operator=(const FusedDistanceEvaluator&);
+
+  /** Accumulate the pixels of 'image' for the accumulators of 'functorIds' in a single pass. */
+  void AccumulateImage(const TImage* const image, const std::vector<unsigned int>& functorIds,
+                       const itk::ImageRegion<2>& sourceRegion, const itk::ImageRegion<2>& targetRegion);
+
+  /** The functors. */
+  std::vector<PatchDistance<TImage>*> Functors;
+
+  /** The accumulator of each functor, or NULL if the functor is computed with Distance(). */
+  std::vector<PatchDistanceAccumulator<TImage>*> Accumulators;
+};
+
+#include "FusedDistanceEvaluator.hpp"
+
+#endif
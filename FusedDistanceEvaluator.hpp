@@ -0,0 +1,153 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef FusedDistanceEvaluator_HPP
+#define FusedDistanceEvaluator_HPP
+
+#include "FusedDistanceEvaluator.h"
+
+template <typename TImage>
+FusedDistanceEvaluator<TImage>::FusedDistanceEvaluator()
+{
+}
+
+template <typename TImage>
+FusedDistanceEvaluator<TImage>::~FusedDistanceEvaluator()
+{
+  Clear();
+}
+
+template <typename TImage>
+void FusedDistanceEvaluator<TImage>::AddFunctor(PatchDistance<TImage>* const functor)
+{
+  AccumulatedPatchDistance<TImage>* accumulatedFunctor = dynamic_cast<AccumulatedPatchDistance<TImage>*>(functor);
+
+  this->Functors.push_back(functor);
+  this->Accumulators.push_back(accumulatedFunctor ? accumulatedFunctor->CreateAccumulator() : NULL);
+}
+
+template <typename TImage>
+void FusedDistanceEvaluator<TImage>::Clear()
+{
+  for(size_t functorId = 0; functorId < this->Accumulators.size(); ++functorId)
+  {
+    delete this->Accumulators[functorId];
+  }
+
+  this->Accumulators.clear();
+  this->Functors.clear();
+}
+
+template <typename TImage>
+unsigned int FusedDistanceEvaluator<TImage>::GetNumberOfFunctors() const
+{
+  return this->Functors.size();
+}
+
+template <typename TImage>
+void FusedDistanceEvaluator<TImage>::ComputeDistances(const itk::ImageRegion<2>& sourceRegion,
+                                                      const itk::ImageRegion<2>& targetRegion,
+                                                      float* const distances)
+{
+  std::vector<bool> done(this->Functors.size(), false);
+
+  for(unsigned int functorId = 0; functorId < this->Functors.size(); ++functorId)
+  {
+    if(done[functorId])
+    {
+      continue;
+    }
+
+    if(!this->Accumulators[functorId])
+    {
+      distances[functorId] = this->Functors[functorId]->Distance(sourceRegion, targetRegion);
+      done[functorId] = true;
+      continue;
+    }
+
+    // All of the remaining accumulators of the same image share this pass.
+    const TImage* image = this->Accumulators[functorId]->GetImage();
+    std::vector<unsigned int> functorIds;
+    for(unsigned int otherFunctorId = functorId; otherFunctorId < this->Functors.size(); ++otherFunctorId)
+    {
+      if(!done[otherFunctorId] && this->Accumulators[otherFunctorId] &&
+         this->Accumulators[otherFunctorId]->GetImage() == image)
+      {
+        functorIds.push_back(otherFunctorId);
+        done[otherFunctorId] = true;
+      }
+    }
+
+    const itk::ImageRegion<2> bufferedRegion = image ? image->GetBufferedRegion() : itk::ImageRegion<2>();
+    if(!image || sourceRegion.GetSize() != targetRegion.GetSize() ||
+       !bufferedRegion.IsInside(sourceRegion) || !bufferedRegion.IsInside(targetRegion))
+    {
+      // Let the functors report the problem the way they usually do.
+      for(size_t i = 0; i < functorIds.size(); ++i)
+      {
+        distances[functorIds[i]] = this->Functors[functorIds[i]]->Distance(sourceRegion, targetRegion);
+      }
+      continue;
+    }
+
+    AccumulateImage(image, functorIds, sourceRegion, targetRegion);
+    for(size_t i = 0; i < functorIds.size(); ++i)
+    {
+      distances[functorIds[i]] = this->Accumulators[functorIds[i]]->GetDistance();
+    }
+  }
+}
+
+template <typename TImage>
+void FusedDistanceEvaluator<TImage>::AccumulateImage(const TImage* const image,
+                                                     const std::vector<unsigned int>& functorIds,
+                                                     const itk::ImageRegion<2>& sourceRegion,
+                                                     const itk::ImageRegion<2>& targetRegion)
+{
+  const itk::ImageRegion<2> bufferedRegion = image->GetBufferedRegion();
+  const typename TImage::PixelType* const buffer = image->GetBufferPointer();
+  const size_t rowStride = bufferedRegion.GetSize()[0];
+  const unsigned int rowLength = sourceRegion.GetSize()[0];
+  const unsigned int numberOfRows = sourceRegion.GetSize()[1];
+
+  const typename TImage::PixelType* sourceRow =
+    buffer + (sourceRegion.GetIndex()[1] - bufferedRegion.GetIndex()[1]) * rowStride +
+    (sourceRegion.GetIndex()[0] - bufferedRegion.GetIndex()[0]);
+  const typename TImage::PixelType* targetRow =
+    buffer + (targetRegion.GetIndex()[1] - bufferedRegion.GetIndex()[1]) * rowStride +
+    (targetRegion.GetIndex()[0] - bufferedRegion.GetIndex()[0]);
+
+  for(size_t i = 0; i < functorIds.size(); ++i)
+  {
+    this->Accumulators[functorIds[i]]->Begin();
+  }
+
+  // Each pair of rows is still in the cache when the next accumulator reads it.
+  for(unsigned int row = 0; row < numberOfRows; ++row)
+  {
+    for(size_t i = 0; i < functorIds.size(); ++i)
+    {
+      this->Accumulators[functorIds[i]]->AddRow(sourceRow, targetRow, rowLength);
+    }
+    sourceRow += rowStride;
+    targetRow += rowStride;
+  }
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef IncrementalSSDScoreMap_H
+#define IncrementalSSDScoreMap_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// Qt
+#include <QAtomicInt>
+
+// STL
+#include <vector>
+
+/** The SSD between a target patch and the patch at every position of the image, which is updated
+  * incrementally when the target patch moves by a few pixels.
+  * Moving the target by one pixel (say to the right) moves every source patch with it: the new score of the
+  * source patch at s is the old score of the patch at s - (1,0), minus the squared differences of the column
+  * that left the patches, plus those of the column that entered them. This costs 2h instead of wh operations per
+  * patch, so larger moves are applied one pixel at a time as long as that is cheaper than recomputing.
+  * Sources whose shifted predecessor is outside of the image are computed from scratch.
+  * The sums are accumulated in double precision, so for 8 and 16-bit integer images every term is exact and the
+  * updated scores are the same as recomputed ones. For floating point images each step would add round off that is
+  * never removed, so their scores are always computed from scratch (see IsExact()).
+  * The pixels are copied once per image (or until its modified time changes), and the updates are done on all cores.
+  * Between queries two doubles per patch (the scores and the buffer the next step is written to) and one float per
+  * pixel channel are kept.
+  */
+template <typename TImage>
+class IncrementalSSDScoreMap
+{
+public:
+
+  /** Constructor. */
+  IncrementalSSDScoreMap();
+
+  /** Set the image to compute scores on. */
+  void SetImage(TImage* const image);
+
+  /** Compute the SSD between the target patch and the patch with its corner at every valid position.
+    * The scores are in raster order, with 'scoreSize' (the number of valid corners in each direction) columns
+    * and rows. The corner of the first score is the corner of the image. If the computation is canceled, 'scoreSize'
+    * is 0 and the scores of the last completed step are kept. */
+  const std::vector<double>& ComputeScores(const itk::ImageRegion<2>& targetRegion, itk::Size<2>& scoreSize);
+
+  /** True if the scores for this target region would be updated from the previous ones rather than computed
+    * from scratch, i.e. the pixel type is exact and the region is a small shift of the region of the previous
+    * scores. */
+  bool CanUpdateIncrementally(const itk::ImageRegion<2>& targetRegion) const;
+
+  /** True if moving a target from 'oldTargetRegion' to 'newTargetRegion' is a (non-zero) shift for which updating
+    * the scores one pixel at a time is cheaper than computing them again. */
+  static bool IsSmallShift(const itk::ImageRegion<2>& oldTargetRegion, const itk::ImageRegion<2>& newTargetRegion);
+
+  /** True if the squared differences of the pixels of TImage are exact in double precision, so that scores updated
+    * over any number of steps are the same as scores computed from scratch. Only the scores of such images are
+    * updated. */
+  static bool IsExact();
+
+  /** True if the kept scores are the scores of this target region, so ComputeScores() has nothing to do. */
+  bool HasScores(const itk::ImageRegion<2>& targetRegion) const;
+
+  /** Set a flag that is checked between rows of each pass over the scores. When it becomes non-zero,
+    * ComputeScores() stops soon after. NULL (the default) means the computation cannot be canceled. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+  /** Release the cached pixels and scores. */
+  void ClearCache();
+
+private:
+
+  /** A block of consecutive rows of source patch corners. */
+  struct RowBlock
+  {
+    unsigned int FirstRow;
+    unsigned int EndRow;
+  };
+
+  /** The function object handed to QtConcurrent. It computes (if ColumnStep and RowStep are 0) or updates (after the
+    * target moved by (ColumnStep, RowStep), one of which is +-1) the scores of a block of rows. */
+  struct RowBlockScorer
+  {
+    typedef void result_type;
+
+    RowBlockScorer(IncrementalSSDScoreMap* const owner, const int columnStep, const int rowStep) :
+      Owner(owner), ColumnStep(columnStep), RowStep(rowStep){}
+
+    void operator()(const RowBlock& rowBlock) const
+    {
+      this->Owner->ScoreRows(rowBlock, this->ColumnStep, this->RowStep);
+    }
+
+    IncrementalSSDScoreMap* Owner;
+    int ColumnStep;
+    int RowStep;
+  };
+
+  /** Copy the pixels of the image if it has changed. Returns true if it did. */
+  bool UpdatePixels();
+
+  /** Compute or update the scores of a block of rows into NewScores (see RowBlockScorer). */
+  void ScoreRows(const RowBlock& rowBlock, const int columnStep, const int rowStep);
+
+  /** The SSD of a 'width' x 'height' block of pixels with its corner at (sourceColumn, sourceRow) and the
+    * block at (targetColumn, targetRow). */
+  double BlockSSD(const unsigned int sourceColumn, const unsigned int sourceRow, const unsigned int targetColumn,
+                  const unsigned int targetRow, const unsigned int width, const unsigned int height) const;
+
+  /** Compute or update all of the scores (see RowBlockScorer). Returns false (and keeps the old scores) if it was
+    * canceled. */
+  bool ScoreAllRows(const int columnStep, const int rowStep);
+
+  /** True if the cancel flag is set. */
+  bool IsCancelRequested() const;
+
+  /** True if the cached pixels and scores belong to the current image. */
+  bool IsCacheValid() const;
+
+  /** The position of a target region relative to the corner of the image. */
+  itk::Index<2> GetRelativeCorner(const itk::ImageRegion<2>& targetRegion) const;
+
+  /** The image to compute scores on. */
+  TImage* Image;
+
+  /** The image that the pixels were copied from. */
+  TImage* CachedImage;
+
+  /** The modified time of the image when the pixels were copied. */
+  unsigned long CachedImageMTime;
+
+  /** The width of the image. */
+  unsigned int Width;
+
+  /** The number of channels of the image. */
+  unsigned int NumberOfComponents;
+
+  /** The pixel values, with the channels of each pixel next to each other, in raster order. */
+  std::vector<float> Pixels;
+
+  /** The target region (relative to the corner of the image) that Scores belong to. */
+  itk::ImageRegion<2> ScoredTargetRegion;
+
+  /** The target region that the scores are being moved to. */
+  itk::ImageRegion<2> NewTargetRegion;
+
+  /** The number of valid corners in each direction. */
+  itk::Size<2> ScoreSize;
+
+  /** The scores for ScoredTargetRegion. Empty if there are none. */
+  std::vector<double> Scores;
+
+  /** The scores being computed. It is swapped with Scores after every completed pass, so both buffers are reused. */
+  std::vector<double> NewScores;
+
+  /** The flag that requests the computation to stop (NULL if it cannot be canceled). */
+  const QAtomicInt* CancelFlag;
+};
+
+#include "IncrementalSSDScoreMap.hpp"
+
+#endif
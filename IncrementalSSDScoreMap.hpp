@@ -0,0 +1,348 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef IncrementalSSDScoreMap_HPP
+#define IncrementalSSDScoreMap_HPP
+
+#include "IncrementalSSDScoreMap.h"
+
+// ITK
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+// Qt
+#include <QThread>
+#include <QtConcurrentMap>
+
+// STL
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+template <typename TImage>
+IncrementalSSDScoreMap<TImage>::IncrementalSSDScoreMap() : Image(NULL), CachedImage(NULL), CachedImageMTime(0),
+Width(0), NumberOfComponents(0), CancelFlag(NULL)
+{
+  this->ScoreSize.Fill(0);
+}
+
+template <typename TImage>
+void IncrementalSSDScoreMap<TImage>::SetImage(TImage* const image)
+{
+  this->Image = image;
+}
+
+template <typename TImage>
+void IncrementalSSDScoreMap<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->CancelFlag = cancelFlag;
+}
+
+template <typename TImage>
+bool IncrementalSSDScoreMap<TImage>::IsCancelRequested() const
+{
+  return this->CancelFlag && static_cast<int>(*this->CancelFlag) != 0;
+}
+
+template <typename TImage>
+void IncrementalSSDScoreMap<TImage>::ClearCache()
+{
+  this->Pixels.clear();
+  std::vector<double>().swap(this->Scores);
+  std::vector<double>().swap(this->NewScores);
+  this->CachedImage = NULL;
+  this->CachedImageMTime = 0;
+}
+
+template <typename TImage>
+bool IncrementalSSDScoreMap<TImage>::UpdatePixels()
+{
+  if(this->Image == this->CachedImage && this->Image->GetMTime() == this->CachedImageMTime && !this->Pixels.empty())
+  {
+    return false;
+  }
+
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+  this->Width = fullRegion.GetSize()[0];
+  this->NumberOfComponents = this->Image->GetNumberOfComponentsPerPixel();
+  this->Pixels.resize(fullRegion.GetNumberOfPixels() * this->NumberOfComponents);
+
+  itk::ImageRegionConstIteratorWithIndex<TImage> imageIterator(this->Image, fullRegion);
+  while(!imageIterator.IsAtEnd())
+  {
+    size_t pixelId = (imageIterator.GetIndex()[1] - fullRegion.GetIndex()[1]) * this->Width +
+                     (imageIterator.GetIndex()[0] - fullRegion.GetIndex()[0]);
+    typename TImage::PixelType pixel = imageIterator.Get();
+    for(unsigned int component = 0; component < this->NumberOfComponents; ++component)
+    {
+      this->Pixels[pixelId * this->NumberOfComponents + component] = pixel[component];
+    }
+    ++imageIterator;
+  }
+
+  // The scores belong to the old pixels.
+  this->Scores.clear();
+
+  this->CachedImage = this->Image;
+  this->CachedImageMTime = this->Image->GetMTime();
+  return true;
+}
+
+template <typename TImage>
+bool IncrementalSSDScoreMap<TImage>::IsCacheValid() const
+{
+  return this->Image && this->Image == this->CachedImage && this->Image->GetMTime() == this->CachedImageMTime &&
+         !this->Scores.empty();
+}
+
+template <typename TImage>
+itk::Index<2> IncrementalSSDScoreMap<TImage>::GetRelativeCorner(const itk::ImageRegion<2>& targetRegion) const
+{
+  itk::Index<2> imageCorner = this->Image->GetLargestPossibleRegion().GetIndex();
+  itk::Index<2> relativeCorner = {{targetRegion.GetIndex()[0] - imageCorner[0],
+                                   targetRegion.GetIndex()[1] - imageCorner[1]}};
+  return relativeCorner;
+}
+
+template <typename TImage>
+bool IncrementalSSDScoreMap<TImage>::HasScores(const itk::ImageRegion<2>& targetRegion) const
+{
+  return IsCacheValid() && targetRegion.GetSize() == this->ScoredTargetRegion.GetSize() &&
+         GetRelativeCorner(targetRegion) == this->ScoredTargetRegion.GetIndex();
+}
+
+template <typename TImage>
+bool IncrementalSSDScoreMap<TImage>::IsExact()
+{
+  // The pixels are stored as floats and the squared differences of 16-bit values still fit in the 53 bits of a double.
+  typedef typename TImage::PixelType::ValueType ComponentType;
+  return std::numeric_limits<ComponentType>::is_integer && sizeof(ComponentType) <= 2;
+}
+
+template <typename TImage>
+bool IncrementalSSDScoreMap<TImage>::IsSmallShift(const itk::ImageRegion<2>& oldTargetRegion,
+                                                  const itk::ImageRegion<2>& newTargetRegion)
+{
+  if(oldTargetRegion.GetSize() != newTargetRegion.GetSize() || oldTargetRegion.GetIndex() == newTargetRegion.GetIndex())
+  {
+    return false;
+  }
+
+  const double columnShift = std::abs(newTargetRegion.GetIndex()[0] - oldTargetRegion.GetIndex()[0]);
+  const double rowShift = std::abs(newTargetRegion.GetIndex()[1] - oldTargetRegion.GetIndex()[1]);
+  const double width = newTargetRegion.GetSize()[0];
+  const double height = newTargetRegion.GetSize()[1];
+
+  // Each one pixel step reads two columns (or rows) of every patch, while recomputing reads the whole patch.
+  return 2.0 * (columnShift * height + rowShift * width) < width * height;
+}
+
+template <typename TImage>
+bool IncrementalSSDScoreMap<TImage>::CanUpdateIncrementally(const itk::ImageRegion<2>& targetRegion) const
+{
+  if(!IsExact() || !IsCacheValid())
+  {
+    return false;
+  }
+
+  return IsSmallShift(this->ScoredTargetRegion, itk::ImageRegion<2>(GetRelativeCorner(targetRegion),
+                                                                    targetRegion.GetSize()));
+}
+
+template <typename TImage>
+double IncrementalSSDScoreMap<TImage>::BlockSSD(const unsigned int sourceColumn, const unsigned int sourceRow,
+                                                const unsigned int targetColumn, const unsigned int targetRow,
+                                                const unsigned int width, const unsigned int height) const
+{
+  const size_t rowLength = static_cast<size_t>(width) * this->NumberOfComponents;
+
+  double sum = 0;
+  for(unsigned int row = 0; row < height; ++row)
+  {
+    const float* sourcePixels = &this->Pixels[(static_cast<size_t>(sourceRow + row) * this->Width + sourceColumn) *
+                                              this->NumberOfComponents];
+    const float* targetPixels = &this->Pixels[(static_cast<size_t>(targetRow + row) * this->Width + targetColumn) *
+                                              this->NumberOfComponents];
+    for(size_t element = 0; element < rowLength; ++element)
+    {
+      double difference = sourcePixels[element] - targetPixels[element];
+      sum += difference * difference;
+    }
+  }
+  return sum;
+}
+
+template <typename TImage>
+void IncrementalSSDScoreMap<TImage>::ScoreRows(const RowBlock& rowBlock, const int columnStep, const int rowStep)
+{
+  const unsigned int patchWidth = this->NewTargetRegion.GetSize()[0];
+  const unsigned int patchHeight = this->NewTargetRegion.GetSize()[1];
+  const unsigned int oldTargetColumn = this->ScoredTargetRegion.GetIndex()[0];
+  const unsigned int oldTargetRow = this->ScoredTargetRegion.GetIndex()[1];
+  const unsigned int newTargetColumn = this->NewTargetRegion.GetIndex()[0];
+  const unsigned int newTargetRow = this->NewTargetRegion.GetIndex()[1];
+  const int numberOfColumns = this->ScoreSize[0];
+  const int numberOfRows = this->ScoreSize[1];
+
+  // The strip that leaves the patches is at the start of the old patches when moving forward and at the end when
+  // moving backward, and the strip that enters is at the other end of the new patches.
+  const unsigned int leavingColumnOffset = (columnStep > 0) ? 0 : patchWidth - 1;
+  const unsigned int enteringColumnOffset = (columnStep > 0) ? patchWidth - 1 : 0;
+  const unsigned int leavingRowOffset = (rowStep > 0) ? 0 : patchHeight - 1;
+  const unsigned int enteringRowOffset = (rowStep > 0) ? patchHeight - 1 : 0;
+
+  for(int row = rowBlock.FirstRow; row < static_cast<int>(rowBlock.EndRow); ++row)
+  {
+    // The scores of a canceled pass are thrown away, so the remaining rows do not have to be computed.
+    if(IsCancelRequested())
+    {
+      return;
+    }
+
+    for(int column = 0; column < numberOfColumns; ++column)
+    {
+      const size_t scoreId = static_cast<size_t>(row) * numberOfColumns + column;
+      const int oldColumn = column - columnStep;
+      const int oldRow = row - rowStep;
+
+      if((columnStep == 0 && rowStep == 0) ||
+         oldColumn < 0 || oldColumn >= numberOfColumns || oldRow < 0 || oldRow >= numberOfRows)
+      {
+        this->NewScores[scoreId] = BlockSSD(column, row, newTargetColumn, newTargetRow, patchWidth, patchHeight);
+        continue;
+      }
+
+      double score = this->Scores[static_cast<size_t>(oldRow) * numberOfColumns + oldColumn];
+      if(columnStep != 0)
+      {
+        score -= BlockSSD(oldColumn + leavingColumnOffset, oldRow, oldTargetColumn + leavingColumnOffset, oldTargetRow,
+                          1, patchHeight);
+        score += BlockSSD(column + enteringColumnOffset, row, newTargetColumn + enteringColumnOffset, newTargetRow,
+                          1, patchHeight);
+      }
+      else
+      {
+        score -= BlockSSD(oldColumn, oldRow + leavingRowOffset, oldTargetColumn, oldTargetRow + leavingRowOffset,
+                          patchWidth, 1);
+        score += BlockSSD(column, row + enteringRowOffset, newTargetColumn, newTargetRow + enteringRowOffset,
+                          patchWidth, 1);
+      }
+      this->NewScores[scoreId] = score;
+    }
+  }
+}
+
+template <typename TImage>
+bool IncrementalSSDScoreMap<TImage>::ScoreAllRows(const int columnStep, const int rowStep)
+{
+  this->NewScores.resize(static_cast<size_t>(this->ScoreSize[0]) * this->ScoreSize[1]);
+
+  const unsigned int blocksPerThread = 8;
+  unsigned int rowsPerBlock = std::max<unsigned int>(this->ScoreSize[1] / (blocksPerThread * std::max(QThread::idealThreadCount(), 1)), 1);
+  std::vector<RowBlock> rowBlocks;
+  for(unsigned int row = 0; row < this->ScoreSize[1]; row += rowsPerBlock)
+  {
+    RowBlock rowBlock;
+    rowBlock.FirstRow = row;
+    rowBlock.EndRow = std::min<unsigned int>(row + rowsPerBlock, this->ScoreSize[1]);
+    rowBlocks.push_back(rowBlock);
+  }
+
+  QtConcurrent::blockingMap(rowBlocks, RowBlockScorer(this, columnStep, rowStep));
+
+  if(IsCancelRequested())
+  {
+    return false;
+  }
+
+  this->Scores.swap(this->NewScores);
+  this->ScoredTargetRegion = this->NewTargetRegion;
+  return true;
+}
+
+template <typename TImage>
+const std::vector<double>& IncrementalSSDScoreMap<TImage>::ComputeScores(const itk::ImageRegion<2>& targetRegion,
+                                                                         itk::Size<2>& scoreSize)
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("IncrementalSSDScoreMap: Must call SetImage() before computing scores!");
+  }
+
+  UpdatePixels();
+
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+  itk::Index<2> relativeTargetCorner = GetRelativeCorner(targetRegion);
+  itk::ImageRegion<2> relativeTargetRegion(relativeTargetCorner, targetRegion.GetSize());
+
+  if(HasScores(targetRegion))
+  {
+    scoreSize = this->ScoreSize;
+    return this->Scores;
+  }
+
+  if(targetRegion.GetSize()[0] > fullRegion.GetSize()[0] || targetRegion.GetSize()[1] > fullRegion.GetSize()[1])
+  {
+    this->Scores.clear();
+    this->ScoreSize.Fill(0);
+    scoreSize = this->ScoreSize;
+    return this->Scores;
+  }
+
+  bool completed = true;
+  if(CanUpdateIncrementally(targetRegion))
+  {
+    // Move the target one pixel at a time, first along the rows and then along the columns. A canceled step leaves
+    // the scores of the last completed step, which are still consistent with ScoredTargetRegion.
+    for(unsigned int dimension = 0; dimension < 2 && completed; ++dimension)
+    {
+      while(completed && this->ScoredTargetRegion.GetIndex()[dimension] != relativeTargetCorner[dimension])
+      {
+        int step = (relativeTargetCorner[dimension] > this->ScoredTargetRegion.GetIndex()[dimension]) ? 1 : -1;
+        itk::Index<2> nextCorner = this->ScoredTargetRegion.GetIndex();
+        nextCorner[dimension] += step;
+        this->NewTargetRegion = itk::ImageRegion<2>(nextCorner, targetRegion.GetSize());
+        completed = ScoreAllRows(dimension == 0 ? step : 0, dimension == 1 ? step : 0);
+      }
+    }
+  }
+  else
+  {
+    itk::Size<2> newScoreSize = {{fullRegion.GetSize()[0] - targetRegion.GetSize()[0] + 1,
+                                  fullRegion.GetSize()[1] - targetRegion.GetSize()[1] + 1}};
+    if(newScoreSize != this->ScoreSize)
+    {
+      // The old scores do not match the new size, so they cannot be kept if this is canceled.
+      this->Scores.clear();
+      this->ScoreSize = newScoreSize;
+    }
+    this->NewTargetRegion = relativeTargetRegion;
+    completed = ScoreAllRows(0, 0);
+  }
+
+  if(!completed)
+  {
+    scoreSize.Fill(0);
+    return this->Scores;
+  }
+
+  scoreSize = this->ScoreSize;
+  return this->Scores;
+}
+
+#endif
@@ -0,0 +1,174 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef IntegralHistogramCache_H
+#define IntegralHistogramCache_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// Qt
+#include <QAtomicInt>
+#include <QMutex>
+
+// STL
+#include <vector>
+
+// C
+#include <stdint.h>
+
+/** Integral histograms of an image, so that the histogram of any channel over any region can be read with four
+  * lookups per bin, regardless of the patch size. Each pixel value is assigned to one of NumberOfBinsPerComponent
+  * equal width bins spanning the range of its channel in the image, and for every bin there is a summed area table
+  * of the number of pixels in that bin.
+  * The tables are only built when they are first needed (see Update()), since they take
+  * (width + 1) * (height + 1) * bins * channels 16-bit counters. The counters wrap around, but the count of a region
+  * is a difference of four of them, so it is still exact for regions of up to MaximumTableRegionPixels pixels.
+  * Until the tables are built (or for larger regions), the histograms are counted from the pixels, with the same
+  * bins. The Get functions are safe to call concurrently, as long as the image does not change.
+  */
+template <typename TImage>
+class IntegralHistogramCache
+{
+public:
+
+  /** The largest number of pixels of a region whose histogram is read from the tables. */
+  static const unsigned int MaximumTableRegionPixels = 65535;
+
+  /** Constructor. */
+  IntegralHistogramCache();
+
+  /** Set the image. */
+  void SetImage(TImage* const image);
+
+  /** Set the number of bins of the histogram of each channel. */
+  void SetNumberOfBinsPerComponent(const unsigned int numberOfBinsPerComponent);
+
+  /** Get the number of bins of the histogram of each channel. */
+  unsigned int GetNumberOfBinsPerComponent() const;
+
+  /** Get the number of channels of the image the bins were set up for. */
+  unsigned int GetNumberOfComponents() const;
+
+  /** Force the bins and tables to be rebuilt (e.g. if the image was modified in place). */
+  void Invalidate();
+
+  /** Compute the range of each channel, which the bins span, if the image has changed. This is one pass over the
+    * image and keeps nothing per pixel. It is enough to compare a few patches (their pixels are counted). */
+  void UpdateBinRanges();
+
+  /** Compute the bin ranges and build the tables if the image has changed. This can be called from several threads
+    * at once (e.g. by the first comparisons of a search): one of them builds the tables and the others wait. */
+  void Update();
+
+  /** True if the tables are built and current. */
+  bool HasTables() const;
+
+  /** Get the number of pixels of a region in each bin of a channel. */
+  std::vector<unsigned int> GetHistogram(const itk::ImageRegion<2>& region, const unsigned int component) const;
+
+  /** Get the sum over the bins of the absolute difference between the normalized (summing to 1) histograms of a
+    * channel over two regions. With the tables this does not allocate, so it is cheap enough to call for every
+    * source patch. */
+  float GetHistogramDifference(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2,
+                               const unsigned int component) const;
+
+  /** Get the normalized histogram of a channel over a region, to compare many regions to it with
+    * GetHistogramDifference(). */
+  void GetNormalizedHistogram(const itk::ImageRegion<2>& region, const unsigned int component,
+                              std::vector<double>& histogram) const;
+
+  /** The same as GetHistogramDifference(region1, region2, component), where 'normalizedHistogram' is the
+    * normalized histogram of region2 from GetNormalizedHistogram(). */
+  float GetHistogramDifference(const itk::ImageRegion<2>& region1, const std::vector<double>& normalizedHistogram,
+                               const unsigned int component) const;
+
+private:
+
+  /** The cache can not be copied, because of the mutex. */
+  IntegralHistogramCache(const IntegralHistogramCache&);
+  void operator=(const IntegralHistogramCache&);
+
+  /** True if the bins were set up for the current image and number of bins. */
+  bool AreBinRangesCurrent() const;
+
+  /** Compute the bin ranges. Requires UpdateMutex. */
+  void ComputeBinRanges();
+
+  /** Build the tables. Requires UpdateMutex and current bin ranges. */
+  void BuildTables();
+
+  /** Get the bin of a value of a channel. */
+  unsigned int GetBin(const double value, const unsigned int component) const;
+
+  /** True if the histogram of the region is read from the tables (rather than counted from the pixels). */
+  bool UseTables(const itk::ImageRegion<2>& region) const;
+
+  /** Get the number of pixels of a region in each bin of a channel, counted from the pixels. */
+  void CountHistogram(const itk::ImageRegion<2>& region, const unsigned int component,
+                      std::vector<unsigned int>& counts) const;
+
+  /** Get the offsets of the table entries at the four corners of a region, in the order (top, left),
+    * (top, right), (bottom, left), (bottom, right). */
+  void GetCornerOffsets(const itk::ImageRegion<2>& region, size_t offsets[4]) const;
+
+  /** Get the count of a bin from the four corner entries of a region (see GetCornerOffsets()). */
+  unsigned int GetTableCount(const uint16_t* const table, const size_t offsets[4], const unsigned int bin) const;
+
+  /** The image. */
+  TImage* Image;
+
+  /** The image the bins (and tables) were set up for. */
+  TImage* CachedImage;
+
+  /** The modified time of the image when the bins were set up. */
+  unsigned long CachedImageMTime;
+
+  /** The number of bins of the histogram of each channel. */
+  unsigned int NumberOfBinsPerComponent;
+
+  /** The number of bins the bins ranges (and tables) were set up with. */
+  unsigned int CachedNumberOfBinsPerComponent;
+
+  /** Non-zero if the bin ranges are set up for the cached image and number of bins. */
+  QAtomicInt BinRangesReady;
+
+  /** Non-zero if the tables are built for the cached image and number of bins. */
+  QAtomicInt TablesReady;
+
+  /** Guards the building of the bin ranges and tables. */
+  QMutex UpdateMutex;
+
+  /** The region of the image the bins and tables cover. */
+  itk::ImageRegion<2> FullRegion;
+
+  /** The smallest value of each channel. */
+  std::vector<double> MinimumValues;
+
+  /** The range (maximum - minimum) of each channel. */
+  std::vector<double> ValueRanges;
+
+  /** Per channel tables. The bins of a table entry are stored together, so the entry (row, column) of bin b is at
+    * (row * (width + 1) + column) * bins + b. Each table has an extra row and column of zeros at the top and left. */
+  std::vector<std::vector<uint16_t> > BinCountTables;
+};
+
+#include "IntegralHistogramCache.hpp"
+
+#endif
@@ -0,0 +1,391 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef IntegralHistogramCache_HPP
+#define IntegralHistogramCache_HPP
+
+#include "IntegralHistogramCache.h"
+
+// ITK
+#include "itkImageRegionConstIterator.h"
+
+// Qt
+#include <QMutexLocker>
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+template <typename TImage>
+IntegralHistogramCache<TImage>::IntegralHistogramCache() : Image(NULL), CachedImage(NULL), CachedImageMTime(0),
+NumberOfBinsPerComponent(20), CachedNumberOfBinsPerComponent(0), BinRangesReady(0), TablesReady(0)
+{
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::SetImage(TImage* const image)
+{
+  this->Image = image;
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::SetNumberOfBinsPerComponent(const unsigned int numberOfBinsPerComponent)
+{
+  if(numberOfBinsPerComponent == 0)
+  {
+    throw std::runtime_error("IntegralHistogramCache: The number of bins must be at least 1!");
+  }
+  this->NumberOfBinsPerComponent = numberOfBinsPerComponent;
+}
+
+template <typename TImage>
+unsigned int IntegralHistogramCache<TImage>::GetNumberOfBinsPerComponent() const
+{
+  return this->NumberOfBinsPerComponent;
+}
+
+template <typename TImage>
+unsigned int IntegralHistogramCache<TImage>::GetNumberOfComponents() const
+{
+  return this->MinimumValues.size();
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::Invalidate()
+{
+  QMutexLocker locker(&this->UpdateMutex);
+  this->BinRangesReady = 0;
+  this->TablesReady = 0;
+  this->BinCountTables.clear();
+}
+
+template <typename TImage>
+bool IntegralHistogramCache<TImage>::AreBinRangesCurrent() const
+{
+  return this->BinRangesReady && this->Image == this->CachedImage &&
+         this->Image->GetMTime() == this->CachedImageMTime &&
+         this->NumberOfBinsPerComponent == this->CachedNumberOfBinsPerComponent;
+}
+
+template <typename TImage>
+bool IntegralHistogramCache<TImage>::HasTables() const
+{
+  return this->TablesReady && AreBinRangesCurrent();
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::UpdateBinRanges()
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("IntegralHistogramCache: Must call SetImage() before UpdateBinRanges()!");
+  }
+
+  if(AreBinRangesCurrent())
+  {
+    return;
+  }
+
+  QMutexLocker locker(&this->UpdateMutex);
+  // Another thread may have set up the bins while this one waited.
+  if(!AreBinRangesCurrent())
+  {
+    ComputeBinRanges();
+  }
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::Update()
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("IntegralHistogramCache: Must call SetImage() before Update()!");
+  }
+
+  if(HasTables())
+  {
+    return;
+  }
+
+  QMutexLocker locker(&this->UpdateMutex);
+  // Another thread may have built the tables while this one waited.
+  if(HasTables())
+  {
+    return;
+  }
+  if(!AreBinRangesCurrent())
+  {
+    ComputeBinRanges();
+  }
+  BuildTables();
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::ComputeBinRanges()
+{
+  // The old tables do not match the new bins.
+  this->BinRangesReady = 0;
+  this->TablesReady = 0;
+  this->BinCountTables.clear();
+
+  this->FullRegion = this->Image->GetLargestPossibleRegion();
+  const unsigned int numberOfComponents = this->Image->GetNumberOfComponentsPerPixel();
+
+  std::vector<double> minimumValues(numberOfComponents, std::numeric_limits<double>::max());
+  std::vector<double> maximumValues(numberOfComponents, -std::numeric_limits<double>::max());
+  itk::ImageRegionConstIterator<TImage> imageIterator(this->Image, this->FullRegion);
+  while(!imageIterator.IsAtEnd())
+  {
+    typename TImage::PixelType pixel = imageIterator.Get();
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      minimumValues[component] = std::min(minimumValues[component], static_cast<double>(pixel[component]));
+      maximumValues[component] = std::max(maximumValues[component], static_cast<double>(pixel[component]));
+    }
+    ++imageIterator;
+  }
+
+  this->MinimumValues = minimumValues;
+  this->ValueRanges.resize(numberOfComponents);
+  for(unsigned int component = 0; component < numberOfComponents; ++component)
+  {
+    this->ValueRanges[component] = maximumValues[component] - minimumValues[component];
+  }
+
+  this->CachedImage = this->Image;
+  this->CachedImageMTime = this->Image->GetMTime();
+  this->CachedNumberOfBinsPerComponent = this->NumberOfBinsPerComponent;
+  this->BinRangesReady.fetchAndStoreOrdered(1);
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::BuildTables()
+{
+  const unsigned int width = this->FullRegion.GetSize()[0];
+  const unsigned int height = this->FullRegion.GetSize()[1];
+  const unsigned int numberOfComponents = this->MinimumValues.size();
+  const unsigned int numberOfBins = this->CachedNumberOfBinsPerComponent;
+
+  // Each table entry (row + 1, column + 1) is the entry above it plus the running counts of the current row. The
+  // 16-bit counters wrap around, which GetTableCount() undoes.
+  const size_t stride = static_cast<size_t>(width + 1) * numberOfBins;
+  this->BinCountTables.assign(numberOfComponents, std::vector<uint16_t>(stride * (height + 1), 0));
+  std::vector<std::vector<uint16_t> > rowCounts(numberOfComponents, std::vector<uint16_t>(numberOfBins));
+
+  itk::ImageRegionConstIterator<TImage> imageIterator(this->Image, this->FullRegion);
+  for(unsigned int row = 0; row < height; ++row)
+  {
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      std::fill(rowCounts[component].begin(), rowCounts[component].end(), 0);
+    }
+
+    for(unsigned int column = 0; column < width; ++column, ++imageIterator)
+    {
+      typename TImage::PixelType pixel = imageIterator.Get();
+      for(unsigned int component = 0; component < numberOfComponents; ++component)
+      {
+        uint16_t* counts = &rowCounts[component][0];
+        counts[GetBin(pixel[component], component)]++;
+
+        uint16_t* entry = &this->BinCountTables[component][(row + 1) * stride + (column + 1) * numberOfBins];
+        const uint16_t* entryAbove = entry - stride;
+        for(unsigned int bin = 0; bin < numberOfBins; ++bin)
+        {
+          entry[bin] = static_cast<uint16_t>(entryAbove[bin] + counts[bin]);
+        }
+      }
+    }
+  }
+
+  this->TablesReady.fetchAndStoreOrdered(1);
+}
+
+template <typename TImage>
+unsigned int IntegralHistogramCache<TImage>::GetBin(const double value, const unsigned int component) const
+{
+  const unsigned int numberOfBins = this->CachedNumberOfBinsPerComponent;
+  unsigned int bin = 0;
+  if(this->ValueRanges[component] > 0)
+  {
+    bin = static_cast<unsigned int>((value - this->MinimumValues[component]) / this->ValueRanges[component] *
+                                    numberOfBins);
+  }
+  // The maximum value goes in the last bin.
+  return std::min(bin, numberOfBins - 1);
+}
+
+template <typename TImage>
+bool IntegralHistogramCache<TImage>::UseTables(const itk::ImageRegion<2>& region) const
+{
+  return this->TablesReady && region.GetNumberOfPixels() <= MaximumTableRegionPixels;
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::CountHistogram(const itk::ImageRegion<2>& region, const unsigned int component,
+                                                    std::vector<unsigned int>& counts) const
+{
+  if(!this->BinRangesReady)
+  {
+    throw std::runtime_error("IntegralHistogramCache: Must call UpdateBinRanges() or Update() first!");
+  }
+
+  counts.assign(this->CachedNumberOfBinsPerComponent, 0);
+  itk::ImageRegionConstIterator<TImage> imageIterator(this->Image, region);
+  while(!imageIterator.IsAtEnd())
+  {
+    counts[GetBin(imageIterator.Get()[component], component)]++;
+    ++imageIterator;
+  }
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::GetCornerOffsets(const itk::ImageRegion<2>& region, size_t offsets[4]) const
+{
+  const size_t numberOfBins = this->CachedNumberOfBinsPerComponent;
+  const size_t stride = (this->FullRegion.GetSize()[0] + 1) * numberOfBins;
+  const size_t left = region.GetIndex()[0] - this->FullRegion.GetIndex()[0];
+  const size_t top = region.GetIndex()[1] - this->FullRegion.GetIndex()[1];
+  const size_t right = left + region.GetSize()[0];
+  const size_t bottom = top + region.GetSize()[1];
+
+  offsets[0] = top * stride + left * numberOfBins;
+  offsets[1] = top * stride + right * numberOfBins;
+  offsets[2] = bottom * stride + left * numberOfBins;
+  offsets[3] = bottom * stride + right * numberOfBins;
+}
+
+template <typename TImage>
+unsigned int IntegralHistogramCache<TImage>::GetTableCount(const uint16_t* const table, const size_t offsets[4],
+                                                           const unsigned int bin) const
+{
+  // The counters wrapped around modulo 2^16, so the difference is exact as long as the count is below 2^16.
+  return static_cast<uint16_t>(table[offsets[3] + bin] - table[offsets[1] + bin] - table[offsets[2] + bin] +
+                               table[offsets[0] + bin]);
+}
+
+template <typename TImage>
+std::vector<unsigned int> IntegralHistogramCache<TImage>::GetHistogram(const itk::ImageRegion<2>& region,
+                                                                       const unsigned int component) const
+{
+  std::vector<unsigned int> histogram;
+  if(!UseTables(region))
+  {
+    CountHistogram(region, component, histogram);
+    return histogram;
+  }
+
+  size_t offsets[4];
+  GetCornerOffsets(region, offsets);
+
+  const uint16_t* table = &this->BinCountTables[component][0];
+  histogram.resize(this->CachedNumberOfBinsPerComponent);
+  for(unsigned int bin = 0; bin < histogram.size(); ++bin)
+  {
+    histogram[bin] = GetTableCount(table, offsets, bin);
+  }
+
+  return histogram;
+}
+
+template <typename TImage>
+float IntegralHistogramCache<TImage>::GetHistogramDifference(const itk::ImageRegion<2>& region1,
+                                                             const itk::ImageRegion<2>& region2,
+                                                             const unsigned int component) const
+{
+  if(!UseTables(region1) || !UseTables(region2))
+  {
+    std::vector<double> normalizedHistogram2;
+    GetNormalizedHistogram(region2, component, normalizedHistogram2);
+    return GetHistogramDifference(region1, normalizedHistogram2, component);
+  }
+
+  size_t offsets1[4];
+  GetCornerOffsets(region1, offsets1);
+  size_t offsets2[4];
+  GetCornerOffsets(region2, offsets2);
+
+  const double normalization1 = 1.0 / std::max<size_t>(region1.GetNumberOfPixels(), 1);
+  const double normalization2 = 1.0 / std::max<size_t>(region2.GetNumberOfPixels(), 1);
+
+  const uint16_t* table = &this->BinCountTables[component][0];
+  double difference = 0;
+  for(unsigned int bin = 0; bin < this->CachedNumberOfBinsPerComponent; ++bin)
+  {
+    difference += std::fabs(GetTableCount(table, offsets1, bin) * normalization1 -
+                            GetTableCount(table, offsets2, bin) * normalization2);
+  }
+
+  return difference;
+}
+
+template <typename TImage>
+void IntegralHistogramCache<TImage>::GetNormalizedHistogram(const itk::ImageRegion<2>& region,
+                                                            const unsigned int component,
+                                                            std::vector<double>& histogram) const
+{
+  const std::vector<unsigned int> counts = GetHistogram(region, component);
+  const double normalization = 1.0 / std::max<size_t>(region.GetNumberOfPixels(), 1);
+
+  histogram.resize(counts.size());
+  for(unsigned int bin = 0; bin < counts.size(); ++bin)
+  {
+    histogram[bin] = counts[bin] * normalization;
+  }
+}
+
+template <typename TImage>
+float IntegralHistogramCache<TImage>::GetHistogramDifference(const itk::ImageRegion<2>& region1,
+                                                             const std::vector<double>& normalizedHistogram,
+                                                             const unsigned int component) const
+{
+  if(normalizedHistogram.size() != this->CachedNumberOfBinsPerComponent)
+  {
+    throw std::runtime_error("IntegralHistogramCache: The histogram was not created with GetNormalizedHistogram()!");
+  }
+
+  const double normalization = 1.0 / std::max<size_t>(region1.GetNumberOfPixels(), 1);
+
+  double difference = 0;
+  if(!UseTables(region1))
+  {
+    std::vector<unsigned int> counts;
+    CountHistogram(region1, component, counts);
+    for(unsigned int bin = 0; bin < counts.size(); ++bin)
+    {
+      difference += std::fabs(counts[bin] * normalization - normalizedHistogram[bin]);
+    }
+    return difference;
+  }
+
+  size_t offsets[4];
+  GetCornerOffsets(region1, offsets);
+
+  const uint16_t* table = &this->BinCountTables[component][0];
+  for(unsigned int bin = 0; bin < this->CachedNumberOfBinsPerComponent; ++bin)
+  {
+    difference += std::fabs(GetTableCount(table, offsets, bin) * normalization - normalizedHistogram[bin]);
+  }
+
+  return difference;
+}
+
+#endif
@@ -65,6 +65,11 @@
 #include "SwitchBetweenStyle.h"
 #include "Types.h"
 #include "OddValidator.h"
+#include "PartialSSD.h"
+#include "CachedAverageValueDifference.h"
+#include "CachedHistogramDistance.h"
+#include "CachedVarianceDifference.h"
+#include "LabSSD.h"
 
 // Patch Comparison Submodule
 #include "PatchComparison/AverageValueDifference.h"
@@ -114,6 +119,9 @@ InteractivePatchComparisonWidget::InteractivePatchComparisonWidget(const std::st
 
 void InteractivePatchComparisonWidget::SharedConstructor()
 {
+  this->TopPatchesImage = NULL;
+  this->TopPatchesImageMTime = 0;
+
   this->setupUi(this);
   this->setAcceptDrops(true);
 
@@ -125,6 +133,9 @@ void InteractivePatchComparisonWidget::SharedConstructor()
   this->SourcePatchInfoWidgetPlaceholder->addWidget(this->SourcePatchInfoWidget);
   this->SourcePatchInfoWidgetPlaceholder->setCurrentWidget(this->SourcePatchInfoWidget);
 
+  this->TargetPatchInfoWidget->SetStatisticsCache(&this->StatisticsCache);
+  this->SourcePatchInfoWidget->SetStatisticsCache(&this->StatisticsCache);
+
   OddValidator* oddValidator = new OddValidator;
   this->spinPatchRadius->findChild<QLineEdit*>()->setValidator(oddValidator);
 
@@ -291,6 +302,15 @@ void InteractivePatchComparisonWidget::OpenImage(const std::string& fileName)
     this->SourcePatchInfoWidget->SetMask(this->MaskImage);
   }
 
+  // The summed area tables are only built by the first search that needs them.
+  this->StatisticsCache.SetImage(this->Image);
+  this->StatisticsCache.SetMask(this->MaskImage);
+  this->StatisticsCache.Invalidate();
+
+  // The derived images of the previous image are not valid anymore.
+  this->DerivedImages.SetImage(this->Image);
+  this->DerivedImages.Invalidate();
+
   SetupDistanceFunctors();
 
   UpdatePatches();
@@ -326,6 +346,9 @@ void InteractivePatchComparisonWidget::OpenMask(const std::string& fileName)
   this->TargetPatchInfoWidget->SetMask(this->MaskImage);
   this->SourcePatchInfoWidget->SetMask(this->MaskImage);
 
+  this->StatisticsCache.SetMask(this->MaskImage);
+  this->StatisticsCache.Invalidate();
+
   this->MaskImageLayer.ImageSlice->VisibilityOn();
 
   Refresh();
@@ -418,6 +441,9 @@ void InteractivePatchComparisonWidget::on_actionOpenMaskInverted_activated()
   on_actionOpenMask_activated();
   this->MaskImage->InvertData();
   this->MaskImage->Cleanup();
+
+  // The mask was modified in place
+  this->StatisticsCache.Invalidate();
   }
 
 void InteractivePatchComparisonWidget::on_actionOpenMask_activated()
@@ -495,13 +521,7 @@ void InteractivePatchComparisonWidget::slot_TargetPatchMoved(const itk::ImageReg
 
   this->TargetRegion = patchRegion;
 
-  // Update the TopPatches widgets
-  for(unsigned int i = 0; i < this->TopPatchesWidgets.size(); ++i)
-  {
-    this->TopPatchesWidgets[i]->SetTargetRegion(patchRegion);
-  }
-
-  // Refresh
+  // Refresh. UpdatePatches also gives the new target to the TopPatches widgets.
   Refresh();
   UpdatePatches();
 }
@@ -537,9 +557,12 @@ void InteractivePatchComparisonWidget::UpdatePatches()
   else
   {
     // Set the TopPatchesWidgets to use the new target patch
-    for(unsigned int i = 0; i < this->TopPatchesWidgets.size(); ++i)
+    for(unsigned int i = 0; i < this->DistanceFunctors.GetNumberOfEntries(); ++i)
     {
-      this->TopPatchesWidgets[i]->SetTargetRegion(this->TargetRegion);
+      if(this->DistanceFunctors.GetEntry(i).TopPatchesWindow)
+      {
+        this->DistanceFunctors.GetEntry(i).TopPatchesWindow->SetTargetRegion(this->TargetRegion);
+      }
     }
 
     emit signal_TargetPatchMoved(this->TargetRegion);
@@ -566,12 +589,16 @@ void InteractivePatchComparisonWidget::UpdatePatches()
 
 void InteractivePatchComparisonWidget::ComputeDifferences()
 {
-  for(size_t i = 0; i < this->DistanceFunctors.size(); ++i)
+  // The functors that read the same pixels share a single pass over the two patches.
+  std::vector<float> distances;
+  this->DistanceFunctors.ComputeDistances(this->SourceRegion, this->TargetRegion, distances);
+
+  for(unsigned int i = 0; i < this->DistanceFunctors.GetNumberOfEntries(); ++i)
   {
-    float distance = this->DistanceFunctors[i]->Distance(this->SourceRegion, this->TargetRegion);
+    const DistanceFunctorRegistry<ImageType>::Entry& entry = this->DistanceFunctors.GetEntry(i);
     std::stringstream ss;
-    ss << this->DistanceFunctors[i]->GetDistanceName() << ": " << distance;
-    this->ScoreDisplayMap[this->DistanceFunctors[i]]->setText(ss.str().c_str());
+    ss << entry.Functor->GetDistanceName() << ": " << distances[i];
+    entry.ScoreLabel->setText(ss.str().c_str());
   }
 }
 
@@ -657,66 +684,70 @@ void InteractivePatchComparisonWidget::SetupDistanceFunctors()
     throw std::runtime_error("Cannot SetupDistanceFunctors() before calling SetImage()!");
   }
 
-  this->TopPatchesWidgets.clear();
+  // None of the functors depend on the patch size, so after the first call this only points them at the
+  // current image. The derived images and integral histograms are cached, so this is cheap unless the image changed.
+  if(this->DistanceFunctors.IsEmpty())
+  {
+    CreateDistanceFunctors();
+  }
+
+  ConfigureDistanceFunctors();
+}
+
+void InteractivePatchComparisonWidget::AddDistanceFunctor(const std::string& name,
+                                                          PatchDistance<ImageType>* const functor,
+                                                          const bool showTopPatches)
+{
+  QLabel* scoreLabel = new QLabel;
+  this->layoutScores->addWidget(scoreLabel);
 
+  TopPatchesWidget<ImageType>* topPatchesWidget = NULL;
+  if(showTopPatches)
+  {
+    topPatchesWidget = new TopPatchesWidget<ImageType>;
+    topPatchesWidget->SetPatchDistanceFunctor(functor);
+    topPatchesWidget->setWindowTitle(name.c_str());
+    topPatchesWidget->show();
+
+    // This is used when the user clicks on a top patch in the view of the top patches.
+    connect(topPatchesWidget,
+            SIGNAL(signal_TopPatchesSelected(const std::vector<itk::ImageRegion<2> >&)),
+            this, SLOT(slot_SelectedPatchesChanged(const std::vector<itk::ImageRegion<2> >& )));
+  }
+
+  this->DistanceFunctors.Add(name, functor, scoreLabel, topPatchesWidget);
+}
+
+void InteractivePatchComparisonWidget::CreateDistanceFunctors()
+{
   ////////////////// Setup the normal top patches widget //////////////////
-  SSD<ImageType>* ssdDistanceFunctor = new SSD<ImageType>;
-  ssdDistanceFunctor->SetImage(this->Image);
-  this->DistanceFunctors.push_back(ssdDistanceFunctor);
-
-  QLabel* ssdLabel = new QLabel;
-  this->layoutScores->addWidget(ssdLabel);
-  this->ScoreDisplayMap[ssdDistanceFunctor] = ssdLabel;
-
-  TopPatchesWidget<ImageType>* ssdTopPatchesWidget = new TopPatchesWidget<ImageType>;
-  ssdTopPatchesWidget->SetPatchDistanceFunctor(ssdDistanceFunctor);
-  ssdTopPatchesWidget->SetImage(this->Image);
-  ssdTopPatchesWidget->setWindowTitle("SSD");
-  this->TopPatchesWidgets.push_back(ssdTopPatchesWidget);
-  ssdTopPatchesWidget->show();
-
-  // This is used when the user clicks on a top patch in the view of the top patches.
-  connect(ssdTopPatchesWidget,
-          SIGNAL(signal_TopPatchesSelected(const std::vector<itk::ImageRegion<2> >&)),
-          this, SLOT(slot_SelectedPatchesChanged(const std::vector<itk::ImageRegion<2> >& )));
+  // PartialSSD lets the top patches search skip the rest of a candidate once it can no longer be one of the best.
+  AddDistanceFunctor("SSD", new PartialSSD<ImageType>, true);
 
   ////////////////// Setup the histogram top patches widget //////////////////
   // RGB Histogram
 //   HistogramDistance<ImageType>* histogramDistanceFunctor = new HistogramDistance<ImageType>;
 //   histogramDistanceFunctor->SetImage(this->Image);
 
-  typedef itk::VectorImage<float, 2> HSVImageType;
-  HSVImageType::Pointer hsvImage = HSVImageType::New();
-  ITKHelpers::ITKImageToHSVImage(this->Image.GetPointer(), hsvImage.GetPointer());
+  // The histograms are read from integral histograms, so the cost does not depend on the patch size.
+  // The patches are displayed from the RGB image, but compared in the HSV image (the regions are the same).
+  CachedHistogramDistance<ImageType>* histogramDistanceFunctor = new CachedHistogramDistance<ImageType>;
+  histogramDistanceFunctor->SetHistogramCache(&this->HSVHistogramCache);
+  histogramDistanceFunctor->SetDistanceNameModifier("HSV");
+  AddDistanceFunctor("HSV Histogram Distance", histogramDistanceFunctor, true);
 
-  ITKHelpers::ScaleAllChannelsTo255(hsvImage.GetPointer());
-  this->HSVImage = ImageType::New();
-  ITKHelpers::CastImage(hsvImage.GetPointer(), this->HSVImage.GetPointer());
+  ////////////////// Setup the Lab SSD top patches widget //////////////////
+  AddDistanceFunctor("Lab SSD", new LabSSD<ImageType>, true);
 
-  // Convert back to an uchar image so our distance functor vector can hold the object
-  HistogramDistance<ImageType>* histogramDistanceFunctor = new HistogramDistance<ImageType>;
-  histogramDistanceFunctor->SetImage(this->HSVImage);
-  histogramDistanceFunctor->SetDistanceNameModifier("HSV");
-  this->DistanceFunctors.push_back(histogramDistanceFunctor);
-
-  QLabel* histogramDistanceLabel = new QLabel;
-  this->layoutScores->addWidget(histogramDistanceLabel);
-  this->ScoreDisplayMap[histogramDistanceFunctor] = histogramDistanceLabel;
-  //ssdTopPatchesWidget->SetSecondaryPatchDistanceFunctor(histogramDistanceFunctor);
-
-  // It is much too slow to compare histograms for every source patch
-//   TopPatchesWidget<ImageType>* histogramTopPatchesWidget = new TopPatchesWidget<ImageType>;
-//   histogramTopPatchesWidget->SetPatchDistanceFunctor(histogramDistanceFunctor);
-//   histogramTopPatchesWidget->SetImage(this->Image);
-//   histogramTopPatchesWidget->setWindowTitle("Histogram Distance");
-//   this->TopPatchesWidgets.push_back(histogramTopPatchesWidget);
-//   histogramTopPatchesWidget->show();
-// 
-//   // This is used when the user clicks on a top patch in the view of the top patches.
-//   connect(histogramTopPatchesWidget,
-//           SIGNAL(signal_TopPatchesSelected(const std::vector<itk::ImageRegion<2> >&)),
-//           this, SLOT(slot_SelectedPatchesChanged(const std::vector<itk::ImageRegion<2> >& )));
+  ////////////////// Setup the patch statistics scores //////////////////
+  // These read the same statistics as the PatchInfoWidgets, and only show a score.
+  CachedAverageValueDifference<ImageType>* averageValueDifferenceFunctor = new CachedAverageValueDifference<ImageType>;
+  averageValueDifferenceFunctor->SetStatisticsCache(&this->StatisticsCache);
+  AddDistanceFunctor("Average Value Difference", averageValueDifferenceFunctor, false);
 
+  CachedVarianceDifference<ImageType>* varianceDifferenceFunctor = new CachedVarianceDifference<ImageType>;
+  varianceDifferenceFunctor->SetStatisticsCache(&this->StatisticsCache);
+  AddDistanceFunctor("Variance Difference", varianceDifferenceFunctor, false);
   //////////////// Setup the blurred top patches widget //////////////////
 //   this->BlurredImage = ImageType::New();
 //   //float sigma = 2.0f;
@@ -745,6 +776,46 @@ void InteractivePatchComparisonWidget::SetupDistanceFunctors()
 
 }
 
+void InteractivePatchComparisonWidget::ConfigureDistanceFunctors()
+{
+  this->DistanceFunctors.GetFunctor<PartialSSD<ImageType> >("SSD")->SetImage(this->Image);
+  this->DistanceFunctors.GetFunctor<CachedAverageValueDifference<ImageType> >("Average Value Difference")->
+    SetImage(this->Image);
+  this->DistanceFunctors.GetFunctor<CachedVarianceDifference<ImageType> >("Variance Difference")->
+    SetImage(this->Image);
+
+  // The HSV image (with each channel scaled to 0 to 255, so it fits in the same uchar image type and our distance
+  // functor vector can hold the object) is only computed once per image. The integral histograms are only built
+  // by the first search with the histogram distance (the score label counts the pixels of its two patches).
+  this->HSVImage = this->DerivedImages.GetHSVImage();
+  this->HSVHistogramCache.SetImage(this->HSVImage);
+  this->DistanceFunctors.GetFunctor<CachedHistogramDistance<ImageType> >("HSV Histogram Distance")->
+    SetImage(this->HSVImage);
+
+  // The Lab image is converted once per image, so the functor only reads precomputed values.
+  LabSSD<ImageType>* labSSDDistanceFunctor = this->DistanceFunctors.GetFunctor<LabSSD<ImageType> >("Lab SSD");
+  labSSDDistanceFunctor->SetImage(this->Image);
+  labSSDDistanceFunctor->SetLabImage(this->DerivedImages.GetFloatLabImage());
+
+  // Giving a window an image rebuilds its mask and discards its cached search structures, so only do it for a
+  // new image.
+  if(this->Image.GetPointer() == this->TopPatchesImage && this->Image->GetMTime() == this->TopPatchesImageMTime)
+  {
+    return;
+  }
+
+  for(unsigned int i = 0; i < this->DistanceFunctors.GetNumberOfEntries(); ++i)
+  {
+    if(this->DistanceFunctors.GetEntry(i).TopPatchesWindow)
+    {
+      this->DistanceFunctors.GetEntry(i).TopPatchesWindow->SetImage(this->Image);
+    }
+  }
+
+  this->TopPatchesImage = this->Image.GetPointer();
+  this->TopPatchesImageMTime = this->Image->GetMTime();
+}
+
 bool InteractivePatchComparisonWidget::eventFilter(QObject *object, QEvent *event)
 {
   // When the focus leaves one of the text boxes, update the patches
@@ -47,6 +47,10 @@ class vtkImageSliceMapper;
 #include "TopPatchesWidget.h"
 #include "Layer.h"
 #include "PatchInfoWidget.h"
+#include "PatchStatisticsCache.h"
+#include "IntegralHistogramCache.h"
+#include "DerivedImageCache.h"
+#include "DistanceFunctorRegistry.h"
 
 class SwitchBetweenStyle;
 
@@ -170,9 +174,19 @@ private:
   /** The size of the patches to compare. */
   itk::Size<2> PatchSize;
 
-  /** Setup the distance functors. */
+  /** Setup the distance functors. They are created the first time, and reconfigured in place after that. */
   void SetupDistanceFunctors();
 
+  /** Create the distance functors, their score labels, and their top patches windows. */
+  void CreateDistanceFunctors();
+
+  /** Point the distance functors and their top patches windows at the current image (and its derived images). */
+  void ConfigureDistanceFunctors();
+
+  /** Create the score label (and, if 'showTopPatches' is true, the top patches window) of a functor, and hand them
+    * to DistanceFunctors. */
+  void AddDistanceFunctor(const std::string& name, PatchDistance<ImageType>* const functor, const bool showTopPatches);
+
   /** Handle events (not signals) so we don't have to subclass things like QLineEdit. */
   bool eventFilter(QObject *object, QEvent *event);
 
@@ -182,11 +196,14 @@ private:
   /** The filename of the mask. */
   std::string MaskFileName;
 
-  /** The functor to use in the PatchInformation widgets */
-  std::vector<PatchDistance<ImageType>*> DistanceFunctors;
+  /** The distance functors, with the labels that display their scores and their top patches windows. */
+  DistanceFunctorRegistry<ImageType> DistanceFunctors;
 
-  /** A list of all TopPatchesWidgets to potentially use. */
-  std::vector<TopPatchesWidget<ImageType>*> TopPatchesWidgets;
+  /** The image the top patches windows were given. */
+  ImageType* TopPatchesImage;
+
+  /** The modified time of TopPatchesImage when the windows were given it. */
+  unsigned long TopPatchesImageMTime;
 
   /** The widget to display and retreive information about the source patch. */
   PatchInfoWidget<ImageType>* SourcePatchInfoWidget;
@@ -194,11 +211,18 @@ private:
   /** The widget to display and retreive information about the source patch. */
   PatchInfoWidget<ImageType>* TargetPatchInfoWidget;
 
+  /** The statistics of the patches of Image and MaskImage, shared by the PatchInfoWidgets and the average value and
+    * variance difference functors. */
+  PatchStatisticsCache<ImageType> StatisticsCache;
+
+  /** The colour conversions (HSV, Lab, blurred) of Image, computed when they are first needed. */
+  DerivedImageCache<ImageType> DerivedImages;
+
   /** Store the HSV image. */
   ImageType::Pointer HSVImage;
 
-  /** Store the association of a PatchDistance object and the label that will be used to display its score. */
-  std::map<PatchDistance<ImageType>*, QLabel*> ScoreDisplayMap;
+  /** The integral histograms of HSVImage, used by the histogram distance. They are built on the first search. */
+  IntegralHistogramCache<ImageType> HSVHistogramCache;
 
   /** Get data that has been dropped. */
   void dropEvent ( QDropEvent * event );
@@ -0,0 +1,166 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#include "LabConversion.h"
+
+// Qt
+#include <QThread>
+#include <QtConcurrentMap>
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The pixel buffers are read directly, which relies on the pixels having no padding.
+static_assert(sizeof(LabConversion::RGBImageType::PixelType) == 3, "RGB pixels are expected to be 3 packed bytes.");
+static_assert(sizeof(LabConversion::LabImageType::PixelType) == 3 * sizeof(float),
+              "Lab pixels are expected to be 3 packed floats.");
+
+namespace
+{
+  /** The number of intervals of the cube root table, which covers [0, 1]. */
+  const unsigned int CubeRootTableSize = 4096;
+
+  /** Below this, the Lab function is linear instead of a cube root. */
+  const float LabEpsilon = 0.008856f;
+
+  /** The lookup tables. They are built once, the first time they are used. */
+  struct Tables
+  {
+    Tables()
+    {
+      for(unsigned int value = 0; value < 256; ++value)
+      {
+        double normalized = value / 255.0;
+        Linear[value] = normalized <= 0.04045 ? normalized / 12.92 : std::pow((normalized + 0.055) / 1.055, 2.4);
+      }
+
+      for(unsigned int entry = 0; entry <= CubeRootTableSize; ++entry)
+      {
+        CubeRoot[entry] = std::pow(static_cast<double>(entry) / CubeRootTableSize, 1.0 / 3.0);
+      }
+    }
+
+    /** The gamma expanded (linear) value of each 8-bit sRGB value. */
+    float Linear[256];
+
+    /** The cube root of entry / CubeRootTableSize. */
+    float CubeRoot[CubeRootTableSize + 1];
+  };
+
+  const Tables& GetTables()
+  {
+    static const Tables tables;
+    return tables;
+  }
+
+  /** The Lab function f(t) of a normalized X, Y, or Z value. */
+  inline float LabFunction(const Tables& tables, const float t)
+  {
+    if(t <= LabEpsilon)
+    {
+      return 7.787f * t + 16.0f / 116.0f;
+    }
+
+    // Round off can put white very slightly above 1.
+    float position = std::min(t, 1.0f) * CubeRootTableSize;
+    unsigned int entry = std::min(static_cast<unsigned int>(position), CubeRootTableSize - 1);
+    float fraction = position - entry;
+    return tables.CubeRoot[entry] + fraction * (tables.CubeRoot[entry + 1] - tables.CubeRoot[entry]);
+  }
+
+  inline void ConvertPixel(const Tables& tables, const unsigned char rgb[3], float lab[3])
+  {
+    const float r = tables.Linear[rgb[0]];
+    const float g = tables.Linear[rgb[1]];
+    const float b = tables.Linear[rgb[2]];
+
+    // Linear RGB to XYZ, divided by the D65 white point
+    const float x = (0.4124564f * r + 0.3575761f * g + 0.1804375f * b) / 0.95047f;
+    const float y = 0.2126729f * r + 0.7151522f * g + 0.0721750f * b;
+    const float z = (0.0193339f * r + 0.1191920f * g + 0.9503041f * b) / 1.08883f;
+
+    const float fx = LabFunction(tables, x);
+    const float fy = LabFunction(tables, y);
+    const float fz = LabFunction(tables, z);
+
+    lab[0] = 116.0f * fy - 16.0f;
+    lab[1] = 500.0f * (fx - fy);
+    lab[2] = 200.0f * (fy - fz);
+  }
+
+  /** A block of rows to convert. */
+  struct RowBlock
+  {
+    const unsigned char* RGB;
+    float* Lab;
+    size_t NumberOfPixels;
+  };
+
+  /** The function object handed to QtConcurrent. It converts one block of rows. */
+  struct RowBlockConverter
+  {
+    typedef void result_type;
+
+    void operator()(const RowBlock& rowBlock) const
+    {
+      const Tables& tables = GetTables();
+      for(size_t pixelId = 0; pixelId < rowBlock.NumberOfPixels; ++pixelId)
+      {
+        ConvertPixel(tables, rowBlock.RGB + 3 * pixelId, rowBlock.Lab + 3 * pixelId);
+      }
+    }
+  };
+}
+
+void LabConversion::RGBToLab(const unsigned char rgb[3], float lab[3])
+{
+  ConvertPixel(GetTables(), rgb, lab);
+}
+
+void LabConversion::ConvertImage(const RGBImageType* const rgbImage, LabImageType* const labImage)
+{
+  const RGBImageType::RegionType region = rgbImage->GetLargestPossibleRegion();
+  labImage->SetRegions(region);
+  labImage->Allocate();
+
+  const unsigned int width = region.GetSize()[0];
+  const unsigned int height = region.GetSize()[1];
+  const unsigned char* rgbBuffer = reinterpret_cast<const unsigned char*>(rgbImage->GetBufferPointer());
+  float* labBuffer = reinterpret_cast<float*>(labImage->GetBufferPointer());
+
+  // Build the tables before the threads start.
+  GetTables();
+
+  const unsigned int blocksPerThread = 8;
+  unsigned int rowsPerBlock = std::max<unsigned int>(height / (blocksPerThread * std::max(QThread::idealThreadCount(), 1)), 1);
+  std::vector<RowBlock> rowBlocks;
+  for(unsigned int row = 0; row < height; row += rowsPerBlock)
+  {
+    const size_t firstPixel = static_cast<size_t>(row) * width;
+    RowBlock rowBlock;
+    rowBlock.RGB = rgbBuffer + 3 * firstPixel;
+    rowBlock.Lab = labBuffer + 3 * firstPixel;
+    rowBlock.NumberOfPixels = static_cast<size_t>(std::min(rowsPerBlock, height - row)) * width;
+    rowBlocks.push_back(rowBlock);
+  }
+
+  QtConcurrent::blockingMap(rowBlocks, RowBlockConverter());
+}
@@ -0,0 +1,48 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef LabConversion_H
+#define LabConversion_H
+
+// ITK
+#include "itkCovariantVector.h"
+#include "itkImage.h"
+
+/** Conversion of 8-bit sRGB images to CIELab (D65 white point) with lookup tables. The gamma expansion of each
+  * channel is read from a 256 entry table and the cube root from an interpolated table, so a pixel costs a few
+  * multiplications instead of the pow() calls of a per-pixel colour space accessor. The results differ from the
+  * exact conversion by less than 0.01 in each channel.
+  */
+namespace LabConversion
+{
+  /** The image type used by the GUI, whose pixels are stored as interleaved 8-bit RGB. */
+  typedef itk::Image<itk::CovariantVector<unsigned char, 3>, 2> RGBImageType;
+
+  /** An image of L (0 to 100), a, and b values. */
+  typedef itk::Image<itk::CovariantVector<float, 3>, 2> LabImageType;
+
+  /** Convert one sRGB value to Lab. */
+  void RGBToLab(const unsigned char rgb[3], float lab[3]);
+
+  /** Convert a whole image to Lab, splitting the rows over all of the cores. 'labImage' is (re)allocated to the size
+    * of 'rgbImage'. */
+  void ConvertImage(const RGBImageType* const rgbImage, LabImageType* const labImage);
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef LabSSD_H
+#define LabSSD_H
+
+// Submodules
+#include "PatchComparison/PatchDistance.h"
+
+// Custom
+#include "BatchPatchDistance.h"
+#include "BoundedPatchDistance.h"
+#include "LabConversion.h"
+
+/** The sum over all pixels of the squared CIELab difference (the squared Delta E 1976) between two patches.
+  * The patches are given as regions of the (RGB) image, but the values are read from a precomputed floating point
+  * Lab image of the same size (see LabConversion and DerivedImageCache::GetFloatLabImage()), so nothing is
+  * converted while comparing patches.
+  */
+template <typename TImage>
+class LabSSD : public PatchDistance<TImage>, public BoundedPatchDistance<TImage>, public BatchPatchDistance<TImage>
+{
+public:
+
+  /** Constructor. */
+  LabSSD();
+
+  /** Set the Lab image to read the values from. */
+  void SetLabImage(const LabConversion::LabImageType* const labImage);
+
+  /** Compute the full SSD. */
+  float Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2);
+
+  /** Compute the SSD, stopping after the first row at which it exceeds 'bound'. */
+  float BoundedDistance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2,
+                        const float bound);
+
+  /** Compare the target to many sources. The values of the target are copied into a contiguous buffer once. */
+  void BatchDistance(const itk::ImageRegion<2>& targetRegion, const itk::Index<2>* const sourceCorners,
+                     const unsigned int numberOfSources, const float bound, float* const distances);
+
+  /** Get the name of the distance. */
+  std::string GetDistanceName();
+
+private:
+
+  /** The Lab image. */
+  const LabConversion::LabImageType* LabImage;
+};
+
+#include "LabSSD.hpp"
+
+#endif
@@ -0,0 +1,79 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef LabSSD_HPP
+#define LabSSD_HPP
+
+#include "LabSSD.h"
+
+// STL
+#include <limits>
+#include <stdexcept>
+
+// Custom
+#include "SSDKernels.h"
+
+template <typename TImage>
+LabSSD<TImage>::LabSSD() : LabImage(NULL)
+{
+}
+
+template <typename TImage>
+void LabSSD<TImage>::SetLabImage(const LabConversion::LabImageType* const labImage)
+{
+  this->LabImage = labImage;
+}
+
+template <typename TImage>
+float LabSSD<TImage>::Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2)
+{
+  return BoundedDistance(region1, region2, std::numeric_limits<float>::max());
+}
+
+template <typename TImage>
+float LabSSD<TImage>::BoundedDistance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2,
+                                      const float bound)
+{
+  if(!this->LabImage)
+  {
+    throw std::runtime_error("LabSSD: Must call SetLabImage() before Distance()!");
+  }
+
+  return SSDKernels::BoundedSSD(this->LabImage, region1, region2, bound);
+}
+
+template <typename TImage>
+void LabSSD<TImage>::BatchDistance(const itk::ImageRegion<2>& targetRegion, const itk::Index<2>* const sourceCorners,
+                                   const unsigned int numberOfSources, const float bound, float* const distances)
+{
+  if(!this->LabImage)
+  {
+    throw std::runtime_error("LabSSD: Must call SetLabImage() before BatchDistance()!");
+  }
+
+  SSDKernels::BatchBoundedSSD(this->LabImage, targetRegion, sourceCorners, numberOfSources, bound, distances);
+}
+
+template <typename TImage>
+std::string LabSSD<TImage>::GetDistanceName()
+{
+  return "Lab SSD";
+}
+
+#endif
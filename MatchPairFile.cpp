@@ -0,0 +1,174 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#include "MatchPairFile.h"
+
+// STL
+#include <cstring>
+#include <stdexcept>
+
+// The records are read in place from the mapped file, so the layout has to be exactly the documented one.
+static_assert(sizeof(MatchPairFile::Header) == 24, "MatchPairFile::Header is expected to be 24 packed bytes.");
+static_assert(sizeof(MatchPairFile::Record) == 20, "MatchPairFile::Record is expected to be 20 packed bytes.");
+
+namespace
+{
+  const char Magic[8] = {'I', 'P', 'C', 'P', 'A', 'I', 'R', 'S'};
+  const uint32_t Version = 1;
+}
+
+MatchPairFile::MatchPairFile() : Records(NULL)
+{
+  memset(&this->FileHeader, 0, sizeof(Header));
+}
+
+MatchPairFile::~MatchPairFile()
+{
+  Close();
+}
+
+bool MatchPairFile::IsMatchPairFile(const std::string& fileName)
+{
+  QFile file(QString::fromStdString(fileName));
+  if(!file.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+
+  char magic[sizeof(Magic)];
+  return file.read(magic, sizeof(Magic)) == sizeof(Magic) && memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+void MatchPairFile::Open(const std::string& fileName)
+{
+  Close();
+
+  this->File.setFileName(QString::fromStdString(fileName));
+  if(!this->File.open(QIODevice::ReadOnly))
+  {
+    throw std::runtime_error("MatchPairFile: Could not open " + fileName + "!");
+  }
+
+  if(this->File.size() < static_cast<qint64>(sizeof(Header)))
+  {
+    Close();
+    throw std::runtime_error("MatchPairFile: " + fileName + " is too short to be a pair file!");
+  }
+
+  const uchar* memory = this->File.map(0, this->File.size());
+  if(!memory)
+  {
+    Close();
+    throw std::runtime_error("MatchPairFile: Could not map " + fileName + "!");
+  }
+
+  memcpy(&this->FileHeader, memory, sizeof(Header));
+  if(memcmp(this->FileHeader.Magic, Magic, sizeof(Magic)) != 0 || this->FileHeader.Version != Version)
+  {
+    Close();
+    throw std::runtime_error("MatchPairFile: " + fileName + " is not a version 1 pair file!");
+  }
+
+  if(static_cast<quint64>(this->File.size() - sizeof(Header)) / sizeof(Record) < this->FileHeader.NumberOfPairs)
+  {
+    Close();
+    throw std::runtime_error("MatchPairFile: " + fileName + " is shorter than its header says!");
+  }
+
+  this->Records = reinterpret_cast<const Record*>(memory + sizeof(Header));
+}
+
+void MatchPairFile::Close()
+{
+  // Closing the file also unmaps it.
+  this->File.close();
+  this->Records = NULL;
+  memset(&this->FileHeader, 0, sizeof(Header));
+}
+
+bool MatchPairFile::IsOpen() const
+{
+  return this->Records != NULL;
+}
+
+size_t MatchPairFile::GetNumberOfPairs() const
+{
+  return this->FileHeader.NumberOfPairs;
+}
+
+unsigned int MatchPairFile::GetPatchRadius() const
+{
+  return this->FileHeader.PatchRadius;
+}
+
+const MatchPairFile::Record& MatchPairFile::GetRecord(const size_t pairId) const
+{
+  return this->Records[pairId];
+}
+
+MatchPairFile::PairType MatchPairFile::GetPair(const size_t pairId) const
+{
+  const Record& record = this->Records[pairId];
+  const itk::IndexValueType radius = this->FileHeader.PatchRadius;
+  const itk::Size<2> patchSize = {{2 * this->FileHeader.PatchRadius + 1, 2 * this->FileHeader.PatchRadius + 1}};
+
+  itk::Index<2> targetCorner = {{static_cast<itk::IndexValueType>(record.TargetX) - radius,
+                                 static_cast<itk::IndexValueType>(record.TargetY) - radius}};
+  itk::Index<2> sourceCorner = {{static_cast<itk::IndexValueType>(record.SourceX) - radius,
+                                 static_cast<itk::IndexValueType>(record.SourceY) - radius}};
+
+  return PairType(itk::ImageRegion<2>(targetCorner, patchSize), itk::ImageRegion<2>(sourceCorner, patchSize));
+}
+
+MatchPairFile::Record MatchPairFile::MakeRecord(const PairType& pair, const float score)
+{
+  const itk::ImageRegion<2>& targetRegion = pair.first;
+  const itk::ImageRegion<2>& sourceRegion = pair.second;
+
+  Record record;
+  record.TargetX = static_cast<uint32_t>(targetRegion.GetIndex()[0] + targetRegion.GetSize()[0] / 2);
+  record.TargetY = static_cast<uint32_t>(targetRegion.GetIndex()[1] + targetRegion.GetSize()[1] / 2);
+  record.SourceX = static_cast<uint32_t>(sourceRegion.GetIndex()[0] + sourceRegion.GetSize()[0] / 2);
+  record.SourceY = static_cast<uint32_t>(sourceRegion.GetIndex()[1] + sourceRegion.GetSize()[1] / 2);
+  record.Score = score;
+  return record;
+}
+
+void MatchPairFile::Write(const std::string& fileName, const unsigned int patchRadius,
+                          const std::vector<Record>& records)
+{
+  QFile file(QString::fromStdString(fileName));
+  if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    throw std::runtime_error("MatchPairFile: Could not open " + fileName + " for writing!");
+  }
+
+  Header header;
+  memcpy(header.Magic, Magic, sizeof(Magic));
+  header.Version = Version;
+  header.PatchRadius = patchRadius;
+  header.NumberOfPairs = records.size();
+
+  const qint64 recordBytes = static_cast<qint64>(records.size() * sizeof(Record));
+  if(file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) != sizeof(Header) ||
+     (recordBytes > 0 && file.write(reinterpret_cast<const char*>(&records[0]), recordBytes) != recordBytes))
+  {
+    throw std::runtime_error("MatchPairFile: Could not write " + fileName + "!");
+  }
+}
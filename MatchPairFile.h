@@ -0,0 +1,133 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef MatchPairFile_H
+#define MatchPairFile_H
+
+// Qt
+#include <QFile>
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <string>
+#include <utility>
+#include <vector>
+
+// C
+#include <stdint.h>
+
+/** A binary file of (target, source) patch pairs that is memory mapped, so that files with millions of pairs open
+  * instantly and the pairs are read straight from the file (by TableModelViewAllMatches) instead of being parsed
+  * into regions. The file is a Header followed by Header::NumberOfPairs fixed size Records, in the byte order of
+  * the machine that wrote it. Every pair uses the patch size of the header. By convention the files are named
+  * *.pairs. The text format of PairReader can be converted with ConvertMatchPairs.
+  */
+class MatchPairFile
+{
+public:
+
+  /** The start of the file. */
+  struct Header
+  {
+    /** "IPCPAIRS" */
+    char Magic[8];
+
+    /** The version of the format (1). */
+    uint32_t Version;
+
+    /** The patches are (2 * PatchRadius + 1) pixels wide. */
+    uint32_t PatchRadius;
+
+    /** The number of Records that follow the header. */
+    uint64_t NumberOfPairs;
+  };
+
+  /** One pair. */
+  struct Record
+  {
+    /** The center of the target patch. */
+    uint32_t TargetX;
+    uint32_t TargetY;
+
+    /** The center of the source patch. */
+    uint32_t SourceX;
+    uint32_t SourceY;
+
+    /** The distance between the patches (NaN if it is not known). */
+    float Score;
+  };
+
+  /** A target region and a source region. */
+  typedef std::pair<itk::ImageRegion<2>, itk::ImageRegion<2> > PairType;
+
+  /** Constructor. */
+  MatchPairFile();
+
+  /** Destructor. Unmaps the file. */
+  ~MatchPairFile();
+
+  /** True if the file starts with the magic of this format. */
+  static bool IsMatchPairFile(const std::string& fileName);
+
+  /** Map a file. Throws if it cannot be mapped or is not a valid pair file. */
+  void Open(const std::string& fileName);
+
+  /** Unmap the file. */
+  void Close();
+
+  /** True if a file is mapped. */
+  bool IsOpen() const;
+
+  /** Get the number of pairs. */
+  size_t GetNumberOfPairs() const;
+
+  /** Get the patch radius. */
+  unsigned int GetPatchRadius() const;
+
+  /** Get a record, straight from the mapped file. */
+  const Record& GetRecord(const size_t pairId) const;
+
+  /** Get the target and source regions of a pair. */
+  PairType GetPair(const size_t pairId) const;
+
+  /** Make the record of an odd sized target and source region (the pair that GetPair() returns for it). */
+  static Record MakeRecord(const PairType& pair, const float score);
+
+  /** Write the pairs to a file, replacing it. Throws if the file cannot be written. */
+  static void Write(const std::string& fileName, const unsigned int patchRadius, const std::vector<Record>& records);
+
+private:
+
+  /** The file is mapped, so it cannot be copied. */
+  MatchPairFile(const MatchPairFile&);
+  void operator=(const MatchPairFile&);
+
+  /** The mapped file. */
+  QFile File;
+
+  /** The header of the mapped file. */
+  Header FileHeader;
+
+  /** The records, in the mapped memory. */
+  const Record* Records;
+};
+
+#endif
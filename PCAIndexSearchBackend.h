@@ -0,0 +1,71 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PCAIndexSearchBackend_H
+#define PCAIndexSearchBackend_H
+
+// Custom
+#include "ProjectedPatchIndex.h"
+#include "SearchBackend.h"
+
+/** The PCA_INDEX backend of ParallelSelfPatchCompare. Candidates are found in a ProjectedPatchIndex that is kept
+  * between queries (it is only rebuilt when the image or patch size changes), and re-ranked with the functor. Any
+  * functor is supported.
+  */
+template <typename TImage>
+class PCAIndexSearchBackend : public SearchBackend<TImage>
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SearchBackend<TImage>::PatchDataType PatchDataType;
+
+  /** Everything about one query. */
+  typedef typename SearchBackend<TImage>::Query Query;
+
+  /** Constructor. */
+  PCAIndexSearchBackend();
+
+  /** Always true. */
+  bool SupportsPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor) const;
+
+  /** True if a bounded number of patches is kept. */
+  bool CanComputePatchScores(const Query& query, std::string& reason);
+
+  /** Update the index if needed, and find the nearest patches in it. */
+  std::vector<PatchDataType> ComputePatchScores(const Query& query);
+
+  /** Set a flag that is checked after the index is updated. The update itself cannot be canceled. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+private:
+
+  /** True if the cancel flag is set. */
+  bool IsCancelRequested() const;
+
+  /** The index of the projected patches. */
+  ProjectedPatchIndex<TImage> Index;
+
+  /** If this is set and non-zero, the search stops. */
+  const QAtomicInt* CancelFlag;
+};
+
+#include "PCAIndexSearchBackend.hpp"
+
+#endif
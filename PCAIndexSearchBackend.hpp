@@ -0,0 +1,78 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PCAIndexSearchBackend_HPP
+#define PCAIndexSearchBackend_HPP
+
+#include "PCAIndexSearchBackend.h"
+
+template <typename TImage>
+PCAIndexSearchBackend<TImage>::PCAIndexSearchBackend() : CancelFlag(NULL)
+{
+}
+
+template <typename TImage>
+bool PCAIndexSearchBackend<TImage>::SupportsPatchDistanceFunctor(PatchDistance<TImage>* const) const
+{
+  return true;
+}
+
+template <typename TImage>
+bool PCAIndexSearchBackend<TImage>::CanComputePatchScores(const Query& query, std::string& reason)
+{
+  if(query.NumberOfPatchesToKeep == 0)
+  {
+    reason = "The PCA_INDEX backend requires a bounded number of patches to keep.";
+    return false;
+  }
+  return true;
+}
+
+template <typename TImage>
+void PCAIndexSearchBackend<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->CancelFlag = cancelFlag;
+}
+
+template <typename TImage>
+bool PCAIndexSearchBackend<TImage>::IsCancelRequested() const
+{
+  return this->CancelFlag && static_cast<int>(*this->CancelFlag) != 0;
+}
+
+template <typename TImage>
+std::vector<typename PCAIndexSearchBackend<TImage>::PatchDataType>
+PCAIndexSearchBackend<TImage>::ComputePatchScores(const Query& query)
+{
+  this->Index.SetImage(query.Image);
+  this->Index.SetMask(query.MaskImage);
+  this->Index.SetPatchSize(query.TargetRegion.GetSize());
+  this->Index.SetPatchDistanceFunctor(query.PatchDistanceFunctor);
+  // This only does work the first time, or after the image, patch size, or mask changed.
+  this->Index.Update();
+
+  if(IsCancelRequested())
+  {
+    return std::vector<PatchDataType>();
+  }
+
+  return this->Index.FindNearestPatches(query.TargetRegion, query.NumberOfPatchesToKeep);
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#include "PairWriter.h"
+
+// STL
+#include <fstream>
+#include <stdexcept>
+
+void PairWriter::Write(const std::string& fileName, const std::vector<PairType>& pairs)
+{
+  std::ofstream fileStream(fileName.c_str());
+  if(!fileStream)
+  {
+    throw std::runtime_error("PairWriter: Could not open " + fileName + " for writing!");
+  }
+
+  for(size_t pairId = 0; pairId < pairs.size(); ++pairId)
+  {
+    const itk::ImageRegion<2>& targetRegion = pairs[pairId].first;
+    const itk::ImageRegion<2>& sourceRegion = pairs[pairId].second;
+
+    // The centers of odd sized patches (the only ones the GUI makes)
+    fileStream << targetRegion.GetIndex()[0] + static_cast<itk::IndexValueType>(targetRegion.GetSize()[0] / 2) << " "
+               << targetRegion.GetIndex()[1] + static_cast<itk::IndexValueType>(targetRegion.GetSize()[1] / 2) << " "
+               << sourceRegion.GetIndex()[0] + static_cast<itk::IndexValueType>(sourceRegion.GetSize()[0] / 2) << " "
+               << sourceRegion.GetIndex()[1] + static_cast<itk::IndexValueType>(sourceRegion.GetSize()[1] / 2)
+               << "\n";
+  }
+
+  if(!fileStream)
+  {
+    throw std::runtime_error("PairWriter: Could not write " + fileName + "!");
+  }
+}
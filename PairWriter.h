@@ -0,0 +1,47 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PairWriter_H
+#define PairWriter_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Writes (target, source) patch pairs to a text file. Each line holds one pair, as the centers of the target and
+  * source patches:
+  *   targetX targetY sourceX sourceY
+  * The patch size and the scores are not stored. This format has not been checked against what PairReader (in the
+  * PatchComparison submodule) parses, so ViewAllMatches and ConvertMatchPairs may not read it; BatchMatcher writes
+  * the binary MatchPairFile format unless a ".txt" file is asked for.
+  */
+namespace PairWriter
+{
+  /** A target region and a source region. */
+  typedef std::pair<itk::ImageRegion<2>, itk::ImageRegion<2> > PairType;
+
+  /** Write the pairs to a file, replacing it. Throws if the file cannot be written. */
+  void Write(const std::string& fileName, const std::vector<PairType>& pairs);
+}
+
+#endif
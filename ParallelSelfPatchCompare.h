@@ -0,0 +1,360 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ParallelSelfPatchCompare_H
+#define ParallelSelfPatchCompare_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// Qt
+#include <QAtomicInt>
+
+// STL
+#include <string>
+#include <vector>
+
+// Submodules
+#include "PatchComparison/Mask/Mask.h"
+#include "PatchComparison/PatchDistance.h"
+#include "PatchComparison/SelfPatchCompare.h"
+
+// Custom
+#include "BatchPatchDistance.h"
+#include "BoundedPatchDistance.h"
+#include "FFTSSDSearchBackend.h"
+#include "IncrementalSSDScoreMap.h"
+#include "PatchMatchSearchBackend.h"
+#include "PCAIndexSearchBackend.h"
+#include "PyramidSearchBackend.h"
+#include "SearchBackend.h"
+#include "TopPatchCollector.h"
+#include "ValidSourceCornerList.h"
+
+/** Compare a target patch to every fully valid source patch in the same image (like SelfPatchCompare),
+  * but split the source patch corners into tiles of rows and score the tiles on all of the cores.
+  * Idle threads pick up the next unscored tile, so a tile of expensive (e.g. fully valid) rows does not
+  * hold up the others. Each tile only keeps its best NumberOfPatchesToKeep patches (see TopPatchCollector),
+  * and the tiles are merged in order, so the output is identical to a stable sort of the serial scan
+  * without the full list of scores ever being stored.
+  * The PatchDistance functor is called from several threads at once, so its Distance() must not modify
+  * the functor.
+  * If the functor is a BoundedPatchDistance, it is given the score a candidate has to beat (the lower of the
+  * tile's own K-th best score and the best K-th score any tile has reached so far), so it can stop early.
+  * Since any full tile proves that K patches are at least that good, this does not change the results.
+  * The other backends are SearchBackend classes: FFTSSDSearchBackend (exact, SSD only), PatchMatchSearchBackend and
+  * PCAIndexSearchBackend (approximate), and PyramidSearchBackend (approximate, SSD only). If the selected one cannot
+  * answer a query, the EXHAUSTIVE scan is used instead and GetFallbackReason() says why.
+  * If incremental re-query is enabled, the EXHAUSTIVE backend with an SSD functor on an integer image keeps the
+  * score of every patch in an IncrementalSSDScoreMap once the target starts moving by a few pixels at a time, so
+  * that each further small move only updates the scores. Other queries still use the tiled scan. The updates are
+  * exact for integer images, so the results are the same either way; floating point images always use the scan.
+  * If a snapshot interval is set, the EXHAUSTIVE scan also publishes the best patches of the rows scored so far
+  * (see GetPartialPatchData()), so a GUI can show good candidates long before the scan is done.
+  */
+template <typename TImage>
+class ParallelSelfPatchCompare
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SelfPatchCompare<TImage>::PatchDataType PatchDataType;
+
+  /** The ways the scores can be computed. */
+  enum BackendEnum {EXHAUSTIVE, FFT_SSD, PATCH_MATCH, PCA_INDEX, PYRAMID};
+
+  /** Constructor. */
+  ParallelSelfPatchCompare();
+
+  /** Set the image to search. */
+  void SetImage(TImage* const image);
+
+  /** Set the mask. Only source patches that are entirely valid are scored. */
+  void SetMask(Mask* const mask);
+
+  /** Use a mask that is entirely valid (all source patches in the image are scored). */
+  void CreateFullyValidMask();
+
+  /** Report that the pixels of the mask in 'region' were modified in place, so that only the source patches that
+    * overlap it are checked again by the next search. */
+  void InvalidateMaskRegion(const itk::ImageRegion<2>& region);
+
+  /** Set the target/query region. */
+  void SetTargetRegion(const itk::ImageRegion<2>& targetRegion);
+
+  /** Set the functor used to compare the target patch to each source patch. */
+  void SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor);
+
+  /** Set the number of best patches to keep. If this is 0, every valid source patch is kept. */
+  void SetNumberOfPatchesToKeep(const unsigned int numberOfPatchesToKeep);
+
+  /** Set how the scores are computed. FFT_SSD and PYRAMID are only used if the PatchDistance functor is an SSD
+    * functor on the same image, and FFT_SSD, PATCH_MATCH, PCA_INDEX, and PYRAMID are only used if
+    * NumberOfPatchesToKeep is not 0 (PYRAMID also needs patches that are large enough to downsample);
+    * otherwise the EXHAUSTIVE backend is used. */
+  void SetBackend(const BackendEnum backend);
+
+  /** Get how the scores are computed. */
+  BackendEnum GetBackend() const;
+
+  /** True if the backend can be used with the current PatchDistance functor. FFT_SSD and PYRAMID rank the patches
+    * by the SSD of the image, so they need an SSD functor. */
+  bool IsBackendSupported(const BackendEnum backend) const;
+
+  /** Get the backend that computed the patches of the last ComputePatchScores(). This is EXHAUSTIVE if the selected
+    * backend could not answer the query. */
+  BackendEnum GetUsedBackend() const;
+
+  /** Get why the selected backend could not answer the last query (empty if it did). */
+  std::string GetFallbackReason() const;
+
+  /** Set the number of rows of source patch corners in each tile. If this is 0 (the default),
+    * it is chosen so that there are several tiles per thread. */
+  void SetRowsPerTile(const unsigned int rowsPerTile);
+
+  /** Set the number of iterations of the PATCH_MATCH backend. */
+  void SetPatchMatchIterations(const unsigned int numberOfIterations);
+
+  /** Set the random seed of the PATCH_MATCH backend. */
+  void SetRandomSeed(const unsigned int randomSeed);
+
+  /** Set the number of levels above full resolution used by the PYRAMID backend. */
+  void SetPyramidLevels(const unsigned int numberOfLevels);
+
+  /** Keep the scores of all of the patches between queries, so that the EXHAUSTIVE backend with an SSD functor
+    * on an integer image can update them when the target moves a little instead of scoring every patch again.
+    * The scores are first computed by the first query that is a small move from the previous one, so queries that
+    * jump around cost the same as without this. Once computed, two doubles per patch and a float copy of the image
+    * are kept. */
+  void SetIncrementalRequery(const bool incrementalRequery);
+
+  /** True if a query for this target region would use the kept scores, i.e. incremental re-query can be used and
+    * the region is a small (non-zero) shift of the previous target region. The first such query after a jump
+    * computes the scores of every patch and the next ones only update them. */
+  bool CanUpdateIncrementally(const itk::ImageRegion<2>& targetRegion) const;
+
+  /** Set a flag that is checked between rows of the scan. When it becomes non-zero, ComputePatchScores() stops
+    * soon after and produces no patches. NULL (the default) means the scan cannot be canceled. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+  /** Get the fraction (0 to 1) of the current (or last) scan that is done. This can be called from another thread
+    * while ComputePatchScores() runs. Only the EXHAUSTIVE scan reports intermediate progress. */
+  float GetProgress() const;
+
+  /** Set how often (in milliseconds) each tile of the EXHAUSTIVE scan publishes its best patches so far.
+    * 0 (the default) means no partial results are published. */
+  void SetSnapshotInterval(const unsigned int milliseconds);
+
+  /** Get a number that changes every time partial results are published. This can be called from another thread
+    * while ComputePatchScores() runs. */
+  int GetSnapshotId() const;
+
+  /** Get the best patches among the rows of the current scan that have been published so far, best first.
+    * This can be called from another thread while ComputePatchScores() runs. */
+  std::vector<PatchDataType> GetPartialPatchData() const;
+
+  /** Score every valid source patch against the target patch. */
+  void ComputePatchScores();
+
+  /** Get the patches kept by the last call to ComputePatchScores(), best first. */
+  std::vector<PatchDataType> GetPatchData() const;
+
+private:
+
+  /** A block of consecutive rows of source patch corners, and the scores of the patches in it. */
+  struct Tile
+  {
+    /** The position of the tile in the list of tiles. */
+    unsigned int Id;
+
+    /** The first row (y coordinate of the source patch corner) of the tile. */
+    itk::IndexValueType FirstRow;
+
+    /** One past the last row of the tile. */
+    itk::IndexValueType EndRow;
+
+    /** The best source patches in the tile. */
+    TopPatchCollector<PatchDataType> TopPatches;
+  };
+
+  /** The function object handed to QtConcurrent. It scores one tile. */
+  struct TileScorer
+  {
+    typedef void result_type;
+
+    TileScorer(const ParallelSelfPatchCompare* const owner) : Owner(owner){}
+
+    void operator()(Tile& tile) const
+    {
+      this->Owner->ScoreTile(tile);
+    }
+
+    const ParallelSelfPatchCompare* Owner;
+  };
+
+  /** Score all of the source patches in a tile. */
+  void ScoreTile(Tile& tile) const;
+
+  /** Score the source patch with the given corner with the (bounded, if it is not NULL) functor and add it to the
+    * best patches of the tile. */
+  void ScoreCorner(Tile& tile, const itk::Index<2>& sourceCorner,
+                   BoundedPatchDistance<TImage>* const boundedDistanceFunctor) const;
+
+  /** Score the source patches of one row of a tile with a single call to a batch functor. 'rowDistances' is
+    * scratch space, reused across the rows of the tile. */
+  void ScoreRowBatch(Tile& tile, const itk::Index<2>* const rowCorners, const unsigned int numberOfRowCorners,
+                     BatchPatchDistance<TImage>* const batchDistanceFunctor, const bool bounded,
+                     std::vector<float>& rowDistances) const;
+
+  /** Split the rows of valid source patch corners into tiles. */
+  std::vector<Tile> CreateTiles() const;
+
+  /** Replace the published best patches of a tile with its current ones. */
+  void PublishSnapshot(const Tile& tile) const;
+
+  /** Wait until the published snapshots can be accessed by this thread. */
+  void LockSnapshots() const;
+
+  /** Let other threads access the published snapshots. */
+  void UnlockSnapshots() const;
+
+  /** Compute the scores with the selected backend (or the EXHAUSTIVE one if it cannot be used). */
+  void RunBackend();
+
+  /** Get the SearchBackend of a backend (NULL for EXHAUSTIVE). */
+  SearchBackend<TImage>* GetSearchBackend(const BackendEnum backend);
+  const SearchBackend<TImage>* GetSearchBackend(const BackendEnum backend) const;
+
+  /** Describe the current query to a SearchBackend. */
+  typename SearchBackend<TImage>::Query CreateQuery() const;
+
+  /** True if the cancel flag is set. */
+  bool IsCancelRequested() const;
+
+  /** Compute the scores by comparing the target patch to every source patch. */
+  void ComputePatchScoresExhaustive();
+
+  /** Update the scores with IncrementalSSDScoreMap. */
+  void ComputePatchScoresIncremental();
+
+  /** Get the lowest admission threshold any tile has reached during the current scan. */
+  float GetSharedAdmissionThreshold() const;
+
+  /** Lower the shared admission threshold to 'threshold' if it is currently higher. */
+  void LowerSharedAdmissionThreshold(const float threshold) const;
+
+  /** Get the position of a source patch corner in the raster scan, used to break ties. */
+  size_t GetRasterOrder(const itk::Index<2>& corner) const;
+
+  /** Get the columns [firstColumn, endColumn) of the source patch corners in a row when the mask is fully valid. */
+  void GetCornerColumnRange(itk::IndexValueType& firstColumn, itk::IndexValueType& endColumn) const;
+
+  /** Get the corners of the valid source patches in an image row, in increasing column order, for the batch
+    * functors. For a fully valid mask they are kept in 'scratch', which is filled with the columns of a row on the
+    * first call so that later rows only change the row of each corner. Otherwise they are read from
+    * ValidSourceCorners. */
+  const itk::Index<2>* GetRowCorners(const itk::IndexValueType row, std::vector<itk::Index<2> >& scratch,
+                                     unsigned int& numberOfCorners) const;
+
+  /** The image to search. */
+  TImage* Image;
+
+  /** The mask indicating which pixels of the image can be used in source patches. */
+  Mask::Pointer MaskImage;
+
+  /** True if every pixel of MaskImage is valid, so the per-patch mask test can be skipped. */
+  bool MaskFullyValid;
+
+  /** The corners of the source patches that are entirely valid, when MaskFullyValid is false. */
+  ValidSourceCornerList ValidSourceCorners;
+
+  /** The query/target region. */
+  itk::ImageRegion<2> TargetRegion;
+
+  /** The functor used to compare patches. */
+  PatchDistance<TImage>* PatchDistanceFunctor;
+
+  /** The number of best patches to keep (0 means all). */
+  unsigned int NumberOfPatchesToKeep;
+
+  /** How the scores are computed. */
+  BackendEnum Backend;
+
+  /** The backend that computed the last patches. */
+  BackendEnum UsedBackend;
+
+  /** Why the selected backend could not answer the last query (empty if it did). */
+  std::string FallbackReason;
+
+  /** The bits of the (non-negative float) lowest admission threshold of any tile. Non-negative floats have
+    * the same order as their bits interpreted as integers, so this can be lowered with compare-and-swap. */
+  mutable QAtomicInt SharedAdmissionThreshold;
+
+  /** True if the scores are kept between queries. */
+  bool IncrementalRequery;
+
+  /** The scores kept between queries. */
+  IncrementalSSDScoreMap<TImage> IncrementalScoreMap;
+
+  /** The target region of the last completed query (empty before the first one). */
+  itk::ImageRegion<2> PreviousTargetRegion;
+
+  /** The FFT_SSD backend, which keeps the image spectrum. */
+  FFTSSDSearchBackend<TImage> FFTBackend;
+
+  /** The PATCH_MATCH backend, which keeps the nearest neighbor field. */
+  PatchMatchSearchBackend<TImage> PatchMatchBackend;
+
+  /** The PCA_INDEX backend, which keeps the index. */
+  PCAIndexSearchBackend<TImage> PCAIndexBackend;
+
+  /** The PYRAMID backend, which keeps the image pyramid. */
+  PyramidSearchBackend<TImage> PyramidBackend;
+
+  /** The requested number of rows per tile (0 means automatic). */
+  unsigned int RowsPerTile;
+
+  /** The flag that requests the scan to stop (NULL if it cannot be canceled). */
+  const QAtomicInt* CancelFlag;
+
+  /** The number of rows of source patch corners of the current scan. */
+  QAtomicInt NumberOfRows;
+
+  /** The number of rows of source patch corners that have been scored. */
+  mutable QAtomicInt NumberOfRowsDone;
+
+  /** How often (in milliseconds) the tiles publish their best patches (0 means never). */
+  unsigned int SnapshotInterval;
+
+  /** The best patches each tile of the current scan has published. */
+  mutable std::vector<TopPatchCollector<PatchDataType> > TileSnapshots;
+
+  /** A spin lock (non-zero while held) that guards TileSnapshots. The snapshots are only held briefly to copy
+    * a few patches, and unlike a QMutex this keeps the class copyable. */
+  mutable QAtomicInt SnapshotLock;
+
+  /** Incremented every time a snapshot is published. */
+  mutable QAtomicInt SnapshotId;
+
+  /** The best source patches, sorted by score. */
+  std::vector<PatchDataType> PatchData;
+};
+
+#include "ParallelSelfPatchCompare.hpp"
+
+#endif
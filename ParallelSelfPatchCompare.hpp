@@ -0,0 +1,681 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ParallelSelfPatchCompare_HPP
+#define ParallelSelfPatchCompare_HPP
+
+#include "ParallelSelfPatchCompare.h"
+
+// Qt
+#include <QThread>
+#include <QTime>
+#include <QtConcurrentMap>
+
+// STL
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// Submodules
+#include "PatchComparison/Mask/ITKHelpers/ITKHelpers.h"
+#include "PatchComparison/SSD.h"
+
+template <typename TImage>
+ParallelSelfPatchCompare<TImage>::ParallelSelfPatchCompare() : Image(NULL), MaskImage(NULL),
+MaskFullyValid(false), PatchDistanceFunctor(NULL), NumberOfPatchesToKeep(0), Backend(EXHAUSTIVE),
+UsedBackend(EXHAUSTIVE), IncrementalRequery(false), RowsPerTile(0), CancelFlag(NULL), SnapshotInterval(0)
+{
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetImage(TImage* const image)
+{
+  this->Image = image;
+  this->IncrementalScoreMap.SetImage(image);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetMask(Mask* const mask)
+{
+  this->MaskImage = mask;
+
+  // Checking the mask once here lets every tile skip the per-patch test in the common (no hole) case.
+  this->MaskFullyValid = (mask->CountValidPixels(mask->GetLargestPossibleRegion()) ==
+                          mask->GetLargestPossibleRegion().GetNumberOfPixels());
+
+  this->ValidSourceCorners.SetMask(mask);
+  this->ValidSourceCorners.Invalidate();
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::CreateFullyValidMask()
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("ParallelSelfPatchCompare: Must call SetImage() before CreateFullyValidMask()!");
+  }
+
+  this->MaskImage = Mask::New();
+  this->MaskImage->SetRegions(this->Image->GetLargestPossibleRegion());
+  this->MaskImage->Allocate();
+  ITKHelpers::SetImageToConstant(this->MaskImage.GetPointer(), this->MaskImage->GetValidValue());
+  this->MaskFullyValid = true;
+
+  this->ValidSourceCorners.SetMask(this->MaskImage.GetPointer());
+  this->ValidSourceCorners.Invalidate();
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::InvalidateMaskRegion(const itk::ImageRegion<2>& region)
+{
+  if(!this->MaskImage)
+  {
+    throw std::runtime_error("ParallelSelfPatchCompare: Must set the mask before calling InvalidateMaskRegion()!");
+  }
+
+  this->MaskFullyValid = (this->MaskImage->CountValidPixels(this->MaskImage->GetLargestPossibleRegion()) ==
+                          this->MaskImage->GetLargestPossibleRegion().GetNumberOfPixels());
+
+  this->ValidSourceCorners.InvalidateRegion(region);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetTargetRegion(const itk::ImageRegion<2>& targetRegion)
+{
+  this->TargetRegion = targetRegion;
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor)
+{
+  this->PatchDistanceFunctor = patchDistanceFunctor;
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetNumberOfPatchesToKeep(const unsigned int numberOfPatchesToKeep)
+{
+  this->NumberOfPatchesToKeep = numberOfPatchesToKeep;
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetBackend(const BackendEnum backend)
+{
+  this->Backend = backend;
+}
+
+template <typename TImage>
+typename ParallelSelfPatchCompare<TImage>::BackendEnum ParallelSelfPatchCompare<TImage>::GetBackend() const
+{
+  return this->Backend;
+}
+
+template <typename TImage>
+bool ParallelSelfPatchCompare<TImage>::IsBackendSupported(const BackendEnum backend) const
+{
+  const SearchBackend<TImage>* searchBackend = GetSearchBackend(backend);
+  return !searchBackend || searchBackend->SupportsPatchDistanceFunctor(this->PatchDistanceFunctor);
+}
+
+template <typename TImage>
+typename ParallelSelfPatchCompare<TImage>::BackendEnum ParallelSelfPatchCompare<TImage>::GetUsedBackend() const
+{
+  return this->UsedBackend;
+}
+
+template <typename TImage>
+std::string ParallelSelfPatchCompare<TImage>::GetFallbackReason() const
+{
+  return this->FallbackReason;
+}
+
+template <typename TImage>
+SearchBackend<TImage>* ParallelSelfPatchCompare<TImage>::GetSearchBackend(const BackendEnum backend)
+{
+  switch(backend)
+  {
+    case FFT_SSD:
+      return &this->FFTBackend;
+    case PATCH_MATCH:
+      return &this->PatchMatchBackend;
+    case PCA_INDEX:
+      return &this->PCAIndexBackend;
+    case PYRAMID:
+      return &this->PyramidBackend;
+    default:
+      return NULL;
+  }
+}
+
+template <typename TImage>
+const SearchBackend<TImage>* ParallelSelfPatchCompare<TImage>::GetSearchBackend(const BackendEnum backend) const
+{
+  return const_cast<ParallelSelfPatchCompare*>(this)->GetSearchBackend(backend);
+}
+
+template <typename TImage>
+typename SearchBackend<TImage>::Query ParallelSelfPatchCompare<TImage>::CreateQuery() const
+{
+  typename SearchBackend<TImage>::Query query;
+  query.Image = this->Image;
+  // Without a mask the backends skip the per-patch mask test.
+  query.MaskImage = this->MaskFullyValid ? NULL : this->MaskImage.GetPointer();
+  query.ValidSourceCorners = this->MaskFullyValid ? NULL : &this->ValidSourceCorners;
+  query.TargetRegion = this->TargetRegion;
+  query.PatchDistanceFunctor = this->PatchDistanceFunctor;
+  query.NumberOfPatchesToKeep = this->NumberOfPatchesToKeep;
+  return query;
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->CancelFlag = cancelFlag;
+  this->IncrementalScoreMap.SetCancelFlag(cancelFlag);
+  this->FFTBackend.SetCancelFlag(cancelFlag);
+  this->PatchMatchBackend.SetCancelFlag(cancelFlag);
+  this->PCAIndexBackend.SetCancelFlag(cancelFlag);
+  this->PyramidBackend.SetCancelFlag(cancelFlag);
+}
+
+template <typename TImage>
+bool ParallelSelfPatchCompare<TImage>::IsCancelRequested() const
+{
+  return this->CancelFlag && static_cast<int>(*this->CancelFlag) != 0;
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetSnapshotInterval(const unsigned int milliseconds)
+{
+  this->SnapshotInterval = milliseconds;
+}
+
+template <typename TImage>
+int ParallelSelfPatchCompare<TImage>::GetSnapshotId() const
+{
+  return this->SnapshotId;
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::LockSnapshots() const
+{
+  while(!this->SnapshotLock.testAndSetOrdered(0, 1))
+  {
+    QThread::yieldCurrentThread();
+  }
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::UnlockSnapshots() const
+{
+  this->SnapshotLock.fetchAndStoreOrdered(0);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::PublishSnapshot(const Tile& tile) const
+{
+  LockSnapshots();
+  this->TileSnapshots[tile.Id] = tile.TopPatches;
+  UnlockSnapshots();
+
+  this->SnapshotId.fetchAndAddOrdered(1);
+}
+
+template <typename TImage>
+std::vector<typename ParallelSelfPatchCompare<TImage>::PatchDataType>
+ParallelSelfPatchCompare<TImage>::GetPartialPatchData() const
+{
+  TopPatchCollector<PatchDataType> topPatches(this->NumberOfPatchesToKeep);
+
+  LockSnapshots();
+  for(size_t tileId = 0; tileId < this->TileSnapshots.size(); ++tileId)
+  {
+    topPatches.Merge(this->TileSnapshots[tileId]);
+  }
+  UnlockSnapshots();
+
+  return topPatches.GetSortedPatchData();
+}
+
+template <typename TImage>
+float ParallelSelfPatchCompare<TImage>::GetProgress() const
+{
+  int numberOfRows = this->NumberOfRows;
+  if(numberOfRows == 0)
+  {
+    return 0.0f;
+  }
+  return static_cast<float>(static_cast<int>(this->NumberOfRowsDone)) / numberOfRows;
+}
+
+template <typename TImage>
+float ParallelSelfPatchCompare<TImage>::GetSharedAdmissionThreshold() const
+{
+  int thresholdBits = this->SharedAdmissionThreshold;
+  float threshold;
+  memcpy(&threshold, &thresholdBits, sizeof(float));
+  return threshold;
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::LowerSharedAdmissionThreshold(const float threshold) const
+{
+  int thresholdBits;
+  memcpy(&thresholdBits, &threshold, sizeof(float));
+
+  int currentBits = this->SharedAdmissionThreshold;
+  while(thresholdBits < currentBits)
+  {
+    if(this->SharedAdmissionThreshold.testAndSetOrdered(currentBits, thresholdBits))
+    {
+      return;
+    }
+    currentBits = this->SharedAdmissionThreshold;
+  }
+}
+
+template <typename TImage>
+size_t ParallelSelfPatchCompare<TImage>::GetRasterOrder(const itk::Index<2>& corner) const
+{
+  return SearchBackend<TImage>::GetRasterOrder(this->Image, corner);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::GetCornerColumnRange(itk::IndexValueType& firstColumn,
+                                                            itk::IndexValueType& endColumn) const
+{
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+  firstColumn = fullRegion.GetIndex()[0];
+  endColumn = fullRegion.GetIndex()[0] + static_cast<itk::IndexValueType>(fullRegion.GetSize()[0]) -
+              static_cast<itk::IndexValueType>(this->TargetRegion.GetSize()[0]) + 1;
+}
+
+template <typename TImage>
+const itk::Index<2>* ParallelSelfPatchCompare<TImage>::GetRowCorners(const itk::IndexValueType row,
+                                                                     std::vector<itk::Index<2> >& scratch,
+                                                                     unsigned int& numberOfCorners) const
+{
+  if(!this->MaskFullyValid)
+  {
+    return this->ValidSourceCorners.GetRowCorners(row, numberOfCorners);
+  }
+
+  if(scratch.empty())
+  {
+    itk::IndexValueType firstColumn;
+    itk::IndexValueType endColumn;
+    GetCornerColumnRange(firstColumn, endColumn);
+    for(itk::IndexValueType column = firstColumn; column < endColumn; ++column)
+    {
+      itk::Index<2> sourceCorner = {{column, row}};
+      scratch.push_back(sourceCorner);
+    }
+  }
+  else if(scratch[0][1] != row)
+  {
+    for(size_t cornerId = 0; cornerId < scratch.size(); ++cornerId)
+    {
+      scratch[cornerId][1] = row;
+    }
+  }
+
+  numberOfCorners = scratch.size();
+  return scratch.empty() ? NULL : &scratch[0];
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetPatchMatchIterations(const unsigned int numberOfIterations)
+{
+  this->PatchMatchBackend.SetNumberOfIterations(numberOfIterations);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetRandomSeed(const unsigned int randomSeed)
+{
+  this->PatchMatchBackend.SetRandomSeed(randomSeed);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetIncrementalRequery(const bool incrementalRequery)
+{
+  this->IncrementalRequery = incrementalRequery;
+  if(!incrementalRequery)
+  {
+    this->IncrementalScoreMap.ClearCache();
+  }
+}
+
+template <typename TImage>
+bool ParallelSelfPatchCompare<TImage>::CanUpdateIncrementally(const itk::ImageRegion<2>& targetRegion) const
+{
+  if(!this->IncrementalRequery || this->Backend != EXHAUSTIVE ||
+     !dynamic_cast<SSD<TImage>*>(this->PatchDistanceFunctor) || !IncrementalSSDScoreMap<TImage>::IsExact())
+  {
+    return false;
+  }
+
+  // Without kept scores, the first small move computes them for its own target.
+  return this->IncrementalScoreMap.CanUpdateIncrementally(targetRegion) ||
+         IncrementalSSDScoreMap<TImage>::IsSmallShift(this->PreviousTargetRegion, targetRegion);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetPyramidLevels(const unsigned int numberOfLevels)
+{
+  this->PyramidBackend.SetNumberOfLevels(numberOfLevels);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::SetRowsPerTile(const unsigned int rowsPerTile)
+{
+  this->RowsPerTile = rowsPerTile;
+}
+
+template <typename TImage>
+std::vector<typename ParallelSelfPatchCompare<TImage>::Tile> ParallelSelfPatchCompare<TImage>::CreateTiles() const
+{
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+
+  // The source patch corners that keep the whole patch inside the image
+  itk::IndexValueType firstRow = fullRegion.GetIndex()[1];
+  itk::IndexValueType endRow = fullRegion.GetIndex()[1] + static_cast<itk::IndexValueType>(fullRegion.GetSize()[1]) -
+                               static_cast<itk::IndexValueType>(this->TargetRegion.GetSize()[1]) + 1;
+
+  std::vector<Tile> tiles;
+  if(endRow <= firstRow)
+  {
+    return tiles;
+  }
+
+  unsigned int rowsPerTile = this->RowsPerTile;
+  if(rowsPerTile == 0)
+  {
+    // Several tiles per thread so that threads that finish early can take over the remaining work.
+    const unsigned int tilesPerThread = 8;
+    unsigned int numberOfTiles = tilesPerThread * std::max(QThread::idealThreadCount(), 1);
+    rowsPerTile = std::max<unsigned int>((endRow - firstRow) / numberOfTiles, 1);
+  }
+
+  for(itk::IndexValueType row = firstRow; row < endRow; row += rowsPerTile)
+  {
+    Tile tile;
+    tile.Id = tiles.size();
+    tile.FirstRow = row;
+    tile.EndRow = std::min<itk::IndexValueType>(row + rowsPerTile, endRow);
+    tile.TopPatches.SetMaximumNumberOfPatches(this->NumberOfPatchesToKeep);
+    tiles.push_back(tile);
+  }
+
+  return tiles;
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::ScoreTile(Tile& tile) const
+{
+  BoundedPatchDistance<TImage>* boundedDistanceFunctor =
+    dynamic_cast<BoundedPatchDistance<TImage>*>(this->PatchDistanceFunctor);
+
+  BatchPatchDistance<TImage>* batchDistanceFunctor =
+    dynamic_cast<BatchPatchDistance<TImage>*>(this->PatchDistanceFunctor);
+
+  // The valid source corners of a row (if they have to be listed) and their distances, for the batch functors.
+  std::vector<itk::Index<2> > rowCornerScratch;
+  std::vector<float> rowDistances;
+
+  // With a fully valid mask every corner of the range is a source patch, so the corners are not listed.
+  itk::IndexValueType firstColumn;
+  itk::IndexValueType endColumn;
+  GetCornerColumnRange(firstColumn, endColumn);
+
+  QTime snapshotTimer;
+  snapshotTimer.start();
+
+  for(itk::IndexValueType row = tile.FirstRow; row < tile.EndRow; ++row)
+  {
+    // Checking once per row keeps the reaction time to a cancel request well below a tile.
+    if(IsCancelRequested())
+    {
+      return;
+    }
+
+    if(batchDistanceFunctor)
+    {
+      unsigned int numberOfRowCorners = 0;
+      const itk::Index<2>* rowCorners = GetRowCorners(row, rowCornerScratch, numberOfRowCorners);
+      ScoreRowBatch(tile, rowCorners, numberOfRowCorners, batchDistanceFunctor, boundedDistanceFunctor != NULL,
+                    rowDistances);
+    }
+    else if(this->MaskFullyValid)
+    {
+      for(itk::IndexValueType column = firstColumn; column < endColumn; ++column)
+      {
+        itk::Index<2> sourceCorner = {{column, row}};
+        ScoreCorner(tile, sourceCorner, boundedDistanceFunctor);
+      }
+    }
+    else
+    {
+      unsigned int numberOfRowCorners = 0;
+      const itk::Index<2>* rowCorners = this->ValidSourceCorners.GetRowCorners(row, numberOfRowCorners);
+      for(unsigned int cornerId = 0; cornerId < numberOfRowCorners; ++cornerId)
+      {
+        ScoreCorner(tile, rowCorners[cornerId], boundedDistanceFunctor);
+      }
+    }
+
+    this->NumberOfRowsDone.fetchAndAddRelaxed(1);
+
+    // Every tile publishes when it is done, so the snapshots of the last scan end up complete.
+    if(this->SnapshotInterval > 0 &&
+       (row + 1 == tile.EndRow || snapshotTimer.elapsed() >= static_cast<int>(this->SnapshotInterval)))
+    {
+      PublishSnapshot(tile);
+      snapshotTimer.restart();
+    }
+  }
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::ScoreCorner(Tile& tile, const itk::Index<2>& sourceCorner,
+                                                   BoundedPatchDistance<TImage>* const boundedDistanceFunctor) const
+{
+  itk::ImageRegion<2> sourceRegion(sourceCorner, this->TargetRegion.GetSize());
+
+  float distance = 0;
+  if(boundedDistanceFunctor)
+  {
+    float bound = std::min(tile.TopPatches.GetAdmissionThreshold(), GetSharedAdmissionThreshold());
+    distance = boundedDistanceFunctor->BoundedDistance(sourceRegion, this->TargetRegion, bound);
+    if(distance > bound)
+    {
+      return;
+    }
+  }
+  else
+  {
+    distance = this->PatchDistanceFunctor->Distance(sourceRegion, this->TargetRegion);
+  }
+
+  tile.TopPatches.Add(PatchDataType(sourceRegion, distance), GetRasterOrder(sourceCorner));
+
+  if(boundedDistanceFunctor && tile.TopPatches.IsFull())
+  {
+    LowerSharedAdmissionThreshold(tile.TopPatches.GetAdmissionThreshold());
+  }
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::ScoreRowBatch(Tile& tile, const itk::Index<2>* const rowCorners,
+                                                     const unsigned int numberOfRowCorners,
+                                                     BatchPatchDistance<TImage>* const batchDistanceFunctor,
+                                                     const bool bounded, std::vector<float>& rowDistances) const
+{
+  if(numberOfRowCorners == 0)
+  {
+    return;
+  }
+
+  // The bound is only taken once per row, so it is a little looser than the per patch bound of ScoreTile.
+  // Anything it lets through is still rejected by the collector, so the results are the same.
+  float bound = std::numeric_limits<float>::max();
+  if(bounded)
+  {
+    bound = std::min(tile.TopPatches.GetAdmissionThreshold(), GetSharedAdmissionThreshold());
+  }
+
+  rowDistances.resize(numberOfRowCorners);
+  batchDistanceFunctor->BatchDistance(this->TargetRegion, rowCorners, numberOfRowCorners, bound, &rowDistances[0]);
+
+  itk::ImageRegion<2> sourceRegion(this->TargetRegion.GetSize());
+  for(unsigned int cornerId = 0; cornerId < numberOfRowCorners; ++cornerId)
+  {
+    if(bounded && rowDistances[cornerId] > bound)
+    {
+      continue;
+    }
+
+    sourceRegion.SetIndex(rowCorners[cornerId]);
+    tile.TopPatches.Add(PatchDataType(sourceRegion, rowDistances[cornerId]), GetRasterOrder(rowCorners[cornerId]));
+  }
+
+  if(bounded && tile.TopPatches.IsFull())
+  {
+    LowerSharedAdmissionThreshold(tile.TopPatches.GetAdmissionThreshold());
+  }
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::ComputePatchScores()
+{
+  if(!this->Image || !this->MaskImage || !this->PatchDistanceFunctor)
+  {
+    throw std::runtime_error("ParallelSelfPatchCompare: Must set the image, mask, and PatchDistance functor "
+                             "before calling ComputePatchScores()!");
+  }
+
+  this->PatchData.clear();
+  this->NumberOfRowsDone = 0;
+  this->NumberOfRows = 0;
+
+  // Only the scans of masks with holes use the list of valid corners.
+  if(!this->MaskFullyValid)
+  {
+    this->ValidSourceCorners.SetPatchSize(this->TargetRegion.GetSize());
+    this->ValidSourceCorners.Update();
+  }
+
+  RunBackend();
+
+  // A canceled scan has only seen part of the image, so its patches are not the best ones.
+  if(IsCancelRequested())
+  {
+    this->PatchData.clear();
+    return;
+  }
+
+  this->PreviousTargetRegion = this->TargetRegion;
+
+  // The other backends do not report intermediate progress, so only mark them done.
+  if(static_cast<int>(this->NumberOfRows) == 0)
+  {
+    this->NumberOfRows = 1;
+  }
+  this->NumberOfRowsDone = static_cast<int>(this->NumberOfRows);
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::RunBackend()
+{
+  this->UsedBackend = EXHAUSTIVE;
+  this->FallbackReason.clear();
+
+  SearchBackend<TImage>* searchBackend = GetSearchBackend(this->Backend);
+  if(searchBackend)
+  {
+    typename SearchBackend<TImage>::Query query = CreateQuery();
+    if(searchBackend->CanComputePatchScores(query, this->FallbackReason))
+    {
+      this->PatchData = searchBackend->ComputePatchScores(query);
+      this->UsedBackend = this->Backend;
+      return;
+    }
+  }
+
+  if(CanUpdateIncrementally(this->TargetRegion))
+  {
+    ComputePatchScoresIncremental();
+    return;
+  }
+
+  ComputePatchScoresExhaustive();
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::ComputePatchScoresExhaustive()
+{
+  std::vector<Tile> tiles = CreateTiles();
+  this->NumberOfRows = tiles.empty() ? 0 : static_cast<int>(tiles.back().EndRow - tiles.front().FirstRow);
+
+  int maximumThresholdBits;
+  const float maximumThreshold = std::numeric_limits<float>::max();
+  memcpy(&maximumThresholdBits, &maximumThreshold, sizeof(float));
+  this->SharedAdmissionThreshold = maximumThresholdBits;
+
+  LockSnapshots();
+  this->TileSnapshots.assign(tiles.size(), TopPatchCollector<PatchDataType>(this->NumberOfPatchesToKeep));
+  UnlockSnapshots();
+
+  // QtConcurrent hands out the tiles to the threads of the global pool as they become idle. The calling
+  // thread also scores tiles, so this is safe to call from a thread that is itself in the pool.
+  QtConcurrent::blockingMap(tiles, TileScorer(this));
+
+  // Only the best NumberOfPatchesToKeep patches of each tile have to be merged.
+  TopPatchCollector<PatchDataType> topPatches(this->NumberOfPatchesToKeep);
+  for(size_t tileId = 0; tileId < tiles.size(); ++tileId)
+  {
+    topPatches.Merge(tiles[tileId].TopPatches);
+  }
+
+  this->PatchData = topPatches.GetSortedPatchData();
+}
+
+template <typename TImage>
+void ParallelSelfPatchCompare<TImage>::ComputePatchScoresIncremental()
+{
+  itk::Size<2> scoreSize;
+  const std::vector<double>& scores = this->IncrementalScoreMap.ComputeScores(this->TargetRegion, scoreSize);
+  if(IsCancelRequested())
+  {
+    return;
+  }
+
+  TopPatchCollector<PatchDataType> topPatches(this->NumberOfPatchesToKeep);
+  SearchBackend<TImage>::AddScoreMap(CreateQuery(), scores, scoreSize, std::numeric_limits<double>::max(),
+                                     topPatches);
+
+  this->PatchData = topPatches.GetSortedPatchData();
+}
+
+template <typename TImage>
+std::vector<typename ParallelSelfPatchCompare<TImage>::PatchDataType>
+ParallelSelfPatchCompare<TImage>::GetPatchData() const
+{
+  return this->PatchData;
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef PartialSSD_H
+#define PartialSSD_H
+
+// Submodules
+#include "PatchComparison/SSD.h"
+
+// Custom
+#include "AccumulatedPatchDistance.h"
+#include "BatchPatchDistance.h"
+#include "BoundedPatchDistance.h"
+
+/** The sum over all pixels and channels of the squared difference between two patches, which can stop
+  * early (checked once per row) when the sum already exceeds a bound.
+  * The sum is accumulated in double precision, so it is exact for 8-bit images. For interleaved 8-bit RGB
+  * images the rows are read directly from the pixel buffer by a vectorized kernel (see SSDKernels).
+  */
+template <typename TImage>
+class PartialSSD : public SSD<TImage>, public BoundedPatchDistance<TImage>, public BatchPatchDistance<TImage>,
+                   public AccumulatedPatchDistance<TImage>
+{
+public:
+
+  /** Compute the full SSD. */
+  float Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2);
+
+  /** Compute the SSD, stopping after the first row at which it exceeds 'bound'. */
+  float BoundedDistance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2,
+                        const float bound);
+
+  /** Compare the target to many sources. The pixels of the target are copied into a contiguous buffer once. */
+  void BatchDistance(const itk::ImageRegion<2>& targetRegion, const itk::Index<2>* const sourceCorners,
+                     const unsigned int numberOfSources, const float bound, float* const distances);
+
+  /** Create an accumulator that computes the full SSD from the rows of the image. */
+  PatchDistanceAccumulator<TImage>* CreateAccumulator();
+
+private:
+
+  /** Accumulates the SSD in double precision, in the same order as Distance(), so the results are identical. */
+  class SSDAccumulator : public PatchDistanceAccumulator<TImage>
+  {
+  public:
+
+    /** Constructor. */
+    SSDAccumulator(const PartialSSD* const functor);
+
+    /** Get the image of the functor. */
+    const TImage* GetImage() const;
+
+    /** Reset the sum. */
+    void Begin();
+
+    /** Add the squared differences of a pair of rows. */
+    void AddRow(const typename TImage::PixelType* const sourceRow, const typename TImage::PixelType* const targetRow,
+                const unsigned int numberOfPixels);
+
+    /** Get the sum. */
+    float GetDistance() const;
+
+  private:
+
+    /** The functor whose image is read. */
+    const PartialSSD* Functor;
+
+    /** The sum of the squared differences of the rows added so far. */
+    double Sum;
+  };
+};
+
+#include "PartialSSD.hpp"
+
+#endif
@@ -0,0 +1,98 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef PartialSSD_HPP
+#define PartialSSD_HPP
+
+#include "PartialSSD.h"
+
+// STL
+#include <limits>
+
+// Custom
+#include "SSDKernels.h"
+
+template <typename TImage>
+float PartialSSD<TImage>::Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2)
+{
+  return BoundedDistance(region1, region2, std::numeric_limits<float>::max());
+}
+
+template <typename TImage>
+float PartialSSD<TImage>::BoundedDistance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2,
+                                          const float bound)
+{
+  // Overload resolution picks the vectorized version for interleaved 8-bit RGB images.
+  return SSDKernels::BoundedSSD(this->Image, region1, region2, bound);
+}
+
+template <typename TImage>
+void PartialSSD<TImage>::BatchDistance(const itk::ImageRegion<2>& targetRegion,
+                                       const itk::Index<2>* const sourceCorners,
+                                       const unsigned int numberOfSources, const float bound, float* const distances)
+{
+  SSDKernels::BatchBoundedSSD(this->Image, targetRegion, sourceCorners, numberOfSources, bound, distances);
+}
+
+template <typename TImage>
+PatchDistanceAccumulator<TImage>* PartialSSD<TImage>::CreateAccumulator()
+{
+  return new SSDAccumulator(this);
+}
+
+template <typename TImage>
+PartialSSD<TImage>::SSDAccumulator::SSDAccumulator(const PartialSSD* const functor) : Functor(functor), Sum(0)
+{
+}
+
+template <typename TImage>
+const TImage* PartialSSD<TImage>::SSDAccumulator::GetImage() const
+{
+  return this->Functor->Image;
+}
+
+template <typename TImage>
+void PartialSSD<TImage>::SSDAccumulator::Begin()
+{
+  this->Sum = 0;
+}
+
+template <typename TImage>
+void PartialSSD<TImage>::SSDAccumulator::AddRow(const typename TImage::PixelType* const sourceRow,
+                                                const typename TImage::PixelType* const targetRow,
+                                                const unsigned int numberOfPixels)
+{
+  const unsigned int numberOfComponents = this->Functor->Image->GetNumberOfComponentsPerPixel();
+  for(unsigned int pixelId = 0; pixelId < numberOfPixels; ++pixelId)
+  {
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      double difference = static_cast<double>(sourceRow[pixelId][component]) -
+                          static_cast<double>(targetRow[pixelId][component]);
+      this->Sum += difference * difference;
+    }
+  }
+}
+
+template <typename TImage>
+float PartialSSD<TImage>::SSDAccumulator::GetDistance() const
+{
+  return static_cast<float>(this->Sum);
+}
+
+#endif
@@ -26,6 +26,7 @@
 
 // Custom
 #include "PatchComparison/Mask/Mask.h"
+#include "PatchStatisticsCache.h"
 #include "Types.h"
 
 class SwitchBetweenStyle;
@@ -75,6 +76,10 @@ public:
   /** Set the mask that specifies valid regions of the image. */
   void SetMask(Mask* const mask);
 
+  /** Set the cache used to compute the patch mean and variance. If it is not set, they are computed
+    * by visiting every pixel of the patch. */
+  void SetStatisticsCache(PatchStatisticsCache<TImage>* const statisticsCache);
+
   /** Save the selected patch. */
   void Save(const std::string& prefix);
 
@@ -120,6 +125,9 @@ private:
   /** The mask indicating image validity. */
   Mask* MaskImage;
 
+  /** The summed area tables of the image and mask. */
+  PatchStatisticsCache<TImage>* StatisticsCache;
+
   /** The region to display. */
   itk::ImageRegion<2> Region;
 
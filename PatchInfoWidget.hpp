@@ -48,6 +48,7 @@ PatchInfoWidget<TImage>::PatchInfoWidget(QWidget* parent) : PatchInfoWidgetParen
 {
   this->MaskImage = NULL;
   this->Image = NULL;
+  this->StatisticsCache = NULL;
 
   setupUi(this);
 //   this->txtXCenter->installEventFilter(this);
@@ -92,6 +93,12 @@ void PatchInfoWidget<TImage>::SetMask(Mask* const mask)
   this->MaskImage = mask;
 }
 
+template <typename TImage>
+void PatchInfoWidget<TImage>::SetStatisticsCache(PatchStatisticsCache<TImage>* const statisticsCache)
+{
+  this->StatisticsCache = statisticsCache;
+}
+
 // void PatchInfoWidget::on_txtXCenter_valueChanged(int value)
 // {
 //   // When the focus enters one of the text boxes
@@ -164,7 +171,38 @@ void PatchInfoWidget<TImage>::Update()
   //variance.SetSize(Image->GetNumberOfComponentsPerPixel()); // If using VectorImage
   variance.Fill(0);
 
-  if(this->MaskImage && this->MaskImage->CountValidPixels(this->Region) > 0)
+  // The cache reads its tables if a distance functor has built them, and otherwise walks the patch.
+  const unsigned int numberOfValidPixels = this->StatisticsCache ?
+                                           this->StatisticsCache->CountValidPixels(this->Region) : 0;
+  if(this->StatisticsCache && numberOfValidPixels > 0)
+  {
+    // As below, the average is over all of the pixels of the patch and the variance over its valid pixels. The cache
+    // only has the sums of the valid pixels, so it only gives the same average when the patch is fully valid.
+    if(numberOfValidPixels == this->Region.GetNumberOfPixels())
+    {
+      typename PatchStatisticsCache<TImage>::StatisticsType cachedAverage =
+        this->StatisticsCache->GetMean(this->Region);
+      for(unsigned int component = 0; component < cachedAverage.GetSize(); ++component)
+      {
+        average[component] = cachedAverage[component];
+      }
+    }
+    else
+    {
+      average = ITKHelpers::AverageInRegion(Image, this->Region);
+    }
+
+    typename PatchStatisticsCache<TImage>::StatisticsType cachedVariance =
+      this->StatisticsCache->GetVariance(this->Region);
+    for(unsigned int component = 0; component < cachedVariance.GetSize(); ++component)
+    {
+      variance[component] = cachedVariance[component];
+    }
+
+    this->lblPixelMean->setText(ITKHelpers::VectorToString(average).c_str());
+    this->lblPixelVariance->setText(ITKHelpers::VectorToString(variance).c_str());
+  }
+  else if(!this->StatisticsCache && this->MaskImage && this->MaskImage->CountValidPixels(this->Region) > 0)
   {
     //average = Helpers::AverageInRegionMasked(Image.GetPointer(), MaskImage.GetPointer(), patchRegion);
 
@@ -0,0 +1,68 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PatchMatchSearchBackend_H
+#define PatchMatchSearchBackend_H
+
+// Custom
+#include "PatchMatchSelfPatchCompare.h"
+#include "SearchBackend.h"
+
+/** The PATCH_MATCH backend of ParallelSelfPatchCompare. The best patches are found approximately with
+  * PatchMatchSelfPatchCompare, which only scores a small fraction of the source patches. Its nearest neighbor field
+  * is computed by the first query for a patch size and kept between queries. Any functor is supported.
+  */
+template <typename TImage>
+class PatchMatchSearchBackend : public SearchBackend<TImage>
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SearchBackend<TImage>::PatchDataType PatchDataType;
+
+  /** Everything about one query. */
+  typedef typename SearchBackend<TImage>::Query Query;
+
+  /** Set the number of iterations used to compute the nearest neighbor field. */
+  void SetNumberOfIterations(const unsigned int numberOfIterations);
+
+  /** Set the seed of the random initialization and search of the nearest neighbor field. */
+  void SetRandomSeed(const unsigned int randomSeed);
+
+  /** Always true. */
+  bool SupportsPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor) const;
+
+  /** True if a bounded number of patches is kept. */
+  bool CanComputePatchScores(const Query& query, std::string& reason);
+
+  /** Find the best patches with the nearest neighbor field, computing it first if needed. */
+  std::vector<PatchDataType> ComputePatchScores(const Query& query);
+
+  /** Set a flag that is checked between the rows of the nearest neighbor field computation. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+private:
+
+  /** The approximate search, which keeps the nearest neighbor field. */
+  PatchMatchSelfPatchCompare<TImage> PatchMatch;
+};
+
+#include "PatchMatchSearchBackend.hpp"
+
+#endif
@@ -0,0 +1,90 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PatchMatchSearchBackend_HPP
+#define PatchMatchSearchBackend_HPP
+
+#include "PatchMatchSearchBackend.h"
+
+template <typename TImage>
+void PatchMatchSearchBackend<TImage>::SetNumberOfIterations(const unsigned int numberOfIterations)
+{
+  this->PatchMatch.SetNumberOfIterations(numberOfIterations);
+}
+
+template <typename TImage>
+void PatchMatchSearchBackend<TImage>::SetRandomSeed(const unsigned int randomSeed)
+{
+  this->PatchMatch.SetRandomSeed(randomSeed);
+}
+
+template <typename TImage>
+bool PatchMatchSearchBackend<TImage>::SupportsPatchDistanceFunctor(PatchDistance<TImage>* const) const
+{
+  return true;
+}
+
+template <typename TImage>
+bool PatchMatchSearchBackend<TImage>::CanComputePatchScores(const Query& query, std::string& reason)
+{
+  if(query.NumberOfPatchesToKeep == 0)
+  {
+    reason = "The PATCH_MATCH backend requires a bounded number of patches to keep.";
+    return false;
+  }
+  return true;
+}
+
+template <typename TImage>
+void PatchMatchSearchBackend<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->PatchMatch.SetCancelFlag(cancelFlag);
+}
+
+template <typename TImage>
+std::vector<typename PatchMatchSearchBackend<TImage>::PatchDataType>
+PatchMatchSearchBackend<TImage>::ComputePatchScores(const Query& query)
+{
+  this->PatchMatch.SetImage(query.Image);
+  // Without a mask PatchMatch skips the per-patch mask test.
+  this->PatchMatch.SetMask(query.MaskImage);
+  this->PatchMatch.SetPatchDistanceFunctor(query.PatchDistanceFunctor);
+
+  // The nearest neighbor field of the patch size is computed by the first query and then seeds every query
+  // until the inputs change, so the following queries (e.g. as the target moves) start from good matches.
+  const itk::Size<2> patchSize = query.TargetRegion.GetSize();
+  if(!this->PatchMatch.HasNearestNeighborField(patchSize))
+  {
+    this->PatchMatch.ComputeNearestNeighborField(patchSize);
+
+    // A canceled computation leaves no field.
+    if(!this->PatchMatch.HasNearestNeighborField(patchSize))
+    {
+      return std::vector<PatchDataType>();
+    }
+  }
+
+  this->PatchMatch.SetTargetRegion(query.TargetRegion);
+  this->PatchMatch.SetNumberOfPatchesToKeep(query.NumberOfPatchesToKeep);
+  this->PatchMatch.ComputePatchScores();
+
+  return this->PatchMatch.GetPatchData();
+}
+
+#endif
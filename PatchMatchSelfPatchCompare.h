@@ -0,0 +1,209 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef PatchMatchSelfPatchCompare_H
+#define PatchMatchSelfPatchCompare_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// Qt
+#include <QAtomicInt>
+
+// STL
+#include <random>
+#include <set>
+#include <vector>
+
+// Submodules
+#include "PatchComparison/Mask/Mask.h"
+#include "PatchComparison/PatchDistance.h"
+#include "PatchComparison/SelfPatchCompare.h"
+
+// Custom
+#include "BoundedPatchDistance.h"
+#include "TopPatchCollector.h"
+
+/** Approximate nearest neighbor search of the patches of an image with PatchMatch
+  * (Barnes et al., "PatchMatch: A Randomized Correspondence Algorithm for Structural Image Editing").
+  * Works with any PatchDistance functor; only source patches that are entirely valid in the mask are used.
+  *
+  * ComputePatchScores() finds approximate best NumberOfPatchesToKeep source patches of a single target region.
+  * It starts from random source patches, then on each iteration tries the neighbors of every kept patch
+  * (propagation: neighboring patches of a good match are likely to be good matches, since images are coherent)
+  * and random patches in exponentially shrinking windows around it (random search). If a nearest neighbor
+  * field for the same patch size has been computed, the field entries of the target, its neighbors, and the kept
+  * patches are tried as well.
+  *
+  * ComputeNearestNeighborField() finds the approximate best source patch (other than itself) of every patch
+  * of the image, alternating forward and backward raster scans as in the paper. The field is kept until the image,
+  * mask, functor, number of iterations, or seed changes (setting the same pointer or value again keeps it, and the
+  * image and mask are also checked for modifications).
+  *
+  * Results only depend on the inputs and the random seed. If the functor is a BoundedPatchDistance, it is
+  * given the score a candidate has to beat so it can stop early.
+  */
+template <typename TImage>
+class PatchMatchSelfPatchCompare
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SelfPatchCompare<TImage>::PatchDataType PatchDataType;
+
+  /** Constructor. */
+  PatchMatchSelfPatchCompare();
+
+  /** Set the image to search. */
+  void SetImage(TImage* const image);
+
+  /** Set the mask. Only source patches that are entirely valid are used. If no mask is set, every patch is valid. */
+  void SetMask(Mask* const mask);
+
+  /** Set the target/query region used by ComputePatchScores(). */
+  void SetTargetRegion(const itk::ImageRegion<2>& targetRegion);
+
+  /** Set the functor used to compare patches. */
+  void SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor);
+
+  /** Set the number of best patches ComputePatchScores() keeps. This must not be 0. */
+  void SetNumberOfPatchesToKeep(const unsigned int numberOfPatchesToKeep);
+
+  /** Set the number of propagation/random search iterations. */
+  void SetNumberOfIterations(const unsigned int numberOfIterations);
+
+  /** Get the number of propagation/random search iterations. */
+  unsigned int GetNumberOfIterations() const;
+
+  /** Set the seed of the random number generator. */
+  void SetRandomSeed(const unsigned int randomSeed);
+
+  /** Get the seed of the random number generator. */
+  unsigned int GetRandomSeed() const;
+
+  /** Find the approximate best source patches of the target region. */
+  void ComputePatchScores();
+
+  /** Get the patches kept by the last call to ComputePatchScores(), best first. */
+  std::vector<PatchDataType> GetPatchData() const;
+
+  /** Compute the approximate nearest neighbor of every patch of the given size. */
+  void ComputeNearestNeighborField(const itk::Size<2>& patchSize);
+
+  /** True if a nearest neighbor field for patches of this size is available and still matches the inputs. */
+  bool HasNearestNeighborField(const itk::Size<2>& patchSize) const;
+
+  /** Set a flag that is checked between rows of ComputeNearestNeighborField(). When it becomes non-zero, the
+    * field is discarded and the computation stops. NULL (the default) means it cannot be canceled. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+  /** Get the nearest neighbor of the patch with the given corner (from ComputeNearestNeighborField()).
+    * The distance is the largest float if no valid source patch was found. */
+  PatchDataType GetNearestNeighbor(const itk::Index<2>& corner) const;
+
+private:
+
+  /** The random number generator type. A fixed engine gives the same results on every platform. */
+  typedef std::mt19937 RandomGeneratorType;
+
+  /** The corners of the patches of the current size that are inside the image. */
+  itk::ImageRegion<2> GetCornerRegion(const itk::Size<2>& patchSize) const;
+
+  /** True if the patch with this corner is inside the image and entirely valid. */
+  bool IsValidSource(const itk::Index<2>& corner, const itk::Size<2>& patchSize) const;
+
+  /** Get the position of a corner in the raster scan of a corner region. */
+  static size_t GetCornerId(const itk::ImageRegion<2>& cornerRegion, const itk::Index<2>& corner);
+
+  /** Get a uniformly distributed corner within 'radius' of 'center', clamped to the corner region. */
+  itk::Index<2> GetRandomCorner(const itk::Index<2>& center, const itk::IndexValueType radius,
+                                RandomGeneratorType& generator) const;
+
+  /** Score a source corner against the target region and add it to 'topPatches' if it is valid, was not
+    * tried before, and is good enough. */
+  void TryCandidate(const itk::Index<2>& corner, TopPatchCollector<PatchDataType>& topPatches,
+                    std::set<size_t>& triedCorners) const;
+
+  /** Replace the nearest neighbor of 'targetCorner' with 'sourceCorner' if it is valid and better. */
+  void ImproveNearestNeighbor(const itk::Index<2>& targetCorner, const itk::Index<2>& sourceCorner,
+                              const itk::Size<2>& patchSize);
+
+  /** Check that everything needed to search has been set. */
+  void CheckInputs() const;
+
+  /** Discard the nearest neighbor field. */
+  void ClearNearestNeighborField();
+
+  /** True if the cancel flag is set. */
+  bool IsCancelRequested() const;
+
+  /** The image to search. */
+  TImage* Image;
+
+  /** The mask indicating which pixels can be used in source patches. */
+  Mask* MaskImage;
+
+  /** The query/target region. */
+  itk::ImageRegion<2> TargetRegion;
+
+  /** The functor used to compare patches. */
+  PatchDistance<TImage>* PatchDistanceFunctor;
+
+  /** The functor as a BoundedPatchDistance, or NULL if it is not one. */
+  BoundedPatchDistance<TImage>* BoundedDistanceFunctor;
+
+  /** The number of best patches to keep. */
+  unsigned int NumberOfPatchesToKeep;
+
+  /** The number of propagation/random search iterations. */
+  unsigned int NumberOfIterations;
+
+  /** The seed of the random number generator. */
+  unsigned int RandomSeed;
+
+  /** The corners of the patches of the current size (the patch size of the query or the field). */
+  itk::ImageRegion<2> CornerRegion;
+
+  /** The best source patches of the target region, sorted by score. */
+  std::vector<PatchDataType> PatchData;
+
+  /** The patch size the nearest neighbor field was computed for (0 if there is no field). */
+  itk::Size<2> FieldPatchSize;
+
+  /** The corner of the nearest neighbor of each corner, in raster order of FieldCornerRegion. */
+  std::vector<itk::Index<2> > NearestNeighborField;
+
+  /** The distance to the nearest neighbor of each corner. */
+  std::vector<float> NearestNeighborDistances;
+
+  /** The corners the nearest neighbor field covers. */
+  itk::ImageRegion<2> FieldCornerRegion;
+
+  /** The modified time of the image when the field was computed. */
+  unsigned long FieldImageMTime;
+
+  /** The modified time of the mask when the field was computed (0 without a mask). */
+  unsigned long FieldMaskMTime;
+
+  /** The flag that cancels ComputeNearestNeighborField(), or NULL. */
+  const QAtomicInt* CancelFlag;
+};
+
+#include "PatchMatchSelfPatchCompare.hpp"
+
+#endif
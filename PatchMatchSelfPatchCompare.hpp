@@ -0,0 +1,460 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef PatchMatchSelfPatchCompare_HPP
+#define PatchMatchSelfPatchCompare_HPP
+
+#include "PatchMatchSelfPatchCompare.h"
+
+// STL
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+template <typename TImage>
+PatchMatchSelfPatchCompare<TImage>::PatchMatchSelfPatchCompare() : Image(NULL), MaskImage(NULL),
+PatchDistanceFunctor(NULL), BoundedDistanceFunctor(NULL), NumberOfPatchesToKeep(10), NumberOfIterations(5),
+RandomSeed(0), FieldImageMTime(0), FieldMaskMTime(0), CancelFlag(NULL)
+{
+  this->FieldPatchSize.Fill(0);
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::SetImage(TImage* const image)
+{
+  if(image != this->Image)
+  {
+    ClearNearestNeighborField();
+  }
+  this->Image = image;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::SetMask(Mask* const mask)
+{
+  if(mask != this->MaskImage)
+  {
+    ClearNearestNeighborField();
+  }
+  this->MaskImage = mask;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::SetTargetRegion(const itk::ImageRegion<2>& targetRegion)
+{
+  this->TargetRegion = targetRegion;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor)
+{
+  if(patchDistanceFunctor == this->PatchDistanceFunctor)
+  {
+    return;
+  }
+  this->PatchDistanceFunctor = patchDistanceFunctor;
+  this->BoundedDistanceFunctor = dynamic_cast<BoundedPatchDistance<TImage>*>(patchDistanceFunctor);
+  ClearNearestNeighborField();
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::SetNumberOfPatchesToKeep(const unsigned int numberOfPatchesToKeep)
+{
+  this->NumberOfPatchesToKeep = numberOfPatchesToKeep;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::SetNumberOfIterations(const unsigned int numberOfIterations)
+{
+  if(numberOfIterations != this->NumberOfIterations)
+  {
+    ClearNearestNeighborField();
+  }
+  this->NumberOfIterations = numberOfIterations;
+}
+
+template <typename TImage>
+unsigned int PatchMatchSelfPatchCompare<TImage>::GetNumberOfIterations() const
+{
+  return this->NumberOfIterations;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::SetRandomSeed(const unsigned int randomSeed)
+{
+  if(randomSeed != this->RandomSeed)
+  {
+    ClearNearestNeighborField();
+  }
+  this->RandomSeed = randomSeed;
+}
+
+template <typename TImage>
+unsigned int PatchMatchSelfPatchCompare<TImage>::GetRandomSeed() const
+{
+  return this->RandomSeed;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->CancelFlag = cancelFlag;
+}
+
+template <typename TImage>
+bool PatchMatchSelfPatchCompare<TImage>::IsCancelRequested() const
+{
+  return this->CancelFlag && static_cast<int>(*this->CancelFlag) != 0;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::CheckInputs() const
+{
+  if(!this->Image || !this->PatchDistanceFunctor)
+  {
+    throw std::runtime_error("PatchMatchSelfPatchCompare: Must set the image and PatchDistance functor before searching!");
+  }
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::ClearNearestNeighborField()
+{
+  this->FieldPatchSize.Fill(0);
+  this->NearestNeighborField.clear();
+  this->NearestNeighborDistances.clear();
+}
+
+template <typename TImage>
+itk::ImageRegion<2> PatchMatchSelfPatchCompare<TImage>::GetCornerRegion(const itk::Size<2>& patchSize) const
+{
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+
+  itk::Size<2> cornerSize;
+  for(unsigned int dimension = 0; dimension < 2; ++dimension)
+  {
+    cornerSize[dimension] = (patchSize[dimension] <= fullRegion.GetSize()[dimension]) ?
+                            fullRegion.GetSize()[dimension] - patchSize[dimension] + 1 : 0;
+  }
+
+  return itk::ImageRegion<2>(fullRegion.GetIndex(), cornerSize);
+}
+
+template <typename TImage>
+bool PatchMatchSelfPatchCompare<TImage>::IsValidSource(const itk::Index<2>& corner,
+                                                       const itk::Size<2>& patchSize) const
+{
+  if(!this->CornerRegion.IsInside(corner))
+  {
+    return false;
+  }
+
+  return !this->MaskImage || this->MaskImage->IsValid(itk::ImageRegion<2>(corner, patchSize));
+}
+
+template <typename TImage>
+size_t PatchMatchSelfPatchCompare<TImage>::GetCornerId(const itk::ImageRegion<2>& cornerRegion,
+                                                       const itk::Index<2>& corner)
+{
+  return (corner[1] - cornerRegion.GetIndex()[1]) * cornerRegion.GetSize()[0] +
+         (corner[0] - cornerRegion.GetIndex()[0]);
+}
+
+template <typename TImage>
+itk::Index<2> PatchMatchSelfPatchCompare<TImage>::GetRandomCorner(const itk::Index<2>& center,
+                                                                  const itk::IndexValueType radius,
+                                                                  RandomGeneratorType& generator) const
+{
+  itk::Index<2> corner;
+  for(unsigned int dimension = 0; dimension < 2; ++dimension)
+  {
+    itk::IndexValueType first = this->CornerRegion.GetIndex()[dimension];
+    itk::IndexValueType last = first + static_cast<itk::IndexValueType>(this->CornerRegion.GetSize()[dimension]) - 1;
+    std::uniform_int_distribution<itk::IndexValueType> distribution(std::max(center[dimension] - radius, first),
+                                                                    std::min(center[dimension] + radius, last));
+    corner[dimension] = distribution(generator);
+  }
+  return corner;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::TryCandidate(const itk::Index<2>& corner,
+                                                      TopPatchCollector<PatchDataType>& topPatches,
+                                                      std::set<size_t>& triedCorners) const
+{
+  if(!this->CornerRegion.IsInside(corner))
+  {
+    return;
+  }
+
+  // Each corner is only scored once, and the mask test is not repeated for corners that were rejected.
+  size_t cornerId = GetCornerId(this->CornerRegion, corner);
+  if(!triedCorners.insert(cornerId).second || !IsValidSource(corner, this->TargetRegion.GetSize()))
+  {
+    return;
+  }
+
+  itk::ImageRegion<2> sourceRegion(corner, this->TargetRegion.GetSize());
+
+  float distance = 0;
+  if(this->BoundedDistanceFunctor)
+  {
+    float bound = topPatches.GetAdmissionThreshold();
+    distance = this->BoundedDistanceFunctor->BoundedDistance(sourceRegion, this->TargetRegion, bound);
+    if(distance > bound)
+    {
+      return;
+    }
+  }
+  else
+  {
+    distance = this->PatchDistanceFunctor->Distance(sourceRegion, this->TargetRegion);
+  }
+
+  topPatches.Add(PatchDataType(sourceRegion, distance), cornerId);
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::ComputePatchScores()
+{
+  CheckInputs();
+  if(this->NumberOfPatchesToKeep == 0)
+  {
+    throw std::runtime_error("PatchMatchSelfPatchCompare: NumberOfPatchesToKeep must not be 0!");
+  }
+
+  this->PatchData.clear();
+
+  this->CornerRegion = GetCornerRegion(this->TargetRegion.GetSize());
+  if(this->CornerRegion.GetNumberOfPixels() == 0)
+  {
+    return;
+  }
+
+  RandomGeneratorType generator(this->RandomSeed);
+  TopPatchCollector<PatchDataType> topPatches(this->NumberOfPatchesToKeep);
+  std::set<size_t> triedCorners;
+
+  const itk::IndexValueType maximumRadius = std::max(this->CornerRegion.GetSize()[0], this->CornerRegion.GetSize()[1]);
+  const itk::Index<2> targetCorner = this->TargetRegion.GetIndex();
+  const itk::IndexValueType neighborOffsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+  // The target patch itself is the exact best match when it is valid, as in the exhaustive search.
+  TryCandidate(targetCorner, topPatches, triedCorners);
+
+  // Random initialization
+  const unsigned int numberOfRandomCandidates = std::max(this->NumberOfPatchesToKeep, 32u);
+  for(unsigned int candidateId = 0; candidateId < numberOfRandomCandidates; ++candidateId)
+  {
+    TryCandidate(GetRandomCorner(this->CornerRegion.GetIndex(), maximumRadius, generator), topPatches, triedCorners);
+  }
+
+  // Seed with the matches of the target and its neighbors (shifted back onto the target) from the field.
+  const bool useField = HasNearestNeighborField(this->TargetRegion.GetSize());
+  if(useField && this->FieldCornerRegion.IsInside(targetCorner))
+  {
+    TryCandidate(this->NearestNeighborField[GetCornerId(this->FieldCornerRegion, targetCorner)],
+                 topPatches, triedCorners);
+    for(unsigned int neighborId = 0; neighborId < 4; ++neighborId)
+    {
+      itk::Index<2> neighbor = {{targetCorner[0] + neighborOffsets[neighborId][0],
+                                 targetCorner[1] + neighborOffsets[neighborId][1]}};
+      if(this->FieldCornerRegion.IsInside(neighbor))
+      {
+        itk::Index<2> match = this->NearestNeighborField[GetCornerId(this->FieldCornerRegion, neighbor)];
+        itk::Index<2> candidate = {{match[0] - neighborOffsets[neighborId][0],
+                                    match[1] - neighborOffsets[neighborId][1]}};
+        TryCandidate(candidate, topPatches, triedCorners);
+      }
+    }
+  }
+
+  for(unsigned int iteration = 0; iteration < this->NumberOfIterations; ++iteration)
+  {
+    std::vector<PatchDataType> currentPatches = topPatches.GetSortedPatchData();
+    for(size_t patchId = 0; patchId < currentPatches.size(); ++patchId)
+    {
+      itk::Index<2> corner = currentPatches[patchId].first.GetIndex();
+
+      // Propagation
+      for(unsigned int neighborId = 0; neighborId < 4; ++neighborId)
+      {
+        itk::Index<2> neighbor = {{corner[0] + neighborOffsets[neighborId][0],
+                                   corner[1] + neighborOffsets[neighborId][1]}};
+        TryCandidate(neighbor, topPatches, triedCorners);
+      }
+
+      // A patch that matches a good match is likely to be a good match as well.
+      if(useField)
+      {
+        TryCandidate(this->NearestNeighborField[GetCornerId(this->FieldCornerRegion, corner)], topPatches, triedCorners);
+      }
+
+      // Random search
+      for(itk::IndexValueType radius = maximumRadius; radius >= 1; radius /= 2)
+      {
+        TryCandidate(GetRandomCorner(corner, radius, generator), topPatches, triedCorners);
+      }
+    }
+  }
+
+  this->PatchData = topPatches.GetSortedPatchData();
+}
+
+template <typename TImage>
+std::vector<typename PatchMatchSelfPatchCompare<TImage>::PatchDataType>
+PatchMatchSelfPatchCompare<TImage>::GetPatchData() const
+{
+  return this->PatchData;
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::ImproveNearestNeighbor(const itk::Index<2>& targetCorner,
+                                                                const itk::Index<2>& sourceCorner,
+                                                                const itk::Size<2>& patchSize)
+{
+  if(sourceCorner == targetCorner || !IsValidSource(sourceCorner, patchSize))
+  {
+    return;
+  }
+
+  size_t targetId = GetCornerId(this->FieldCornerRegion, targetCorner);
+  float bound = this->NearestNeighborDistances[targetId];
+
+  itk::ImageRegion<2> targetRegion(targetCorner, patchSize);
+  itk::ImageRegion<2> sourceRegion(sourceCorner, patchSize);
+
+  float distance = this->BoundedDistanceFunctor ?
+                   this->BoundedDistanceFunctor->BoundedDistance(sourceRegion, targetRegion, bound) :
+                   this->PatchDistanceFunctor->Distance(sourceRegion, targetRegion);
+
+  if(distance < bound)
+  {
+    this->NearestNeighborField[targetId] = sourceCorner;
+    this->NearestNeighborDistances[targetId] = distance;
+  }
+}
+
+template <typename TImage>
+void PatchMatchSelfPatchCompare<TImage>::ComputeNearestNeighborField(const itk::Size<2>& patchSize)
+{
+  CheckInputs();
+  ClearNearestNeighborField();
+
+  this->CornerRegion = GetCornerRegion(patchSize);
+  this->FieldCornerRegion = this->CornerRegion;
+  const size_t numberOfCorners = this->CornerRegion.GetNumberOfPixels();
+  if(numberOfCorners == 0)
+  {
+    return;
+  }
+
+  this->NearestNeighborField.assign(numberOfCorners, this->CornerRegion.GetIndex());
+  this->NearestNeighborDistances.assign(numberOfCorners, std::numeric_limits<float>::max());
+
+  RandomGeneratorType generator(this->RandomSeed);
+  const itk::IndexValueType maximumRadius = std::max(this->CornerRegion.GetSize()[0], this->CornerRegion.GetSize()[1]);
+  const itk::IndexValueType firstColumn = this->CornerRegion.GetIndex()[0];
+  const itk::IndexValueType firstRow = this->CornerRegion.GetIndex()[1];
+  const itk::IndexValueType numberOfColumns = this->CornerRegion.GetSize()[0];
+  const itk::IndexValueType numberOfRows = this->CornerRegion.GetSize()[1];
+
+  // Random initialization. A few attempts are made so that masked images do not leave most patches unmatched.
+  const unsigned int maximumInitializationAttempts = 8;
+  for(size_t cornerId = 0; cornerId < numberOfCorners; ++cornerId)
+  {
+    itk::Index<2> targetCorner = {{firstColumn + static_cast<itk::IndexValueType>(cornerId % numberOfColumns),
+                                   firstRow + static_cast<itk::IndexValueType>(cornerId / numberOfColumns)}};
+    for(unsigned int attempt = 0; attempt < maximumInitializationAttempts &&
+        this->NearestNeighborDistances[cornerId] == std::numeric_limits<float>::max(); ++attempt)
+    {
+      ImproveNearestNeighbor(targetCorner, GetRandomCorner(this->CornerRegion.GetIndex(), maximumRadius, generator),
+                             patchSize);
+    }
+  }
+
+  for(unsigned int iteration = 0; iteration < this->NumberOfIterations; ++iteration)
+  {
+    // Alternate the scan direction so that good matches propagate both ways.
+    const itk::IndexValueType step = (iteration % 2 == 0) ? 1 : -1;
+
+    for(itk::IndexValueType rowId = 0; rowId < numberOfRows; ++rowId)
+    {
+      if(IsCancelRequested())
+      {
+        ClearNearestNeighborField();
+        return;
+      }
+
+      itk::IndexValueType row = (step > 0) ? firstRow + rowId : firstRow + numberOfRows - 1 - rowId;
+      for(itk::IndexValueType columnId = 0; columnId < numberOfColumns; ++columnId)
+      {
+        itk::IndexValueType column = (step > 0) ? firstColumn + columnId : firstColumn + numberOfColumns - 1 - columnId;
+        itk::Index<2> targetCorner = {{column, row}};
+
+        // Propagation from the neighbors that were already visited in this scan
+        for(unsigned int dimension = 0; dimension < 2; ++dimension)
+        {
+          itk::Index<2> neighbor = targetCorner;
+          neighbor[dimension] -= step;
+          if(this->CornerRegion.IsInside(neighbor))
+          {
+            itk::Index<2> candidate = this->NearestNeighborField[GetCornerId(this->CornerRegion, neighbor)];
+            candidate[dimension] += step;
+            ImproveNearestNeighbor(targetCorner, candidate, patchSize);
+          }
+        }
+
+        // Random search around the current best match
+        size_t targetId = GetCornerId(this->CornerRegion, targetCorner);
+        for(itk::IndexValueType radius = maximumRadius; radius >= 1; radius /= 2)
+        {
+          ImproveNearestNeighbor(targetCorner, GetRandomCorner(this->NearestNeighborField[targetId], radius, generator),
+                                 patchSize);
+        }
+      }
+    }
+  }
+
+  this->FieldPatchSize = patchSize;
+  this->FieldImageMTime = this->Image->GetMTime();
+  this->FieldMaskMTime = this->MaskImage ? this->MaskImage->GetMTime() : 0;
+}
+
+template <typename TImage>
+bool PatchMatchSelfPatchCompare<TImage>::HasNearestNeighborField(const itk::Size<2>& patchSize) const
+{
+  return !this->NearestNeighborField.empty() && this->FieldPatchSize == patchSize && this->Image &&
+         this->Image->GetMTime() == this->FieldImageMTime &&
+         (this->MaskImage ? this->MaskImage->GetMTime() : 0) == this->FieldMaskMTime;
+}
+
+template <typename TImage>
+typename PatchMatchSelfPatchCompare<TImage>::PatchDataType
+PatchMatchSelfPatchCompare<TImage>::GetNearestNeighbor(const itk::Index<2>& corner) const
+{
+  if(this->NearestNeighborField.empty() || !this->FieldCornerRegion.IsInside(corner))
+  {
+    throw std::runtime_error("PatchMatchSelfPatchCompare: There is no nearest neighbor field entry for this corner!");
+  }
+
+  size_t cornerId = GetCornerId(this->FieldCornerRegion, corner);
+  return PatchDataType(itk::ImageRegion<2>(this->NearestNeighborField[cornerId], this->FieldPatchSize),
+                       this->NearestNeighborDistances[cornerId]);
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef PatchStatisticsCache_H
+#define PatchStatisticsCache_H
+
+// ITK
+#include "itkImageRegion.h"
+#include "itkVariableLengthVector.h"
+
+// Qt
+#include <QAtomicInt>
+#include <QMutex>
+
+// STL
+#include <vector>
+
+// Submodules
+#include "PatchComparison/Mask/Mask.h"
+
+/** Summed area tables (integral images) of an image and its mask, so that the mean, variance, and number of
+  * valid pixels of any region can be computed with four lookups per channel, regardless of the patch size.
+  * Only the valid pixels (according to the mask) contribute to the statistics. If no mask is set,
+  * every pixel is valid.
+  * The tables take 2 * channels + 1 doubles per pixel, so they are only built by Update(), which the distance
+  * functors that compare against every patch (e.g. CachedAverageValueDifference::BatchDistance()) call. Until then,
+  * or when the image or mask (or their modified times) have changed since, the Get functions walk the region
+  * instead, with the same results. The Get functions are safe to call concurrently with each other and with
+  * Update().
+  */
+template <typename TImage>
+class PatchStatisticsCache
+{
+public:
+
+  /** The type of the per-channel statistics. */
+  typedef itk::VariableLengthVector<double> StatisticsType;
+
+  /** Constructor. */
+  PatchStatisticsCache();
+
+  /** Set the image. */
+  void SetImage(TImage* const image);
+
+  /** Set the mask (NULL means every pixel is valid). */
+  void SetMask(Mask* const mask);
+
+  /** Discard the tables (e.g. if the mask was modified in place). */
+  void Invalidate();
+
+  /** Build the tables if they are not current. This can be called from several threads at once: one of them
+    * builds the tables and the others wait. */
+  void Update();
+
+  /** True if the tables are built for the current image and mask. */
+  bool HasTables() const;
+
+  /** Get the number of valid pixels in a region. */
+  unsigned int CountValidPixels(const itk::ImageRegion<2>& region) const;
+
+  /** Get the mean of each channel over the valid pixels of a region (0 if there are none). */
+  StatisticsType GetMean(const itk::ImageRegion<2>& region) const;
+
+  /** Get the (population) variance of each channel over the valid pixels of a region (0 if there are none). */
+  StatisticsType GetVariance(const itk::ImageRegion<2>& region) const;
+
+private:
+
+  /** The cache can not be copied, because of the mutex. */
+  PatchStatisticsCache(const PatchStatisticsCache&);
+  void operator=(const PatchStatisticsCache&);
+
+  /** Build the tables. Requires UpdateMutex. */
+  void BuildTables();
+
+  /** Sum a table over a region. */
+  double RegionSum(const std::vector<double>& table, const itk::ImageRegion<2>& region) const;
+
+  /** Get the sums of the valid pixel values and squared values of each channel, and the number of valid pixels,
+    * of a region, from the tables if they are current and otherwise from the pixels. */
+  void GetRegionSums(const itk::ImageRegion<2>& region, std::vector<double>& sums, std::vector<double>& squaredSums,
+                     double& validCount) const;
+
+  /** The image. */
+  TImage* Image;
+
+  /** The mask. */
+  Mask* MaskImage;
+
+  /** The image the tables were built from. */
+  TImage* CachedImage;
+
+  /** The mask the tables were built from. */
+  Mask* CachedMask;
+
+  /** The modified time of the image when the tables were built. */
+  unsigned long CachedImageMTime;
+
+  /** The modified time of the mask when the tables were built. */
+  unsigned long CachedMaskMTime;
+
+  /** Non-zero if the tables are built for the cached image and mask. */
+  QAtomicInt TablesReady;
+
+  /** Guards the building of the tables. */
+  QMutex UpdateMutex;
+
+  /** The region of the image the tables cover. */
+  itk::ImageRegion<2> FullRegion;
+
+  /** Per channel tables of the sum of the valid pixel values. Each table has an extra row and column of zeros
+    * at the top and left. */
+  std::vector<std::vector<double> > SumTables;
+
+  /** Per channel tables of the sum of the squared valid pixel values. */
+  std::vector<std::vector<double> > SquaredSumTables;
+
+  /** Table of the number of valid pixels. */
+  std::vector<double> ValidCountTable;
+};
+
+#include "PatchStatisticsCache.hpp"
+
+#endif
@@ -0,0 +1,276 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef PatchStatisticsCache_HPP
+#define PatchStatisticsCache_HPP
+
+#include "PatchStatisticsCache.h"
+
+// ITK
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+// Qt
+#include <QMutexLocker>
+
+// STL
+#include <algorithm>
+#include <stdexcept>
+
+template <typename TImage>
+PatchStatisticsCache<TImage>::PatchStatisticsCache() : Image(NULL), MaskImage(NULL), CachedImage(NULL),
+CachedMask(NULL), CachedImageMTime(0), CachedMaskMTime(0), TablesReady(0)
+{
+}
+
+template <typename TImage>
+void PatchStatisticsCache<TImage>::SetImage(TImage* const image)
+{
+  this->Image = image;
+}
+
+template <typename TImage>
+void PatchStatisticsCache<TImage>::SetMask(Mask* const mask)
+{
+  this->MaskImage = mask;
+}
+
+template <typename TImage>
+void PatchStatisticsCache<TImage>::Invalidate()
+{
+  QMutexLocker locker(&this->UpdateMutex);
+  this->TablesReady = 0;
+  this->SumTables.clear();
+  this->SquaredSumTables.clear();
+  this->ValidCountTable.clear();
+}
+
+template <typename TImage>
+bool PatchStatisticsCache<TImage>::HasTables() const
+{
+  return this->TablesReady && this->Image && this->Image == this->CachedImage &&
+         this->Image->GetMTime() == this->CachedImageMTime && this->MaskImage == this->CachedMask &&
+         (this->MaskImage ? this->MaskImage->GetMTime() : 0) == this->CachedMaskMTime;
+}
+
+template <typename TImage>
+void PatchStatisticsCache<TImage>::Update()
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("PatchStatisticsCache: Must call SetImage() before Update()!");
+  }
+
+  if(HasTables())
+  {
+    return;
+  }
+
+  QMutexLocker locker(&this->UpdateMutex);
+  // Another thread may have built the tables while this one waited.
+  if(!HasTables())
+  {
+    BuildTables();
+  }
+}
+
+template <typename TImage>
+void PatchStatisticsCache<TImage>::BuildTables()
+{
+  this->TablesReady = 0;
+
+  this->FullRegion = this->Image->GetLargestPossibleRegion();
+  const unsigned int width = this->FullRegion.GetSize()[0];
+  const unsigned int height = this->FullRegion.GetSize()[1];
+  const unsigned int numberOfComponents = this->Image->GetNumberOfComponentsPerPixel();
+  const size_t tableSize = (width + 1) * (height + 1);
+
+  this->SumTables.assign(numberOfComponents, std::vector<double>(tableSize, 0));
+  this->SquaredSumTables.assign(numberOfComponents, std::vector<double>(tableSize, 0));
+  this->ValidCountTable.assign(tableSize, 0);
+
+  // Each table entry (row + 1, column + 1) is the entry above it plus the running sum of the current row.
+  std::vector<double> rowSums(numberOfComponents);
+  std::vector<double> rowSquaredSums(numberOfComponents);
+  double rowValidCount = 0;
+
+  itk::ImageRegionConstIteratorWithIndex<TImage> imageIterator(this->Image, this->FullRegion);
+  while(!imageIterator.IsAtEnd())
+  {
+    unsigned int column = imageIterator.GetIndex()[0] - this->FullRegion.GetIndex()[0];
+    unsigned int row = imageIterator.GetIndex()[1] - this->FullRegion.GetIndex()[1];
+    if(column == 0)
+    {
+      std::fill(rowSums.begin(), rowSums.end(), 0);
+      std::fill(rowSquaredSums.begin(), rowSquaredSums.end(), 0);
+      rowValidCount = 0;
+    }
+
+    if(!this->MaskImage || this->MaskImage->IsValid(imageIterator.GetIndex()))
+    {
+      typename TImage::PixelType pixel = imageIterator.Get();
+      for(unsigned int component = 0; component < numberOfComponents; ++component)
+      {
+        double value = pixel[component];
+        rowSums[component] += value;
+        rowSquaredSums[component] += value * value;
+      }
+      rowValidCount += 1;
+    }
+
+    size_t tableIndex = (row + 1) * (width + 1) + column + 1;
+    size_t tableIndexAbove = row * (width + 1) + column + 1;
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      this->SumTables[component][tableIndex] = this->SumTables[component][tableIndexAbove] + rowSums[component];
+      this->SquaredSumTables[component][tableIndex] = this->SquaredSumTables[component][tableIndexAbove] +
+                                                      rowSquaredSums[component];
+    }
+    this->ValidCountTable[tableIndex] = this->ValidCountTable[tableIndexAbove] + rowValidCount;
+
+    ++imageIterator;
+  }
+
+  this->CachedImage = this->Image;
+  this->CachedImageMTime = this->Image->GetMTime();
+  this->CachedMask = this->MaskImage;
+  this->CachedMaskMTime = this->MaskImage ? this->MaskImage->GetMTime() : 0;
+  this->TablesReady.fetchAndStoreOrdered(1);
+}
+
+template <typename TImage>
+double PatchStatisticsCache<TImage>::RegionSum(const std::vector<double>& table,
+                                               const itk::ImageRegion<2>& region) const
+{
+  const size_t stride = this->FullRegion.GetSize()[0] + 1;
+  const size_t left = region.GetIndex()[0] - this->FullRegion.GetIndex()[0];
+  const size_t top = region.GetIndex()[1] - this->FullRegion.GetIndex()[1];
+  const size_t right = left + region.GetSize()[0];
+  const size_t bottom = top + region.GetSize()[1];
+
+  return table[bottom * stride + right] - table[top * stride + right] -
+         table[bottom * stride + left] + table[top * stride + left];
+}
+
+template <typename TImage>
+void PatchStatisticsCache<TImage>::GetRegionSums(const itk::ImageRegion<2>& region, std::vector<double>& sums,
+                                                 std::vector<double>& squaredSums, double& validCount) const
+{
+  if(HasTables())
+  {
+    sums.resize(this->SumTables.size());
+    squaredSums.resize(this->SumTables.size());
+    for(unsigned int component = 0; component < this->SumTables.size(); ++component)
+    {
+      sums[component] = RegionSum(this->SumTables[component], region);
+      squaredSums[component] = RegionSum(this->SquaredSumTables[component], region);
+    }
+    validCount = RegionSum(this->ValidCountTable, region);
+    return;
+  }
+
+  if(!this->Image)
+  {
+    throw std::runtime_error("PatchStatisticsCache: Must call SetImage() first!");
+  }
+
+  const unsigned int numberOfComponents = this->Image->GetNumberOfComponentsPerPixel();
+  sums.assign(numberOfComponents, 0);
+  squaredSums.assign(numberOfComponents, 0);
+  validCount = 0;
+
+  itk::ImageRegionConstIteratorWithIndex<TImage> imageIterator(this->Image, region);
+  while(!imageIterator.IsAtEnd())
+  {
+    if(!this->MaskImage || this->MaskImage->IsValid(imageIterator.GetIndex()))
+    {
+      typename TImage::PixelType pixel = imageIterator.Get();
+      for(unsigned int component = 0; component < numberOfComponents; ++component)
+      {
+        double value = pixel[component];
+        sums[component] += value;
+        squaredSums[component] += value * value;
+      }
+      validCount += 1;
+    }
+    ++imageIterator;
+  }
+}
+
+template <typename TImage>
+unsigned int PatchStatisticsCache<TImage>::CountValidPixels(const itk::ImageRegion<2>& region) const
+{
+  if(HasTables())
+  {
+    return static_cast<unsigned int>(RegionSum(this->ValidCountTable, region));
+  }
+
+  return this->MaskImage ? this->MaskImage->CountValidPixels(region) : region.GetNumberOfPixels();
+}
+
+template <typename TImage>
+typename PatchStatisticsCache<TImage>::StatisticsType
+PatchStatisticsCache<TImage>::GetMean(const itk::ImageRegion<2>& region) const
+{
+  std::vector<double> sums;
+  std::vector<double> squaredSums;
+  double validCount = 0;
+  GetRegionSums(region, sums, squaredSums, validCount);
+
+  StatisticsType mean(sums.size());
+  mean.Fill(0);
+  if(validCount == 0)
+  {
+    return mean;
+  }
+
+  for(unsigned int component = 0; component < sums.size(); ++component)
+  {
+    mean[component] = sums[component] / validCount;
+  }
+
+  return mean;
+}
+
+template <typename TImage>
+typename PatchStatisticsCache<TImage>::StatisticsType
+PatchStatisticsCache<TImage>::GetVariance(const itk::ImageRegion<2>& region) const
+{
+  std::vector<double> sums;
+  std::vector<double> squaredSums;
+  double validCount = 0;
+  GetRegionSums(region, sums, squaredSums, validCount);
+
+  StatisticsType variance(sums.size());
+  variance.Fill(0);
+  if(validCount == 0)
+  {
+    return variance;
+  }
+
+  for(unsigned int component = 0; component < sums.size(); ++component)
+  {
+    double mean = sums[component] / validCount;
+    double meanOfSquares = squaredSums[component] / validCount;
+    // Round off can make a constant region very slightly negative.
+    variance[component] = std::max(meanOfSquares - mean * mean, 0.0);
+  }
+
+  return variance;
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#include "PatchThumbnailCache.h"
+
+// Qt
+#include <QColor>
+#include <QCoreApplication>
+#include <QMutexLocker>
+
+// STL
+#include <algorithm>
+
+PatchThumbnailCache::PatchThumbnailCache(const int maxCostInKilobytes, QObject* parent) :
+  QObject(parent), Thumbnails(maxCostInKilobytes), Generation(0), DeliveryScheduled(false)
+{
+}
+
+PatchThumbnailCache::~PatchThumbnailCache()
+{
+  // The workers use this object.
+  CancelPendingRequests();
+  this->Renderers.waitForDone();
+}
+
+PatchThumbnailCache* PatchThumbnailCache::GetSharedCache()
+{
+  // The application owns the cache, so it is deleted before the application (and the threads) go away.
+  static PatchThumbnailCache* sharedCache = new PatchThumbnailCache(64 * 1024, QCoreApplication::instance());
+  return sharedCache;
+}
+
+bool PatchThumbnailCache::GetCachedThumbnail(const PatchThumbnailKey& key, QPixmap& thumbnail)
+{
+  QPixmap* cachedThumbnail = this->Thumbnails.object(key);
+  if(!cachedThumbnail)
+  {
+    return false;
+  }
+
+  thumbnail = *cachedThumbnail;
+  return true;
+}
+
+void PatchThumbnailCache::CancelPendingRequests()
+{
+  this->Generation.ref();
+  this->Requested.clear();
+}
+
+void PatchThumbnailCache::WaitForRenderers()
+{
+  CancelPendingRequests();
+  this->Renderers.waitForDone();
+  slot_DeliverRenderedThumbnails();
+}
+
+void PatchThumbnailCache::RemoveImage(const void* const image)
+{
+  WaitForRenderers();
+
+  foreach(const PatchThumbnailKey& key, this->Thumbnails.keys())
+  {
+    if(key.Image == image)
+    {
+      this->Thumbnails.remove(key);
+    }
+  }
+}
+
+void PatchThumbnailCache::Clear()
+{
+  WaitForRenderers();
+  this->Thumbnails.clear();
+}
+
+QPixmap PatchThumbnailCache::GetPlaceholder(const itk::ImageRegion<2>& region, const unsigned int displaySize)
+{
+  // The same size as the thumbnail (scaledToHeight keeps the aspect ratio), so the layout does not change when
+  // the thumbnail replaces it.
+  const int width = std::max<int>(1, static_cast<int>(region.GetSize()[0] * displaySize / region.GetSize()[1]));
+  QPixmap placeholder(width, displaySize);
+  placeholder.fill(Qt::lightGray);
+  return placeholder;
+}
+
+void PatchThumbnailCache::slot_DeliverRenderedThumbnails()
+{
+  std::vector<std::pair<PatchThumbnailKey, QImage> > rendered;
+  {
+    QMutexLocker locker(&this->RenderedMutex);
+    rendered.swap(this->Rendered);
+    this->DeliveryScheduled = false;
+  }
+
+  if(rendered.empty())
+  {
+    return;
+  }
+
+  for(size_t thumbnailId = 0; thumbnailId < rendered.size(); ++thumbnailId)
+  {
+    QPixmap* thumbnail = new QPixmap(QPixmap::fromImage(rendered[thumbnailId].second));
+    this->Thumbnails.insert(rendered[thumbnailId].first, thumbnail, GetCost(*thumbnail));
+    this->Requested.remove(rendered[thumbnailId].first);
+  }
+
+  emit signal_ThumbnailsReady();
+}
+
+void PatchThumbnailCache::AddRenderedThumbnail(const PatchThumbnailKey& key, const QImage& thumbnail)
+{
+  QMutexLocker locker(&this->RenderedMutex);
+  this->Rendered.push_back(std::make_pair(key, thumbnail));
+  ScheduleDelivery();
+}
+
+int PatchThumbnailCache::GetCost(const QPixmap& thumbnail)
+{
+  return std::max(1, thumbnail.width() * thumbnail.height() * 4 / 1024);
+}
+
+void PatchThumbnailCache::ScheduleDelivery()
+{
+  // One delivery takes all of the thumbnails rendered until it runs, so the views repaint once per batch.
+  if(!this->DeliveryScheduled)
+  {
+    this->DeliveryScheduled = true;
+    QMetaObject::invokeMethod(this, "slot_DeliverRenderedThumbnails", Qt::QueuedConnection);
+  }
+}
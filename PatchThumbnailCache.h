@@ -0,0 +1,182 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PatchThumbnailCache_H
+#define PatchThumbnailCache_H
+
+// Qt
+#include <QAtomicInt>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QPixmap>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <utility>
+#include <vector>
+
+/** Identifies a thumbnail: a region of an image (at a particular modification time, so a modified image does not
+  * reuse stale thumbnails), drawn at a particular height. */
+struct PatchThumbnailKey
+{
+  /** The image the region is in. */
+  const void* Image;
+
+  /** The MTime of the image when the thumbnail was rendered. */
+  unsigned long ImageMTime;
+
+  /** The region of the patch. */
+  itk::ImageRegion<2> Region;
+
+  /** The height of the thumbnail. */
+  unsigned int DisplaySize;
+
+  bool operator==(const PatchThumbnailKey& other) const
+  {
+    return this->Image == other.Image && this->ImageMTime == other.ImageMTime &&
+           this->Region == other.Region && this->DisplaySize == other.DisplaySize;
+  }
+};
+
+inline uint qHash(const PatchThumbnailKey& key)
+{
+  return qHash(key.Image) ^ (qHash(static_cast<qlonglong>(key.Region.GetIndex()[0])) * 31) ^
+         (qHash(static_cast<qlonglong>(key.Region.GetIndex()[1])) * 1031) ^
+         (qHash(static_cast<qulonglong>(key.Region.GetSize()[0])) * 7919) ^
+         (key.DisplaySize * 104729) ^ static_cast<uint>(key.ImageMTime);
+}
+
+/** A bounded, least recently used cache of patch thumbnails (the scaled pixmaps the tables display), with a pool
+  * of worker threads that renders the thumbnails that are not cached yet. A table model asks for a thumbnail with
+  * GetCachedThumbnail, and if it is not there requests it with RequestThumbnail and draws a placeholder; once a
+  * batch of requested thumbnails is ready, signal_ThumbnailsReady is emitted so the views can repaint.
+  * The cache is not tied to one image or one model, so models showing the same image can share it.
+  * The workers read the image, so it must not be modified or deleted while they run (see WaitForRenderers).
+  * All of the functions must be called from the GUI thread.
+  */
+class PatchThumbnailCache : public QObject
+{
+Q_OBJECT
+
+public:
+
+  /** Constructor. 'maxCostInKilobytes' bounds the memory of the cached pixmaps. */
+  PatchThumbnailCache(const int maxCostInKilobytes = 64 * 1024, QObject* parent = NULL);
+
+  /** Destructor. Waits for the workers. */
+  ~PatchThumbnailCache();
+
+  /** The cache shared by the tables of the application. */
+  static PatchThumbnailCache* GetSharedCache();
+
+  /** Create the key of a thumbnail. */
+  template <typename TImage>
+  static PatchThumbnailKey CreateKey(const TImage* const image, const itk::ImageRegion<2>& region,
+                                     const unsigned int displaySize);
+
+  /** Render a thumbnail, in the calling thread. This is safe to call from any thread. */
+  template <typename TImage>
+  static QImage RenderThumbnail(TImage* const image, const itk::ImageRegion<2>& region,
+                                const unsigned int displaySize);
+
+  /** Get a cached thumbnail (which then becomes the most recently used). Returns false if it is not cached. */
+  bool GetCachedThumbnail(const PatchThumbnailKey& key, QPixmap& thumbnail);
+
+  /** Get a thumbnail, rendering it in the GUI thread and caching it if it is not cached yet. */
+  template <typename TImage>
+  QPixmap GetThumbnail(TImage* const image, const itk::ImageRegion<2>& region, const unsigned int displaySize);
+
+  /** Render a thumbnail with the workers, unless it is cached or already requested. */
+  template <typename TImage>
+  void RequestThumbnail(TImage* const image, const itk::ImageRegion<2>& region, const unsigned int displaySize);
+
+  /** Drop the requests that the workers have not started, e.g. because the rows they were for were scrolled out of
+    * view. The thumbnails already rendered are kept. */
+  void CancelPendingRequests();
+
+  /** Cancel the pending requests and wait for the workers to finish the ones they have started. */
+  void WaitForRenderers();
+
+  /** Remove all of the thumbnails of an image (e.g. before it is modified or deleted). This waits for the workers. */
+  void RemoveImage(const void* const image);
+
+  /** Remove all of the thumbnails. This waits for the workers. */
+  void Clear();
+
+  /** A gray placeholder the size of a thumbnail, to draw until the thumbnail is ready. */
+  static QPixmap GetPlaceholder(const itk::ImageRegion<2>& region, const unsigned int displaySize);
+
+signals:
+
+  /** Emitted (at most once per event loop iteration) when requested thumbnails have been added to the cache. */
+  void signal_ThumbnailsReady();
+
+private slots:
+
+  /** Move the thumbnails the workers rendered into the cache. */
+  void slot_DeliverRenderedThumbnails();
+
+private:
+
+  Q_DISABLE_COPY(PatchThumbnailCache)
+
+  template <typename TImage>
+  class RenderTask;
+
+  /** Called by the workers when a thumbnail is rendered. Thread safe. */
+  void AddRenderedThumbnail(const PatchThumbnailKey& key, const QImage& thumbnail);
+
+  /** The cost of a thumbnail in the cache, its size in kilobytes. */
+  static int GetCost(const QPixmap& thumbnail);
+
+  /** Queue the delivery of the rendered thumbnails, if it is not already queued. Requires RenderedMutex. */
+  void ScheduleDelivery();
+
+  /** The cached thumbnails. The cost of each is its size in kilobytes. */
+  QCache<PatchThumbnailKey, QPixmap> Thumbnails;
+
+  /** The thumbnails that have been requested (and not canceled) but are not cached yet. */
+  QSet<PatchThumbnailKey> Requested;
+
+  /** The workers. This is not the global pool, so the rendering does not compete with the QtConcurrent matching. */
+  QThreadPool Renderers;
+
+  /** Incremented by CancelPendingRequests. A worker skips its request if this changed since it was queued. */
+  QAtomicInt Generation;
+
+  /** The thumbnails the workers rendered, which have not been moved into the cache yet (QPixmaps can only be
+    * created in the GUI thread). */
+  QMutex RenderedMutex;
+  std::vector<std::pair<PatchThumbnailKey, QImage> > Rendered;
+
+  /** True if slot_DeliverRenderedThumbnails is queued. Requires RenderedMutex. */
+  bool DeliveryScheduled;
+};
+
+#include "PatchThumbnailCache.hpp"
+
+#endif
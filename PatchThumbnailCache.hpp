@@ -0,0 +1,108 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PatchThumbnailCache_HPP
+#define PatchThumbnailCache_HPP
+
+#include "PatchThumbnailCache.h" // Appease syntax parser
+
+// Submodules
+#include "ITKQtHelpers/ITKQtHelpers.h"
+
+/** Renders one requested thumbnail in a worker thread. */
+template <typename TImage>
+class PatchThumbnailCache::RenderTask : public QRunnable
+{
+public:
+  RenderTask(PatchThumbnailCache* const cache, TImage* const image, const PatchThumbnailKey& key,
+             const int generation) :
+    Cache(cache), Image(image), Key(key), Generation(generation)
+  {
+  }
+
+  void run()
+  {
+    // The request was canceled while it was queued.
+    if(this->Cache->Generation != this->Generation)
+    {
+      return;
+    }
+
+    this->Cache->AddRenderedThumbnail(this->Key,
+                                      RenderThumbnail(this->Image, this->Key.Region, this->Key.DisplaySize));
+  }
+
+private:
+  PatchThumbnailCache* Cache;
+  TImage* Image;
+  PatchThumbnailKey Key;
+  int Generation;
+};
+
+template <typename TImage>
+PatchThumbnailKey PatchThumbnailCache::CreateKey(const TImage* const image, const itk::ImageRegion<2>& region,
+                                                 const unsigned int displaySize)
+{
+  PatchThumbnailKey key;
+  key.Image = image;
+  key.ImageMTime = image->GetMTime();
+  key.Region = region;
+  key.DisplaySize = displaySize;
+  return key;
+}
+
+template <typename TImage>
+QImage PatchThumbnailCache::RenderThumbnail(TImage* const image, const itk::ImageRegion<2>& region,
+                                            const unsigned int displaySize)
+{
+  QImage patchImage = ITKQtHelpers::GetQImageColor(image, region);
+  return patchImage.scaledToHeight(displaySize);
+}
+
+template <typename TImage>
+QPixmap PatchThumbnailCache::GetThumbnail(TImage* const image, const itk::ImageRegion<2>& region,
+                                          const unsigned int displaySize)
+{
+  PatchThumbnailKey key = CreateKey(image, region, displaySize);
+
+  QPixmap thumbnail;
+  if(!GetCachedThumbnail(key, thumbnail))
+  {
+    thumbnail = QPixmap::fromImage(RenderThumbnail(image, region, displaySize));
+    this->Thumbnails.insert(key, new QPixmap(thumbnail), GetCost(thumbnail));
+  }
+
+  return thumbnail;
+}
+
+template <typename TImage>
+void PatchThumbnailCache::RequestThumbnail(TImage* const image, const itk::ImageRegion<2>& region,
+                                           const unsigned int displaySize)
+{
+  PatchThumbnailKey key = CreateKey(image, region, displaySize);
+  if(this->Thumbnails.contains(key) || this->Requested.contains(key))
+  {
+    return;
+  }
+
+  this->Requested.insert(key);
+  this->Renderers.start(new RenderTask<TImage>(this, image, key, this->Generation));
+}
+
+#endif
@@ -61,6 +61,13 @@ void PixmapDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option
 
 QSize PixmapDelegate::sizeHint(const QStyleOptionViewItem & option, const QModelIndex & index ) const
 {
+  // Models that know the size of their cells report it without rendering the pixmap.
+  QVariant sizeHint = index.data(Qt::SizeHintRole);
+  if(sizeHint.isValid())
+  {
+    return sizeHint.toSize();
+  }
+
   QPixmap pixmap = index.data(Qt::DisplayRole).value<QPixmap>();
   return pixmap.size();
 }
@@ -34,6 +34,7 @@ public:
 
   void SetPadding(const unsigned int padding);
 
+  /** The Qt::SizeHintRole of the index if the model provides one, otherwise the size of its pixmap. */
   QSize sizeHint(const QStyleOptionViewItem & option, const QModelIndex & index ) const ;
   
 private:
@@ -0,0 +1,223 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ProjectedPatchIndex_H
+#define ProjectedPatchIndex_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// Eigen
+#include <Eigen/Dense>
+
+// STL
+#include <utility>
+#include <vector>
+
+// Submodules
+#include "PatchComparison/Mask/Mask.h"
+#include "PatchComparison/PatchDistance.h"
+#include "PatchComparison/SelfPatchCompare.h"
+
+// Custom
+#include "TopPatchCollector.h"
+
+/** An index of every patch of an image projected onto its first few principal components (the same
+  * kind of projection ProjectedDistance and LocalPCADistance use), stored in a KD-tree.
+  * A query projects the target patch, finds the nearest source patches in the projected space, and then
+  * re-ranks those candidates with the real PatchDistance functor, so only a small fraction of the patches
+  * are compared in pixel space.
+  * The principal components are learned from a regular sample of the valid patches. Every patch of the image is
+  * projected (on all cores) so that the projections and the tree only depend on the image: when only the
+  * mask changes, Update() just re-checks which patches are valid, with a summed area table of the mask holes.
+  * The results are approximate: a patch that is close in pixel space but far in the projected space is missed.
+  */
+template <typename TImage>
+class ProjectedPatchIndex
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SelfPatchCompare<TImage>::PatchDataType PatchDataType;
+
+  /** Constructor. */
+  ProjectedPatchIndex();
+
+  /** Set the image to index. */
+  void SetImage(TImage* const image);
+
+  /** Set the mask. Only source patches that are entirely valid are returned. If no mask is set, every patch is valid. */
+  void SetMask(Mask* const mask);
+
+  /** Set the size of the indexed patches. */
+  void SetPatchSize(const itk::Size<2>& patchSize);
+
+  /** Set the number of principal components to project onto. */
+  void SetNumberOfDimensions(const unsigned int numberOfDimensions);
+
+  /** Set the (maximum) number of patches used to compute the principal components. */
+  void SetNumberOfTrainingPatches(const unsigned int numberOfTrainingPatches);
+
+  /** Set how many candidates per requested patch are found in the projected space and re-ranked. */
+  void SetCandidateMultiplier(const unsigned int candidateMultiplier);
+
+  /** Set the functor used to re-rank the candidates. */
+  void SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor);
+
+  /** Rebuild the index if the image, its modified time, the patch size, or the number of dimensions changed, and
+    * re-check the valid patches if the mask or its modified time changed. */
+  void Update();
+
+  /** Get the (approximately) best 'numberOfPatches' valid source patches of a target region, best first.
+    * Update() must have been called since the inputs last changed. */
+  std::vector<PatchDataType> FindNearestPatches(const itk::ImageRegion<2>& targetRegion,
+                                                const unsigned int numberOfPatches) const;
+
+  /** Get the number of valid source patches in the index. */
+  unsigned int GetNumberOfValidPatches() const;
+
+private:
+
+  /** A (patch id, squared projected distance) pair, in the form TopPatchCollector expects. */
+  typedef std::pair<unsigned int, float> NeighborType;
+
+  /** A node of the KD-tree. Its points are PointIds[Begin, End). */
+  struct Node
+  {
+    unsigned int Begin;
+    unsigned int End;
+
+    /** The children, or 0 if this is a leaf (the root is never a child). */
+    unsigned int Left;
+    unsigned int Right;
+
+    unsigned int SplitDimension;
+    float SplitValue;
+  };
+
+  /** A block of rows of patch corners to project. */
+  struct ProjectionTile
+  {
+    unsigned int FirstRow;
+    unsigned int EndRow;
+  };
+
+  /** The function object handed to QtConcurrent. It projects the patches of one tile. */
+  struct TileProjector
+  {
+    typedef void result_type;
+
+    TileProjector(ProjectedPatchIndex* const owner) : Owner(owner){}
+
+    void operator()(const ProjectionTile& tile) const
+    {
+      this->Owner->ProjectTile(tile);
+    }
+
+    ProjectedPatchIndex* Owner;
+  };
+
+  /** Compute the principal components, project every patch, and build the tree. */
+  void BuildIndex();
+
+  /** Re-check which patches are entirely valid. */
+  void UpdateValidPatches();
+
+  /** Get the pixels of a patch as a vector. */
+  Eigen::VectorXf GetPatchVector(const itk::ImageRegion<2>& region) const;
+
+  /** Project the patches with their corners in a block of rows. */
+  void ProjectTile(const ProjectionTile& tile);
+
+  /** Build the subtree of the points PointIds[begin, end) and return its node id. */
+  unsigned int BuildNode(const unsigned int begin, const unsigned int end);
+
+  /** Add the nearest valid points of a subtree to 'neighbors'. */
+  void SearchNode(const unsigned int nodeId, const float* const query,
+                  TopPatchCollector<NeighborType>& neighbors) const;
+
+  /** Get the region of the patch with the given id. */
+  itk::ImageRegion<2> GetPatchRegion(const unsigned int patchId) const;
+
+  /** The image to index. */
+  TImage* Image;
+
+  /** The mask indicating which pixels can be used in source patches. */
+  Mask* MaskImage;
+
+  /** The functor used to re-rank the candidates. */
+  PatchDistance<TImage>* PatchDistanceFunctor;
+
+  /** The size of the indexed patches. */
+  itk::Size<2> PatchSize;
+
+  /** The number of principal components to project onto. */
+  unsigned int NumberOfDimensions;
+
+  /** The maximum number of patches used to compute the principal components. */
+  unsigned int NumberOfTrainingPatches;
+
+  /** The number of candidates per requested patch. */
+  unsigned int CandidateMultiplier;
+
+  /** The image the index was built from. */
+  TImage* CachedImage;
+
+  /** The modified time of the image when the index was built. */
+  unsigned long CachedImageMTime;
+
+  /** The patch size the index was built for. */
+  itk::Size<2> CachedPatchSize;
+
+  /** The number of dimensions the index was built with. */
+  unsigned int CachedNumberOfDimensions;
+
+  /** The mask the valid patches were computed from. */
+  Mask* CachedMask;
+
+  /** The modified time of the mask when the valid patches were computed. */
+  unsigned long CachedMaskMTime;
+
+  /** The corners of the indexed patches. A patch id is the position of its corner in the raster scan of this region. */
+  itk::ImageRegion<2> CornerRegion;
+
+  /** The mean patch vector. */
+  Eigen::VectorXf MeanPatch;
+
+  /** The principal components (one per column). */
+  Eigen::MatrixXf Basis;
+
+  /** The projection of every patch (NumberOfDimensions values per patch). */
+  std::vector<float> Projections;
+
+  /** True for each patch that is entirely valid. */
+  std::vector<bool> ValidPatches;
+
+  /** The number of entirely valid patches. */
+  unsigned int NumberOfValidPatches;
+
+  /** The patch ids, ordered so that the points of every node are contiguous. */
+  std::vector<unsigned int> PointIds;
+
+  /** The nodes of the tree. Node 0 is the root. */
+  std::vector<Node> Nodes;
+};
+
+#include "ProjectedPatchIndex.hpp"
+
+#endif
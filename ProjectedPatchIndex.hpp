@@ -0,0 +1,425 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef ProjectedPatchIndex_HPP
+#define ProjectedPatchIndex_HPP
+
+#include "ProjectedPatchIndex.h"
+
+// ITK
+#include "itkImageRegionConstIterator.h"
+
+// Qt
+#include <QThread>
+#include <QtConcurrentMap>
+
+// STL
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+template <typename TImage>
+ProjectedPatchIndex<TImage>::ProjectedPatchIndex() : Image(NULL), MaskImage(NULL), PatchDistanceFunctor(NULL),
+NumberOfDimensions(10), NumberOfTrainingPatches(5000), CandidateMultiplier(4), CachedImage(NULL), CachedImageMTime(0),
+CachedNumberOfDimensions(0), CachedMask(NULL), CachedMaskMTime(0), NumberOfValidPatches(0)
+{
+  this->PatchSize.Fill(0);
+  this->CachedPatchSize.Fill(0);
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::SetImage(TImage* const image)
+{
+  this->Image = image;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::SetMask(Mask* const mask)
+{
+  this->MaskImage = mask;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::SetPatchSize(const itk::Size<2>& patchSize)
+{
+  this->PatchSize = patchSize;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::SetNumberOfDimensions(const unsigned int numberOfDimensions)
+{
+  this->NumberOfDimensions = numberOfDimensions;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::SetNumberOfTrainingPatches(const unsigned int numberOfTrainingPatches)
+{
+  this->NumberOfTrainingPatches = numberOfTrainingPatches;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::SetCandidateMultiplier(const unsigned int candidateMultiplier)
+{
+  this->CandidateMultiplier = candidateMultiplier;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor)
+{
+  this->PatchDistanceFunctor = patchDistanceFunctor;
+}
+
+template <typename TImage>
+unsigned int ProjectedPatchIndex<TImage>::GetNumberOfValidPatches() const
+{
+  return this->NumberOfValidPatches;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::Update()
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("ProjectedPatchIndex: Must call SetImage() before Update()!");
+  }
+
+  if(this->Image != this->CachedImage || this->Image->GetMTime() != this->CachedImageMTime ||
+     this->PatchSize != this->CachedPatchSize || this->NumberOfDimensions != this->CachedNumberOfDimensions)
+  {
+    BuildIndex();
+    return;
+  }
+
+  unsigned long maskMTime = this->MaskImage ? this->MaskImage->GetMTime() : 0;
+  if(this->MaskImage != this->CachedMask || maskMTime != this->CachedMaskMTime)
+  {
+    UpdateValidPatches();
+  }
+}
+
+template <typename TImage>
+itk::ImageRegion<2> ProjectedPatchIndex<TImage>::GetPatchRegion(const unsigned int patchId) const
+{
+  const unsigned int numberOfColumns = this->CornerRegion.GetSize()[0];
+  itk::Index<2> corner = {{this->CornerRegion.GetIndex()[0] + static_cast<itk::IndexValueType>(patchId % numberOfColumns),
+                           this->CornerRegion.GetIndex()[1] + static_cast<itk::IndexValueType>(patchId / numberOfColumns)}};
+  return itk::ImageRegion<2>(corner, this->PatchSize);
+}
+
+template <typename TImage>
+Eigen::VectorXf ProjectedPatchIndex<TImage>::GetPatchVector(const itk::ImageRegion<2>& region) const
+{
+  const unsigned int numberOfComponents = this->Image->GetNumberOfComponentsPerPixel();
+  Eigen::VectorXf patchVector(region.GetNumberOfPixels() * numberOfComponents);
+
+  unsigned int element = 0;
+  itk::ImageRegionConstIterator<TImage> imageIterator(this->Image, region);
+  while(!imageIterator.IsAtEnd())
+  {
+    typename TImage::PixelType pixel = imageIterator.Get();
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      patchVector[element++] = pixel[component];
+    }
+    ++imageIterator;
+  }
+
+  return patchVector;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::UpdateValidPatches()
+{
+  const unsigned int numberOfPatches = this->CornerRegion.GetNumberOfPixels();
+  this->ValidPatches.assign(numberOfPatches, true);
+  this->NumberOfValidPatches = numberOfPatches;
+
+  if(this->MaskImage)
+  {
+    // A summed area table of the hole pixels makes the test of each patch four lookups.
+    itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+    const unsigned int width = fullRegion.GetSize()[0];
+    const unsigned int height = fullRegion.GetSize()[1];
+    std::vector<unsigned int> holeTable((width + 1) * (height + 1), 0);
+    for(unsigned int row = 0; row < height; ++row)
+    {
+      unsigned int rowHoles = 0;
+      for(unsigned int column = 0; column < width; ++column)
+      {
+        itk::Index<2> pixel = {{fullRegion.GetIndex()[0] + column, fullRegion.GetIndex()[1] + row}};
+        rowHoles += this->MaskImage->IsValid(pixel) ? 0 : 1;
+        holeTable[(row + 1) * (width + 1) + column + 1] = holeTable[row * (width + 1) + column + 1] + rowHoles;
+      }
+    }
+
+    this->NumberOfValidPatches = 0;
+    for(unsigned int patchId = 0; patchId < numberOfPatches; ++patchId)
+    {
+      size_t left = patchId % this->CornerRegion.GetSize()[0];
+      size_t top = patchId / this->CornerRegion.GetSize()[0];
+      size_t right = left + this->PatchSize[0];
+      size_t bottom = top + this->PatchSize[1];
+      unsigned int holes = holeTable[bottom * (width + 1) + right] - holeTable[top * (width + 1) + right] -
+                           holeTable[bottom * (width + 1) + left] + holeTable[top * (width + 1) + left];
+      this->ValidPatches[patchId] = (holes == 0);
+      this->NumberOfValidPatches += (holes == 0) ? 1 : 0;
+    }
+  }
+
+  this->CachedMask = this->MaskImage;
+  this->CachedMaskMTime = this->MaskImage ? this->MaskImage->GetMTime() : 0;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::ProjectTile(const ProjectionTile& tile)
+{
+  const unsigned int numberOfColumns = this->CornerRegion.GetSize()[0];
+  for(unsigned int row = tile.FirstRow; row < tile.EndRow; ++row)
+  {
+    for(unsigned int column = 0; column < numberOfColumns; ++column)
+    {
+      unsigned int patchId = row * numberOfColumns + column;
+      Eigen::VectorXf projection = this->Basis.transpose() * (GetPatchVector(GetPatchRegion(patchId)) - this->MeanPatch);
+      std::copy(projection.data(), projection.data() + this->NumberOfDimensions,
+                this->Projections.begin() + static_cast<size_t>(patchId) * this->NumberOfDimensions);
+    }
+  }
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::BuildIndex()
+{
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+  if(this->PatchSize[0] == 0 || this->PatchSize[1] == 0 ||
+     this->PatchSize[0] > fullRegion.GetSize()[0] || this->PatchSize[1] > fullRegion.GetSize()[1])
+  {
+    throw std::runtime_error("ProjectedPatchIndex: The patch size must be positive and fit in the image!");
+  }
+
+  itk::Size<2> cornerSize = {{fullRegion.GetSize()[0] - this->PatchSize[0] + 1,
+                              fullRegion.GetSize()[1] - this->PatchSize[1] + 1}};
+  this->CornerRegion = itk::ImageRegion<2>(fullRegion.GetIndex(), cornerSize);
+  UpdateValidPatches();
+
+  if(this->NumberOfValidPatches == 0)
+  {
+    throw std::runtime_error("ProjectedPatchIndex: There are no valid patches to learn the projection from!");
+  }
+
+  // Learn the principal components from an evenly spaced sample of the valid patches.
+  const unsigned int numberOfPatches = this->CornerRegion.GetNumberOfPixels();
+  const unsigned int sampleStep = std::max(this->NumberOfValidPatches / std::max(this->NumberOfTrainingPatches, 1u), 1u);
+  std::vector<Eigen::VectorXf> trainingPatches;
+  unsigned int validPatchCounter = 0;
+  for(unsigned int patchId = 0; patchId < numberOfPatches; ++patchId)
+  {
+    if(this->ValidPatches[patchId] && (validPatchCounter++ % sampleStep) == 0)
+    {
+      trainingPatches.push_back(GetPatchVector(GetPatchRegion(patchId)));
+    }
+  }
+
+  const unsigned int patchVectorLength = trainingPatches[0].size();
+  this->MeanPatch = Eigen::VectorXf::Zero(patchVectorLength);
+  for(size_t trainingId = 0; trainingId < trainingPatches.size(); ++trainingId)
+  {
+    this->MeanPatch += trainingPatches[trainingId];
+  }
+  this->MeanPatch /= static_cast<float>(trainingPatches.size());
+
+  Eigen::MatrixXf covariance = Eigen::MatrixXf::Zero(patchVectorLength, patchVectorLength);
+  for(size_t trainingId = 0; trainingId < trainingPatches.size(); ++trainingId)
+  {
+    Eigen::VectorXf centered = trainingPatches[trainingId] - this->MeanPatch;
+    covariance.selfadjointView<Eigen::Lower>().rankUpdate(centered);
+  }
+  covariance = covariance.selfadjointView<Eigen::Lower>();
+
+  // The eigenvalues are in increasing order, so the principal components are the last columns.
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> eigenSolver(covariance);
+  this->NumberOfDimensions = std::max(std::min(this->NumberOfDimensions, patchVectorLength), 1u);
+  this->Basis = eigenSolver.eigenvectors().rightCols(this->NumberOfDimensions);
+
+  // Project every patch (valid or not, so mask changes do not require projecting again).
+  this->Projections.assign(static_cast<size_t>(numberOfPatches) * this->NumberOfDimensions, 0);
+  const unsigned int tilesPerThread = 8;
+  unsigned int rowsPerTile = std::max<unsigned int>(cornerSize[1] / (tilesPerThread * std::max(QThread::idealThreadCount(), 1)), 1);
+  std::vector<ProjectionTile> tiles;
+  for(unsigned int row = 0; row < cornerSize[1]; row += rowsPerTile)
+  {
+    ProjectionTile tile;
+    tile.FirstRow = row;
+    tile.EndRow = std::min<unsigned int>(row + rowsPerTile, cornerSize[1]);
+    tiles.push_back(tile);
+  }
+  QtConcurrent::blockingMap(tiles, TileProjector(this));
+
+  this->PointIds.resize(numberOfPatches);
+  for(unsigned int patchId = 0; patchId < numberOfPatches; ++patchId)
+  {
+    this->PointIds[patchId] = patchId;
+  }
+  this->Nodes.clear();
+  BuildNode(0, numberOfPatches);
+
+  this->CachedImage = this->Image;
+  this->CachedImageMTime = this->Image->GetMTime();
+  this->CachedPatchSize = this->PatchSize;
+  this->CachedNumberOfDimensions = this->NumberOfDimensions;
+}
+
+template <typename TImage>
+unsigned int ProjectedPatchIndex<TImage>::BuildNode(const unsigned int begin, const unsigned int end)
+{
+  const unsigned int maximumLeafSize = 16;
+
+  unsigned int nodeId = this->Nodes.size();
+  Node node;
+  node.Begin = begin;
+  node.End = end;
+  node.Left = 0;
+  node.Right = 0;
+  node.SplitDimension = 0;
+  node.SplitValue = 0;
+  this->Nodes.push_back(node);
+
+  if(end - begin <= maximumLeafSize)
+  {
+    return nodeId;
+  }
+
+  // Split the dimension with the largest spread at the median.
+  std::vector<float> minimum(this->NumberOfDimensions, std::numeric_limits<float>::max());
+  std::vector<float> maximum(this->NumberOfDimensions, -std::numeric_limits<float>::max());
+  for(unsigned int pointId = begin; pointId < end; ++pointId)
+  {
+    const float* point = &this->Projections[static_cast<size_t>(this->PointIds[pointId]) * this->NumberOfDimensions];
+    for(unsigned int dimension = 0; dimension < this->NumberOfDimensions; ++dimension)
+    {
+      minimum[dimension] = std::min(minimum[dimension], point[dimension]);
+      maximum[dimension] = std::max(maximum[dimension], point[dimension]);
+    }
+  }
+
+  unsigned int splitDimension = 0;
+  for(unsigned int dimension = 1; dimension < this->NumberOfDimensions; ++dimension)
+  {
+    if(maximum[dimension] - minimum[dimension] > maximum[splitDimension] - minimum[splitDimension])
+    {
+      splitDimension = dimension;
+    }
+  }
+
+  const unsigned int middle = begin + (end - begin) / 2;
+  const std::vector<float>& projections = this->Projections;
+  const unsigned int numberOfDimensions = this->NumberOfDimensions;
+  std::nth_element(this->PointIds.begin() + begin, this->PointIds.begin() + middle, this->PointIds.begin() + end,
+                   [&projections, numberOfDimensions, splitDimension](const unsigned int a, const unsigned int b)
+                   {
+                     return projections[static_cast<size_t>(a) * numberOfDimensions + splitDimension] <
+                            projections[static_cast<size_t>(b) * numberOfDimensions + splitDimension];
+                   });
+
+  // The children are built before the node is modified, since building them can reallocate Nodes.
+  float splitValue = this->Projections[static_cast<size_t>(this->PointIds[middle]) * this->NumberOfDimensions + splitDimension];
+  unsigned int left = BuildNode(begin, middle);
+  unsigned int right = BuildNode(middle, end);
+
+  this->Nodes[nodeId].SplitDimension = splitDimension;
+  this->Nodes[nodeId].SplitValue = splitValue;
+  this->Nodes[nodeId].Left = left;
+  this->Nodes[nodeId].Right = right;
+
+  return nodeId;
+}
+
+template <typename TImage>
+void ProjectedPatchIndex<TImage>::SearchNode(const unsigned int nodeId, const float* const query,
+                                             TopPatchCollector<NeighborType>& neighbors) const
+{
+  const Node& node = this->Nodes[nodeId];
+
+  if(node.Left == 0)
+  {
+    for(unsigned int pointId = node.Begin; pointId < node.End; ++pointId)
+    {
+      unsigned int patchId = this->PointIds[pointId];
+      if(!this->ValidPatches[patchId])
+      {
+        continue;
+      }
+
+      const float* point = &this->Projections[static_cast<size_t>(patchId) * this->NumberOfDimensions];
+      float squaredDistance = 0;
+      for(unsigned int dimension = 0; dimension < this->NumberOfDimensions; ++dimension)
+      {
+        float difference = point[dimension] - query[dimension];
+        squaredDistance += difference * difference;
+      }
+      neighbors.Add(NeighborType(patchId, squaredDistance), patchId);
+    }
+    return;
+  }
+
+  // Search the side of the split the query is on first, and the other side only if it can hold a closer point.
+  float splitDifference = query[node.SplitDimension] - node.SplitValue;
+  unsigned int nearChild = (splitDifference < 0) ? node.Left : node.Right;
+  unsigned int farChild = (splitDifference < 0) ? node.Right : node.Left;
+
+  SearchNode(nearChild, query, neighbors);
+  if(splitDifference * splitDifference <= neighbors.GetAdmissionThreshold())
+  {
+    SearchNode(farChild, query, neighbors);
+  }
+}
+
+template <typename TImage>
+std::vector<typename ProjectedPatchIndex<TImage>::PatchDataType>
+ProjectedPatchIndex<TImage>::FindNearestPatches(const itk::ImageRegion<2>& targetRegion,
+                                                const unsigned int numberOfPatches) const
+{
+  if(!this->PatchDistanceFunctor)
+  {
+    throw std::runtime_error("ProjectedPatchIndex: Must call SetPatchDistanceFunctor() before FindNearestPatches()!");
+  }
+
+  if(this->Nodes.empty() || targetRegion.GetSize() != this->CachedPatchSize)
+  {
+    throw std::runtime_error("ProjectedPatchIndex: The index has not been built for patches of this size!");
+  }
+
+  Eigen::VectorXf query = this->Basis.transpose() * (GetPatchVector(targetRegion) - this->MeanPatch);
+
+  unsigned int numberOfCandidates = std::max(numberOfPatches * this->CandidateMultiplier, numberOfPatches + 16);
+  TopPatchCollector<NeighborType> candidates(numberOfCandidates);
+  SearchNode(0, query.data(), candidates);
+
+  // Re-rank the candidates exactly, breaking ties by raster order as the exhaustive search does.
+  std::vector<NeighborType> candidatePatches = candidates.GetSortedPatchData();
+  TopPatchCollector<PatchDataType> topPatches(numberOfPatches);
+  for(size_t candidateId = 0; candidateId < candidatePatches.size(); ++candidateId)
+  {
+    itk::ImageRegion<2> sourceRegion = GetPatchRegion(candidatePatches[candidateId].first);
+    float distance = this->PatchDistanceFunctor->Distance(sourceRegion, targetRegion);
+    topPatches.Add(PatchDataType(sourceRegion, distance), candidatePatches[candidateId].first);
+  }
+
+  return topPatches.GetSortedPatchData();
+}
+
+#endif
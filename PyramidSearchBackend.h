@@ -0,0 +1,66 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PyramidSearchBackend_H
+#define PyramidSearchBackend_H
+
+// Custom
+#include "PyramidSelfPatchCompare.h"
+#include "SearchBackend.h"
+
+/** The PYRAMID backend of ParallelSelfPatchCompare. A coarse to fine search is done with PyramidSelfPatchCompare,
+  * whose image pyramid is kept between queries. The coarse levels rank the patches by the SSD of the image, so only
+  * SSD functors are supported.
+  */
+template <typename TImage>
+class PyramidSearchBackend : public SearchBackend<TImage>
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SearchBackend<TImage>::PatchDataType PatchDataType;
+
+  /** Everything about one query. */
+  typedef typename SearchBackend<TImage>::Query Query;
+
+  /** Set the number of levels above full resolution. */
+  void SetNumberOfLevels(const unsigned int numberOfLevels);
+
+  /** True if the functor is an SSD functor. */
+  bool SupportsPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor) const;
+
+  /** True if the functor is supported, a bounded number of patches is kept, and the patches are large enough to
+    * downsample. This builds the pyramid if needed. */
+  bool CanComputePatchScores(const Query& query, std::string& reason);
+
+  /** Search from the coarsest usable level down to full resolution. */
+  std::vector<PatchDataType> ComputePatchScores(const Query& query);
+
+  /** Set a flag that is checked between the levels and between the rows of each level. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+private:
+
+  /** The coarse to fine search, which keeps the pyramid. */
+  PyramidSelfPatchCompare<TImage> PyramidSearch;
+};
+
+#include "PyramidSearchBackend.hpp"
+
+#endif
@@ -0,0 +1,79 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef PyramidSearchBackend_HPP
+#define PyramidSearchBackend_HPP
+
+#include "PyramidSearchBackend.h"
+
+// Submodules
+#include "PatchComparison/SSD.h"
+
+template <typename TImage>
+void PyramidSearchBackend<TImage>::SetNumberOfLevels(const unsigned int numberOfLevels)
+{
+  this->PyramidSearch.SetNumberOfLevels(numberOfLevels);
+}
+
+template <typename TImage>
+bool PyramidSearchBackend<TImage>::SupportsPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor) const
+{
+  return dynamic_cast<SSD<TImage>*>(patchDistanceFunctor) != NULL;
+}
+
+template <typename TImage>
+bool PyramidSearchBackend<TImage>::CanComputePatchScores(const Query& query, std::string& reason)
+{
+  if(!SupportsPatchDistanceFunctor(query.PatchDistanceFunctor) || query.NumberOfPatchesToKeep == 0)
+  {
+    reason = "The PYRAMID backend requires an SSD functor and a bounded number of patches to keep.";
+    return false;
+  }
+
+  this->PyramidSearch.SetImage(query.Image);
+  this->PyramidSearch.SetMask(query.MaskImage);
+  if(this->PyramidSearch.GetNumberOfUsableLevels(query.TargetRegion.GetSize()) == 0)
+  {
+    reason = "The PYRAMID backend requires patches that are large enough to downsample.";
+    return false;
+  }
+  return true;
+}
+
+template <typename TImage>
+void PyramidSearchBackend<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->PyramidSearch.SetCancelFlag(cancelFlag);
+}
+
+template <typename TImage>
+std::vector<typename PyramidSearchBackend<TImage>::PatchDataType>
+PyramidSearchBackend<TImage>::ComputePatchScores(const Query& query)
+{
+  this->PyramidSearch.SetImage(query.Image);
+  this->PyramidSearch.SetMask(query.MaskImage);
+  this->PyramidSearch.SetPatchDistanceFunctor(query.PatchDistanceFunctor);
+  this->PyramidSearch.SetTargetRegion(query.TargetRegion);
+  this->PyramidSearch.SetNumberOfPatchesToKeep(query.NumberOfPatchesToKeep);
+  this->PyramidSearch.ComputePatchScores();
+
+  return this->PyramidSearch.GetPatchData();
+}
+
+#endif
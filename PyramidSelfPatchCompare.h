@@ -0,0 +1,215 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef PyramidSelfPatchCompare_H
+#define PyramidSelfPatchCompare_H
+
+// Qt
+#include <QAtomicInt>
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <utility>
+#include <vector>
+
+// Submodules
+#include "PatchComparison/Mask/Mask.h"
+#include "PatchComparison/PatchDistance.h"
+#include "PatchComparison/SelfPatchCompare.h"
+
+// Custom
+#include "BoundedPatchDistance.h"
+#include "TopPatchCollector.h"
+
+/** Coarse to fine search for the best source patches of a target patch.
+  * A Gaussian pyramid of the image (and of the mask) is built once per image and kept until the image, mask,
+  * or their modified times change. The whole coarsest level is scanned with the SSD of the downsampled
+  * patches, and the best NumberOfCandidates corners are carried down: at each finer level, every corner within
+  * RefinementRadius of the (doubled) corner of each candidate is scored, and the best ones are kept again.
+  * At full resolution the candidates are scored with the PatchDistance functor, so the scores have the
+  * same meaning as in the exhaustive search; only the set of patches that are considered is approximate.
+  * Each level has a quarter of the patches of the level below it, so the scan costs roughly 4^-L of the
+  * exhaustive one with L levels above full resolution.
+  * The coarse levels always rank the patches by the SSD of their pixel values, whatever the functor is, so the
+  * candidates are only meaningful for an SSD functor on the same image (ParallelSelfPatchCompare only uses the
+  * search with one).
+  */
+template <typename TImage>
+class PyramidSelfPatchCompare
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SelfPatchCompare<TImage>::PatchDataType PatchDataType;
+
+  /** Constructor. */
+  PyramidSelfPatchCompare();
+
+  /** Set the image to search. */
+  void SetImage(TImage* const image);
+
+  /** Set the mask. Only source patches that are entirely valid are used. If no mask is set, every patch is valid. */
+  void SetMask(Mask* const mask);
+
+  /** Set the target/query region. */
+  void SetTargetRegion(const itk::ImageRegion<2>& targetRegion);
+
+  /** Set the functor used to score the patches at full resolution. */
+  void SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor);
+
+  /** Set the number of best patches to keep. This must not be 0. */
+  void SetNumberOfPatchesToKeep(const unsigned int numberOfPatchesToKeep);
+
+  /** Set the number of levels above full resolution. Fewer are used if the patches would get smaller than
+    * 3 pixels across. */
+  void SetNumberOfLevels(const unsigned int numberOfLevels);
+
+  /** Set the number of candidates carried down from each level (0 means 4 * NumberOfPatchesToKeep, at least 32). */
+  void SetNumberOfCandidates(const unsigned int numberOfCandidates);
+
+  /** Set the distance (in pixels of the finer level) around each doubled candidate corner that is searched. */
+  void SetRefinementRadius(const unsigned int refinementRadius);
+
+  /** Get the number of levels above full resolution that can be used for patches of this size (0 if the
+    * patches are too small to be downsampled). This builds the pyramid if needed. */
+  unsigned int GetNumberOfUsableLevels(const itk::Size<2>& patchSize);
+
+  /** Set a flag that is checked between the levels and between the rows of each level. When it becomes non-zero,
+    * ComputePatchScores() stops soon after and produces no patches. NULL (the default) means the search cannot be
+    * canceled. */
+  void SetCancelFlag(const QAtomicInt* const cancelFlag);
+
+  /** Find the best source patches of the target region. */
+  void ComputePatchScores();
+
+  /** Get the patches kept by the last call to ComputePatchScores(), best first. */
+  std::vector<PatchDataType> GetPatchData() const;
+
+private:
+
+  /** One level of the pyramid. Coordinates are relative to the corner of the image. */
+  struct Level
+  {
+    unsigned int Width;
+    unsigned int Height;
+
+    /** The pixel values, with the channels of each pixel next to each other, in raster order. */
+    std::vector<float> Pixels;
+
+    /** 1 for valid pixels and 0 for holes. */
+    std::vector<unsigned char> Valid;
+
+    /** A summed area table of the holes, with an extra row and column of zeros at the top and left. */
+    std::vector<unsigned int> HoleTable;
+  };
+
+  /** A patch corner (relative to the corner of the image) and its score, in the form TopPatchCollector expects. */
+  typedef std::pair<itk::Index<2>, float> CandidateType;
+
+  /** True if the cancel flag is set. */
+  bool IsCancelRequested() const;
+
+  /** Rebuild the pyramid if the image, mask, or their modified times have changed. */
+  void UpdatePyramid();
+
+  /** Blur a level with a 5-tap binomial filter and take every other pixel in each direction. A coarse pixel is
+    * valid if all of the fine pixels it covers are valid. */
+  void Downsample(const Level& fineLevel, Level& coarseLevel) const;
+
+  /** Fill the summed area table of the holes of a level. */
+  static void ComputeHoleTable(Level& level);
+
+  /** True if the patch with this corner and size is inside the level and has no holes. */
+  static bool IsValidPatch(const Level& level, const itk::Index<2>& corner, const itk::Size<2>& patchSize);
+
+  /** The SSD of two patches of a level, stopping (as PartialSSD does) once it exceeds 'bound'. */
+  float LevelSSD(const Level& level, const itk::Index<2>& corner1, const itk::Index<2>& corner2,
+                 const itk::Size<2>& patchSize, const float bound) const;
+
+  /** Get the size of a full resolution patch at a level. */
+  static itk::Size<2> GetLevelPatchSize(const itk::Size<2>& patchSize, const unsigned int level);
+
+  /** Get the corner of the target patch at a level, moved inside the level if rounding pushed it out. */
+  itk::Index<2> GetLevelTargetCorner(const unsigned int level) const;
+
+  /** Score the corners of a level (>= 1) around the doubled corners of the candidates from the level above, and
+    * keep the best 'numberOfCandidates'. Returns no candidates if the search is canceled. */
+  std::vector<CandidateType> RefineCandidates(const unsigned int level, const std::vector<CandidateType>& candidates,
+                                              const unsigned int numberOfCandidates) const;
+
+  /** Score the full resolution patches around the doubled corners of the candidates from level 1 with the functor,
+    * and keep the best NumberOfPatchesToKeep in PatchData. Keeps none if the search is canceled. */
+  void ScoreFullResolution(const std::vector<CandidateType>& candidates);
+
+  /** The image to search. */
+  TImage* Image;
+
+  /** The mask indicating which pixels can be used in source patches. */
+  Mask* MaskImage;
+
+  /** The query/target region. */
+  itk::ImageRegion<2> TargetRegion;
+
+  /** The functor used to score the patches at full resolution. */
+  PatchDistance<TImage>* PatchDistanceFunctor;
+
+  /** The number of best patches to keep. */
+  unsigned int NumberOfPatchesToKeep;
+
+  /** The requested number of levels above full resolution. */
+  unsigned int NumberOfLevels;
+
+  /** The number of candidates carried down from each level (0 means automatic). */
+  unsigned int NumberOfCandidates;
+
+  /** The search radius around each doubled candidate corner. */
+  unsigned int RefinementRadius;
+
+  /** The image the pyramid was built from. */
+  TImage* CachedImage;
+
+  /** The modified time of the image when the pyramid was built. */
+  unsigned long CachedImageMTime;
+
+  /** The mask the pyramid was built from. */
+  Mask* CachedMask;
+
+  /** The modified time of the mask when the pyramid was built. */
+  unsigned long CachedMaskMTime;
+
+  /** The number of levels the pyramid was built with. */
+  unsigned int CachedNumberOfLevels;
+
+  /** The number of channels of the image. */
+  unsigned int NumberOfComponents;
+
+  /** The levels of the pyramid. Level 0 is the image itself. */
+  std::vector<Level> Levels;
+
+  /** If this is set and non-zero, the search stops. */
+  const QAtomicInt* CancelFlag;
+
+  /** The best source patches, sorted by score. */
+  std::vector<PatchDataType> PatchData;
+};
+
+#include "PyramidSelfPatchCompare.hpp"
+
+#endif
@@ -0,0 +1,508 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef PyramidSelfPatchCompare_HPP
+#define PyramidSelfPatchCompare_HPP
+
+#include "PyramidSelfPatchCompare.h"
+
+// ITK
+#include "itkImageRegionConstIteratorWithIndex.h"
+
+// STL
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <stdexcept>
+
+template <typename TImage>
+PyramidSelfPatchCompare<TImage>::PyramidSelfPatchCompare() : Image(NULL), MaskImage(NULL), PatchDistanceFunctor(NULL),
+NumberOfPatchesToKeep(10), NumberOfLevels(2), NumberOfCandidates(0), RefinementRadius(2), CachedImage(NULL),
+CachedImageMTime(0), CachedMask(NULL), CachedMaskMTime(0), CachedNumberOfLevels(0), NumberOfComponents(0),
+CancelFlag(NULL)
+{
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetImage(TImage* const image)
+{
+  this->Image = image;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetMask(Mask* const mask)
+{
+  this->MaskImage = mask;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetTargetRegion(const itk::ImageRegion<2>& targetRegion)
+{
+  this->TargetRegion = targetRegion;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor)
+{
+  this->PatchDistanceFunctor = patchDistanceFunctor;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetNumberOfPatchesToKeep(const unsigned int numberOfPatchesToKeep)
+{
+  this->NumberOfPatchesToKeep = numberOfPatchesToKeep;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetNumberOfLevels(const unsigned int numberOfLevels)
+{
+  this->NumberOfLevels = numberOfLevels;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetNumberOfCandidates(const unsigned int numberOfCandidates)
+{
+  this->NumberOfCandidates = numberOfCandidates;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetRefinementRadius(const unsigned int refinementRadius)
+{
+  this->RefinementRadius = refinementRadius;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::SetCancelFlag(const QAtomicInt* const cancelFlag)
+{
+  this->CancelFlag = cancelFlag;
+}
+
+template <typename TImage>
+bool PyramidSelfPatchCompare<TImage>::IsCancelRequested() const
+{
+  return this->CancelFlag && static_cast<int>(*this->CancelFlag) != 0;
+}
+
+template <typename TImage>
+std::vector<typename PyramidSelfPatchCompare<TImage>::PatchDataType>
+PyramidSelfPatchCompare<TImage>::GetPatchData() const
+{
+  return this->PatchData;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::UpdatePyramid()
+{
+  if(!this->Image)
+  {
+    throw std::runtime_error("PyramidSelfPatchCompare: Must call SetImage() before searching!");
+  }
+
+  unsigned long maskMTime = this->MaskImage ? this->MaskImage->GetMTime() : 0;
+  if(this->Image == this->CachedImage && this->Image->GetMTime() == this->CachedImageMTime &&
+     this->MaskImage == this->CachedMask && maskMTime == this->CachedMaskMTime &&
+     this->NumberOfLevels == this->CachedNumberOfLevels && !this->Levels.empty())
+  {
+    return;
+  }
+
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+  this->NumberOfComponents = this->Image->GetNumberOfComponentsPerPixel();
+
+  this->Levels.assign(1, Level());
+  Level& fullResolution = this->Levels[0];
+  fullResolution.Width = fullRegion.GetSize()[0];
+  fullResolution.Height = fullRegion.GetSize()[1];
+  fullResolution.Pixels.resize(static_cast<size_t>(fullResolution.Width) * fullResolution.Height * this->NumberOfComponents);
+  fullResolution.Valid.resize(static_cast<size_t>(fullResolution.Width) * fullResolution.Height);
+
+  itk::ImageRegionConstIteratorWithIndex<TImage> imageIterator(this->Image, fullRegion);
+  while(!imageIterator.IsAtEnd())
+  {
+    size_t pixelId = (imageIterator.GetIndex()[1] - fullRegion.GetIndex()[1]) * fullResolution.Width +
+                     (imageIterator.GetIndex()[0] - fullRegion.GetIndex()[0]);
+    typename TImage::PixelType pixel = imageIterator.Get();
+    for(unsigned int component = 0; component < this->NumberOfComponents; ++component)
+    {
+      fullResolution.Pixels[pixelId * this->NumberOfComponents + component] = pixel[component];
+    }
+    fullResolution.Valid[pixelId] = (!this->MaskImage || this->MaskImage->IsValid(imageIterator.GetIndex())) ? 1 : 0;
+    ++imageIterator;
+  }
+  ComputeHoleTable(fullResolution);
+
+  while(this->Levels.size() <= this->NumberOfLevels && this->Levels.back().Width >= 2 && this->Levels.back().Height >= 2)
+  {
+    Level coarseLevel;
+    Downsample(this->Levels.back(), coarseLevel);
+    ComputeHoleTable(coarseLevel);
+    this->Levels.push_back(coarseLevel);
+  }
+
+  this->CachedImage = this->Image;
+  this->CachedImageMTime = this->Image->GetMTime();
+  this->CachedMask = this->MaskImage;
+  this->CachedMaskMTime = maskMTime;
+  this->CachedNumberOfLevels = this->NumberOfLevels;
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::Downsample(const Level& fineLevel, Level& coarseLevel) const
+{
+  const float weights[5] = {1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f};
+  const unsigned int components = this->NumberOfComponents;
+
+  coarseLevel.Width = (fineLevel.Width + 1) / 2;
+  coarseLevel.Height = (fineLevel.Height + 1) / 2;
+
+  // Blur and subsample the rows, then the columns. The image is extended by repeating its border pixels.
+  std::vector<float> rowsDone(static_cast<size_t>(coarseLevel.Width) * fineLevel.Height * components, 0);
+  for(unsigned int row = 0; row < fineLevel.Height; ++row)
+  {
+    for(unsigned int column = 0; column < coarseLevel.Width; ++column)
+    {
+      for(int tap = 0; tap < 5; ++tap)
+      {
+        int fineColumn = std::min(std::max(2 * static_cast<int>(column) + tap - 2, 0), static_cast<int>(fineLevel.Width) - 1);
+        for(unsigned int component = 0; component < components; ++component)
+        {
+          rowsDone[(static_cast<size_t>(row) * coarseLevel.Width + column) * components + component] +=
+            weights[tap] * fineLevel.Pixels[(static_cast<size_t>(row) * fineLevel.Width + fineColumn) * components + component];
+        }
+      }
+    }
+  }
+
+  coarseLevel.Pixels.assign(static_cast<size_t>(coarseLevel.Width) * coarseLevel.Height * components, 0);
+  coarseLevel.Valid.assign(static_cast<size_t>(coarseLevel.Width) * coarseLevel.Height, 1);
+  for(unsigned int row = 0; row < coarseLevel.Height; ++row)
+  {
+    for(unsigned int column = 0; column < coarseLevel.Width; ++column)
+    {
+      size_t coarsePixelId = static_cast<size_t>(row) * coarseLevel.Width + column;
+      for(int tap = 0; tap < 5; ++tap)
+      {
+        int fineRow = std::min(std::max(2 * static_cast<int>(row) + tap - 2, 0), static_cast<int>(fineLevel.Height) - 1);
+        for(unsigned int component = 0; component < components; ++component)
+        {
+          coarseLevel.Pixels[coarsePixelId * components + component] +=
+            weights[tap] * rowsDone[(static_cast<size_t>(fineRow) * coarseLevel.Width + column) * components + component];
+        }
+      }
+
+      for(unsigned int fineRow = 2 * row; fineRow < std::min(2 * row + 2, fineLevel.Height); ++fineRow)
+      {
+        for(unsigned int fineColumn = 2 * column; fineColumn < std::min(2 * column + 2, fineLevel.Width); ++fineColumn)
+        {
+          coarseLevel.Valid[coarsePixelId] &= fineLevel.Valid[static_cast<size_t>(fineRow) * fineLevel.Width + fineColumn];
+        }
+      }
+    }
+  }
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::ComputeHoleTable(Level& level)
+{
+  const size_t stride = level.Width + 1;
+  level.HoleTable.assign(stride * (level.Height + 1), 0);
+  for(unsigned int row = 0; row < level.Height; ++row)
+  {
+    unsigned int rowHoles = 0;
+    for(unsigned int column = 0; column < level.Width; ++column)
+    {
+      rowHoles += level.Valid[static_cast<size_t>(row) * level.Width + column] ? 0 : 1;
+      level.HoleTable[(row + 1) * stride + column + 1] = level.HoleTable[row * stride + column + 1] + rowHoles;
+    }
+  }
+}
+
+template <typename TImage>
+bool PyramidSelfPatchCompare<TImage>::IsValidPatch(const Level& level, const itk::Index<2>& corner,
+                                                   const itk::Size<2>& patchSize)
+{
+  if(corner[0] < 0 || corner[1] < 0 || corner[0] + patchSize[0] > level.Width || corner[1] + patchSize[1] > level.Height)
+  {
+    return false;
+  }
+
+  const size_t stride = level.Width + 1;
+  const size_t left = corner[0];
+  const size_t top = corner[1];
+  const size_t right = left + patchSize[0];
+  const size_t bottom = top + patchSize[1];
+  return level.HoleTable[bottom * stride + right] - level.HoleTable[top * stride + right] -
+         level.HoleTable[bottom * stride + left] + level.HoleTable[top * stride + left] == 0;
+}
+
+template <typename TImage>
+float PyramidSelfPatchCompare<TImage>::LevelSSD(const Level& level, const itk::Index<2>& corner1,
+                                                const itk::Index<2>& corner2, const itk::Size<2>& patchSize,
+                                                const float bound) const
+{
+  const size_t rowLength = patchSize[0] * this->NumberOfComponents;
+
+  double sum = 0;
+  for(unsigned int row = 0; row < patchSize[1]; ++row)
+  {
+    const float* row1 = &level.Pixels[((corner1[1] + row) * level.Width + corner1[0]) * this->NumberOfComponents];
+    const float* row2 = &level.Pixels[((corner2[1] + row) * level.Width + corner2[0]) * this->NumberOfComponents];
+    for(size_t element = 0; element < rowLength; ++element)
+    {
+      double difference = row1[element] - row2[element];
+      sum += difference * difference;
+    }
+
+    if(static_cast<float>(sum) > bound && row + 1 < patchSize[1])
+    {
+      return std::numeric_limits<float>::infinity();
+    }
+  }
+
+  return static_cast<float>(sum);
+}
+
+template <typename TImage>
+itk::Size<2> PyramidSelfPatchCompare<TImage>::GetLevelPatchSize(const itk::Size<2>& patchSize, const unsigned int level)
+{
+  itk::Size<2> levelPatchSize = {{std::max<itk::SizeValueType>(patchSize[0] >> level, 1),
+                                  std::max<itk::SizeValueType>(patchSize[1] >> level, 1)}};
+  return levelPatchSize;
+}
+
+template <typename TImage>
+itk::Index<2> PyramidSelfPatchCompare<TImage>::GetLevelTargetCorner(const unsigned int level) const
+{
+  const Level& levelData = this->Levels[level];
+  itk::Size<2> levelPatchSize = GetLevelPatchSize(this->TargetRegion.GetSize(), level);
+  itk::ImageRegion<2> fullRegion = this->Image->GetLargestPossibleRegion();
+
+  itk::Index<2> corner;
+  corner[0] = std::min<itk::IndexValueType>((this->TargetRegion.GetIndex()[0] - fullRegion.GetIndex()[0]) >> level,
+                                            levelData.Width - levelPatchSize[0]);
+  corner[1] = std::min<itk::IndexValueType>((this->TargetRegion.GetIndex()[1] - fullRegion.GetIndex()[1]) >> level,
+                                            levelData.Height - levelPatchSize[1]);
+  return corner;
+}
+
+template <typename TImage>
+unsigned int PyramidSelfPatchCompare<TImage>::GetNumberOfUsableLevels(const itk::Size<2>& patchSize)
+{
+  UpdatePyramid();
+
+  // Patches are not downsampled below this many pixels across, since they would say little about the
+  // full resolution patch.
+  const unsigned int minimumPatchSize = 3;
+
+  unsigned int numberOfUsableLevels = 0;
+  while(numberOfUsableLevels + 1 < this->Levels.size())
+  {
+    itk::Size<2> levelPatchSize = GetLevelPatchSize(patchSize, numberOfUsableLevels + 1);
+    const Level& level = this->Levels[numberOfUsableLevels + 1];
+    if(levelPatchSize[0] < minimumPatchSize || levelPatchSize[1] < minimumPatchSize ||
+       levelPatchSize[0] > level.Width || levelPatchSize[1] > level.Height)
+    {
+      break;
+    }
+    ++numberOfUsableLevels;
+  }
+
+  return numberOfUsableLevels;
+}
+
+template <typename TImage>
+std::vector<typename PyramidSelfPatchCompare<TImage>::CandidateType>
+PyramidSelfPatchCompare<TImage>::RefineCandidates(const unsigned int level, const std::vector<CandidateType>& candidates,
+                                                  const unsigned int numberOfCandidates) const
+{
+  const Level& levelData = this->Levels[level];
+  const itk::Size<2> levelPatchSize = GetLevelPatchSize(this->TargetRegion.GetSize(), level);
+  const itk::Index<2> targetCorner = GetLevelTargetCorner(level);
+  const itk::IndexValueType radius = this->RefinementRadius;
+
+  TopPatchCollector<CandidateType> refinedCandidates(numberOfCandidates);
+  std::set<size_t> triedCorners;
+
+  for(size_t candidateId = 0; candidateId < candidates.size(); ++candidateId)
+  {
+    if(IsCancelRequested())
+    {
+      return std::vector<CandidateType>();
+    }
+
+    const itk::Index<2>& coarseCorner = candidates[candidateId].first;
+    for(itk::IndexValueType rowOffset = -radius; rowOffset <= radius; ++rowOffset)
+    {
+      for(itk::IndexValueType columnOffset = -radius; columnOffset <= radius; ++columnOffset)
+      {
+        itk::Index<2> corner = {{2 * coarseCorner[0] + columnOffset, 2 * coarseCorner[1] + rowOffset}};
+        if(!IsValidPatch(levelData, corner, levelPatchSize))
+        {
+          continue;
+        }
+
+        size_t order = corner[1] * levelData.Width + corner[0];
+        if(!triedCorners.insert(order).second)
+        {
+          continue;
+        }
+
+        float bound = refinedCandidates.GetAdmissionThreshold();
+        float distance = LevelSSD(levelData, corner, targetCorner, levelPatchSize, bound);
+        if(distance <= bound)
+        {
+          refinedCandidates.Add(CandidateType(corner, distance), order);
+        }
+      }
+    }
+  }
+
+  return refinedCandidates.GetSortedPatchData();
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::ScoreFullResolution(const std::vector<CandidateType>& candidates)
+{
+  const Level& levelData = this->Levels[0];
+  const itk::Size<2> patchSize = this->TargetRegion.GetSize();
+  const itk::Index<2> imageCorner = this->Image->GetLargestPossibleRegion().GetIndex();
+  const itk::IndexValueType radius = this->RefinementRadius;
+
+  BoundedPatchDistance<TImage>* boundedDistanceFunctor =
+    dynamic_cast<BoundedPatchDistance<TImage>*>(this->PatchDistanceFunctor);
+
+  TopPatchCollector<PatchDataType> topPatches(this->NumberOfPatchesToKeep);
+  std::set<size_t> triedCorners;
+
+  for(size_t candidateId = 0; candidateId < candidates.size(); ++candidateId)
+  {
+    if(IsCancelRequested())
+    {
+      return;
+    }
+
+    const itk::Index<2>& coarseCorner = candidates[candidateId].first;
+    for(itk::IndexValueType rowOffset = -radius; rowOffset <= radius; ++rowOffset)
+    {
+      for(itk::IndexValueType columnOffset = -radius; columnOffset <= radius; ++columnOffset)
+      {
+        itk::Index<2> corner = {{2 * coarseCorner[0] + columnOffset, 2 * coarseCorner[1] + rowOffset}};
+        if(!IsValidPatch(levelData, corner, patchSize))
+        {
+          continue;
+        }
+
+        // The same raster order as the exhaustive search, so ties are broken the same way.
+        size_t order = corner[1] * levelData.Width + corner[0];
+        if(!triedCorners.insert(order).second)
+        {
+          continue;
+        }
+
+        itk::Index<2> sourceCorner = {{imageCorner[0] + corner[0], imageCorner[1] + corner[1]}};
+        itk::ImageRegion<2> sourceRegion(sourceCorner, patchSize);
+
+        float distance = 0;
+        if(boundedDistanceFunctor)
+        {
+          float bound = topPatches.GetAdmissionThreshold();
+          distance = boundedDistanceFunctor->BoundedDistance(sourceRegion, this->TargetRegion, bound);
+          if(distance > bound)
+          {
+            continue;
+          }
+        }
+        else
+        {
+          distance = this->PatchDistanceFunctor->Distance(sourceRegion, this->TargetRegion);
+        }
+
+        topPatches.Add(PatchDataType(sourceRegion, distance), order);
+      }
+    }
+  }
+
+  this->PatchData = topPatches.GetSortedPatchData();
+}
+
+template <typename TImage>
+void PyramidSelfPatchCompare<TImage>::ComputePatchScores()
+{
+  if(!this->Image || !this->PatchDistanceFunctor || this->NumberOfPatchesToKeep == 0)
+  {
+    throw std::runtime_error("PyramidSelfPatchCompare: Must set the image, the PatchDistance functor, and a non-zero "
+                             "number of patches to keep before calling ComputePatchScores()!");
+  }
+
+  this->PatchData.clear();
+
+  const unsigned int coarsestLevel = GetNumberOfUsableLevels(this->TargetRegion.GetSize());
+  if(coarsestLevel == 0)
+  {
+    throw std::runtime_error("PyramidSelfPatchCompare: The patches are too small (or the image has too few levels) "
+                             "for a coarse to fine search!");
+  }
+
+  const unsigned int numberOfCandidates = (this->NumberOfCandidates > 0) ? this->NumberOfCandidates :
+                                          std::max(4 * this->NumberOfPatchesToKeep, 32u);
+
+  // Scan the whole coarsest level.
+  const Level& coarsest = this->Levels[coarsestLevel];
+  const itk::Size<2> coarsestPatchSize = GetLevelPatchSize(this->TargetRegion.GetSize(), coarsestLevel);
+  const itk::Index<2> coarsestTargetCorner = GetLevelTargetCorner(coarsestLevel);
+
+  TopPatchCollector<CandidateType> coarsestCandidates(numberOfCandidates);
+  for(itk::IndexValueType row = 0; row + coarsestPatchSize[1] <= coarsest.Height; ++row)
+  {
+    if(IsCancelRequested())
+    {
+      return;
+    }
+
+    for(itk::IndexValueType column = 0; column + coarsestPatchSize[0] <= coarsest.Width; ++column)
+    {
+      itk::Index<2> corner = {{column, row}};
+      if(!IsValidPatch(coarsest, corner, coarsestPatchSize))
+      {
+        continue;
+      }
+
+      float bound = coarsestCandidates.GetAdmissionThreshold();
+      float distance = LevelSSD(coarsest, corner, coarsestTargetCorner, coarsestPatchSize, bound);
+      if(distance <= bound)
+      {
+        coarsestCandidates.Add(CandidateType(corner, distance), row * coarsest.Width + column);
+      }
+    }
+  }
+
+  // Carry the candidates down to level 1, then score the full resolution patches around them.
+  std::vector<CandidateType> candidates = coarsestCandidates.GetSortedPatchData();
+  for(unsigned int level = coarsestLevel - 1; level >= 1; --level)
+  {
+    candidates = RefineCandidates(level, candidates, numberOfCandidates);
+    if(IsCancelRequested())
+    {
+      return;
+    }
+  }
+
+  ScoreFullResolution(candidates);
+}
+
+#endif
@@ -0,0 +1,340 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "SSDKernels.h"
+
+// STL
+#include <algorithm>
+
+// The vector kernels are compiled with per-function target attributes, so the rest of the program does not
+// need to be built with -mavx2 and still runs on CPUs without it.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define SSDKERNELS_X86
+  #include <immintrin.h>
+#endif
+
+// The pixel buffer is read as packed bytes, which relies on the pixels having no padding.
+static_assert(sizeof(SSDKernels::RGBImageType::PixelType) == 3, "RGB pixels are expected to be 3 packed bytes.");
+
+namespace
+{
+  typedef uint64_t (*KernelType)(const unsigned char* const, const unsigned char* const, const unsigned int);
+
+  uint64_t ScalarSSD(const unsigned char* const a, const unsigned char* const b, const unsigned int length)
+  {
+    uint64_t sum = 0;
+    for(unsigned int i = 0; i < length; ++i)
+    {
+      int difference = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+      sum += difference * difference;
+    }
+    return sum;
+  }
+
+  /** The lengths of the rows are only known at run time, so the loops above cannot be unrolled. The most common
+    * patch radii (3, 4, 5, 7 and 9) also get kernels with the row length fixed at compile time, whose loops the
+    * compiler unrolls completely. Their arguments and results are the same as the generic kernels. */
+  const unsigned int NumberOfSpecializedSideLengths = 5;
+  const unsigned int SpecializedSideLengths[NumberOfSpecializedSideLengths] = {7, 9, 11, 15, 19};
+
+  template <unsigned int TLength>
+  uint64_t FixedLengthScalarSSD(const unsigned char* const a, const unsigned char* const b, const unsigned int)
+  {
+    uint64_t sum = 0;
+    for(unsigned int i = 0; i < TLength; ++i)
+    {
+      int difference = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+      sum += difference * difference;
+    }
+    return sum;
+  }
+
+#ifdef SSDKERNELS_X86
+  /** Each 32-bit lane gains at most 2 * 255^2 per step, so the lanes are flushed into the 64-bit sum well
+    * before they could overflow. */
+  const unsigned int MaximumStepsBetweenFlushes = 16384;
+
+  __attribute__((target("sse4.1")))
+  uint64_t SSE41SSD(const unsigned char* const a, const unsigned char* const b, const unsigned int length)
+  {
+    uint64_t sum = 0;
+    unsigned int i = 0;
+    while(i + 8 <= length)
+    {
+      __m128i accumulator = _mm_setzero_si128();
+      for(unsigned int step = 0; step < MaximumStepsBetweenFlushes && i + 8 <= length; ++step, i += 8)
+      {
+        __m128i a16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + i)));
+        __m128i b16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i)));
+        __m128i difference = _mm_sub_epi16(a16, b16);
+        accumulator = _mm_add_epi32(accumulator, _mm_madd_epi16(difference, difference));
+      }
+      uint32_t lanes[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+      sum += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum + ScalarSSD(a + i, b + i, length - i);
+  }
+
+  __attribute__((target("avx2")))
+  uint64_t AVX2SSD(const unsigned char* const a, const unsigned char* const b, const unsigned int length)
+  {
+    uint64_t sum = 0;
+    unsigned int i = 0;
+    while(i + 16 <= length)
+    {
+      __m256i accumulator = _mm256_setzero_si256();
+      for(unsigned int step = 0; step < MaximumStepsBetweenFlushes && i + 16 <= length; ++step, i += 16)
+      {
+        __m256i a16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i b16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m256i difference = _mm256_sub_epi16(a16, b16);
+        accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(difference, difference));
+      }
+      uint32_t lanes[8];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+      for(unsigned int lane = 0; lane < 8; ++lane)
+      {
+        sum += lanes[lane];
+      }
+    }
+    // A 15 pixel wide patch leaves a remainder of 13 bytes, so finish with the 8 byte kernel when possible.
+    return sum + SSE41SSD(a + i, b + i, length - i);
+  }
+
+  /** The fixed length rows are at most 57 bytes, far too short for the 32-bit lanes to overflow. */
+  template <unsigned int TLength>
+  __attribute__((target("sse4.1")))
+  uint64_t FixedLengthSSE41SSD(const unsigned char* const a, const unsigned char* const b, const unsigned int)
+  {
+    const unsigned int vectorLength = TLength / 8 * 8;
+    __m128i accumulator = _mm_setzero_si128();
+    for(unsigned int i = 0; i < vectorLength; i += 8)
+    {
+      __m128i a16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + i)));
+      __m128i b16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i)));
+      __m128i difference = _mm_sub_epi16(a16, b16);
+      accumulator = _mm_add_epi32(accumulator, _mm_madd_epi16(difference, difference));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+    uint64_t sum = static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    return sum + FixedLengthScalarSSD<TLength - vectorLength>(a + vectorLength, b + vectorLength, 0);
+  }
+
+  template <unsigned int TLength>
+  __attribute__((target("avx2")))
+  uint64_t FixedLengthAVX2SSD(const unsigned char* const a, const unsigned char* const b, const unsigned int)
+  {
+    const unsigned int vectorLength = TLength / 16 * 16;
+    __m256i accumulator = _mm256_setzero_si256();
+    for(unsigned int i = 0; i < vectorLength; i += 16)
+    {
+      __m256i a16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+      __m256i b16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+      __m256i difference = _mm256_sub_epi16(a16, b16);
+      accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(difference, difference));
+    }
+    uint32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+    uint64_t sum = 0;
+    for(unsigned int lane = 0; lane < 8; ++lane)
+    {
+      sum += lanes[lane];
+    }
+    return sum + FixedLengthSSE41SSD<TLength - vectorLength>(a + vectorLength, b + vectorLength, 0);
+  }
+#endif
+
+  /** The longest row that has a fixed length kernel. */
+  const unsigned int MaximumSpecializedRowBytes = 3 * 19;
+
+  struct KernelChoice
+  {
+    KernelType Kernel;
+    const char* Name;
+
+    /** The kernels for rows of 3 * SpecializedSideLengths[i] bytes. */
+    KernelType SpecializedKernels[NumberOfSpecializedSideLengths];
+
+    /** The kernel for each row length up to MaximumSpecializedRowBytes, so looking one up is a single read. */
+    KernelType RowKernels[MaximumSpecializedRowBytes + 1];
+  };
+
+  /** Fill the table of kernels by row length of a choice. */
+  void FillRowKernels(KernelChoice& choice)
+  {
+    std::fill(choice.RowKernels, choice.RowKernels + MaximumSpecializedRowBytes + 1, choice.Kernel);
+    for(unsigned int i = 0; i < NumberOfSpecializedSideLengths; ++i)
+    {
+      choice.RowKernels[3 * SpecializedSideLengths[i]] = choice.SpecializedKernels[i];
+    }
+  }
+
+  KernelChoice ChooseKernel()
+  {
+    KernelChoice choice = {ScalarSSD, "Scalar",
+                           {FixedLengthScalarSSD<3 * 7>, FixedLengthScalarSSD<3 * 9>, FixedLengthScalarSSD<3 * 11>,
+                            FixedLengthScalarSSD<3 * 15>, FixedLengthScalarSSD<3 * 19>}};
+#ifdef SSDKERNELS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+      KernelChoice avx2Choice = {AVX2SSD, "AVX2",
+                                 {FixedLengthAVX2SSD<3 * 7>, FixedLengthAVX2SSD<3 * 9>, FixedLengthAVX2SSD<3 * 11>,
+                                  FixedLengthAVX2SSD<3 * 15>, FixedLengthAVX2SSD<3 * 19>}};
+      choice = avx2Choice;
+    }
+    else if(__builtin_cpu_supports("sse4.1"))
+    {
+      KernelChoice sse41Choice = {SSE41SSD, "SSE4.1",
+                                  {FixedLengthSSE41SSD<3 * 7>, FixedLengthSSE41SSD<3 * 9>, FixedLengthSSE41SSD<3 * 11>,
+                                   FixedLengthSSE41SSD<3 * 15>, FixedLengthSSE41SSD<3 * 19>}};
+      choice = sse41Choice;
+    }
+#endif
+    FillRowKernels(choice);
+    return choice;
+  }
+
+  /** The choice is made once. Function local statics are initialized thread safely in C++11. */
+  const KernelChoice& GetKernelChoice()
+  {
+    static const KernelChoice choice = ChooseKernel();
+    return choice;
+  }
+
+  /** The kernel for rows of 'rowBytes' bytes: a fixed length one if there is one, and the generic one otherwise. */
+  KernelType GetRowKernel(const unsigned int rowBytes)
+  {
+    const KernelChoice& choice = GetKernelChoice();
+    return rowBytes <= MaximumSpecializedRowBytes ? choice.RowKernels[rowBytes] : choice.Kernel;
+  }
+}
+
+uint64_t SSDKernels::SumOfSquaredDifferences(const unsigned char* const a, const unsigned char* const b,
+                                             const unsigned int length)
+{
+  return GetRowKernel(length)(a, b, length);
+}
+
+const char* SSDKernels::GetInstructionSetName()
+{
+  return GetKernelChoice().Name;
+}
+
+float SSDKernels::BoundedSSD(const RGBImageType* const image, const itk::ImageRegion<2>& region1,
+                             const itk::ImageRegion<2>& region2, const float bound)
+{
+  if(region1.GetSize() != region2.GetSize())
+  {
+    throw std::runtime_error("BoundedSSD: The regions must be the same size!");
+  }
+
+  const itk::ImageRegion<2> bufferedRegion = image->GetBufferedRegion();
+  if(!bufferedRegion.IsInside(region1) || !bufferedRegion.IsInside(region2))
+  {
+    throw std::runtime_error("BoundedSSD: The regions must be inside the image!");
+  }
+
+  const unsigned char* const buffer = reinterpret_cast<const unsigned char*>(image->GetBufferPointer());
+  const size_t rowStride = 3 * static_cast<size_t>(bufferedRegion.GetSize()[0]);
+  const unsigned int rowBytes = 3 * region1.GetSize()[0];
+  const unsigned int numberOfRows = region1.GetSize()[1];
+
+  const unsigned char* row1 = buffer + (region1.GetIndex()[1] - bufferedRegion.GetIndex()[1]) * rowStride +
+                              3 * (region1.GetIndex()[0] - bufferedRegion.GetIndex()[0]);
+  const unsigned char* row2 = buffer + (region2.GetIndex()[1] - bufferedRegion.GetIndex()[1]) * rowStride +
+                              3 * (region2.GetIndex()[0] - bufferedRegion.GetIndex()[0]);
+
+  const KernelType kernel = GetRowKernel(rowBytes);
+
+  // The integer sum is exact, so the result (after rounding to float) matches the generic version.
+  uint64_t sum = 0;
+  for(unsigned int row = 0; row < numberOfRows; ++row)
+  {
+    sum += kernel(row1, row2, rowBytes);
+    row1 += rowStride;
+    row2 += rowStride;
+
+    if(static_cast<float>(sum) > bound && row + 1 < numberOfRows)
+    {
+      return std::numeric_limits<float>::infinity();
+    }
+  }
+
+  return static_cast<float>(sum);
+}
+
+void SSDKernels::BatchBoundedSSD(const RGBImageType* const image, const itk::ImageRegion<2>& targetRegion,
+                                 const itk::Index<2>* const sourceCorners, const unsigned int numberOfSources,
+                                 const float bound, float* const distances)
+{
+  const itk::ImageRegion<2> bufferedRegion = image->GetBufferedRegion();
+  if(!bufferedRegion.IsInside(targetRegion))
+  {
+    throw std::runtime_error("BatchBoundedSSD: The target region must be inside the image!");
+  }
+
+  const unsigned char* const buffer = reinterpret_cast<const unsigned char*>(image->GetBufferPointer());
+  const size_t rowStride = 3 * static_cast<size_t>(bufferedRegion.GetSize()[0]);
+  const unsigned int rowBytes = 3 * targetRegion.GetSize()[0];
+  const unsigned int numberOfRows = targetRegion.GetSize()[1];
+
+  // Copy the target rows next to each other, so they stay in the cache while the sources are compared to them.
+  std::vector<unsigned char> target(static_cast<size_t>(rowBytes) * numberOfRows);
+  const unsigned char* targetRow = buffer + (targetRegion.GetIndex()[1] - bufferedRegion.GetIndex()[1]) * rowStride +
+                                   3 * (targetRegion.GetIndex()[0] - bufferedRegion.GetIndex()[0]);
+  for(unsigned int row = 0; row < numberOfRows; ++row, targetRow += rowStride)
+  {
+    std::copy(targetRow, targetRow + rowBytes, target.begin() + static_cast<size_t>(row) * rowBytes);
+  }
+
+  const KernelType kernel = GetRowKernel(rowBytes);
+
+  itk::ImageRegion<2> sourceRegion(targetRegion.GetSize());
+  for(unsigned int sourceId = 0; sourceId < numberOfSources; ++sourceId)
+  {
+    sourceRegion.SetIndex(sourceCorners[sourceId]);
+    if(!bufferedRegion.IsInside(sourceRegion))
+    {
+      throw std::runtime_error("BatchBoundedSSD: The source regions must be inside the image!");
+    }
+
+    const unsigned char* sourceRow = buffer + (sourceRegion.GetIndex()[1] - bufferedRegion.GetIndex()[1]) * rowStride +
+                                     3 * (sourceRegion.GetIndex()[0] - bufferedRegion.GetIndex()[0]);
+    const unsigned char* targetRow = &target[0];
+
+    uint64_t sum = 0;
+    distances[sourceId] = std::numeric_limits<float>::infinity();
+    bool stopped = false;
+    for(unsigned int row = 0; row < numberOfRows && !stopped; ++row)
+    {
+      sum += kernel(sourceRow, targetRow, rowBytes);
+      sourceRow += rowStride;
+      targetRow += rowBytes;
+
+      stopped = static_cast<float>(sum) > bound && row + 1 < numberOfRows;
+    }
+
+    if(!stopped)
+    {
+      distances[sourceId] = static_cast<float>(sum);
+    }
+  }
+}
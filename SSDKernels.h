@@ -0,0 +1,173 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef SSDKernels_H
+#define SSDKernels_H
+
+// ITK
+#include "itkCovariantVector.h"
+#include "itkImage.h"
+#include "itkImageRegion.h"
+#include "itkImageRegionConstIterator.h"
+
+// STL
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// C
+#include <stdint.h>
+
+/** Low level sum of squared differences kernels used by PartialSSD. */
+namespace SSDKernels
+{
+  /** The image type used by the GUI, whose pixels are stored as interleaved 8-bit RGB. */
+  typedef itk::Image<itk::CovariantVector<unsigned char, 3>, 2> RGBImageType;
+
+  /** The sum of the squared differences of 'length' bytes. This uses AVX2 or SSE4.1 if the CPU
+    * supports them (checked once, at the first call) and plain C++ otherwise. The rows of the common patch
+    * sizes (7, 9, 11, 15 and 19 RGB pixels) use kernels unrolled for that length. The result is exact. */
+  uint64_t SumOfSquaredDifferences(const unsigned char* const a, const unsigned char* const b,
+                                   const unsigned int length);
+
+  /** The name of the instruction set SumOfSquaredDifferences uses on this CPU ("AVX2", "SSE4.1" or "Scalar"). */
+  const char* GetInstructionSetName();
+
+  /** The SSD between two regions of an image, stopping (checked once per row) once it exceeds 'bound'.
+    * See BoundedPatchDistance::BoundedDistance for the meaning of the return value. */
+  template <typename TImage>
+  float BoundedSSD(const TImage* const image, const itk::ImageRegion<2>& region1,
+                   const itk::ImageRegion<2>& region2, const float bound);
+
+  /** BoundedSSD for interleaved 8-bit RGB images, which reads the rows directly from the pixel buffer
+    * and uses SumOfSquaredDifferences. It returns exactly the same values as the generic version. */
+  float BoundedSSD(const RGBImageType* const image, const itk::ImageRegion<2>& region1,
+                   const itk::ImageRegion<2>& region2, const float bound);
+
+  /** BoundedSSD between the target region and the region of the same size at each of the source corners (see
+    * BatchPatchDistance::BatchDistance). The pixels of the target are copied into a contiguous buffer once. */
+  template <typename TImage>
+  void BatchBoundedSSD(const TImage* const image, const itk::ImageRegion<2>& targetRegion,
+                       const itk::Index<2>* const sourceCorners, const unsigned int numberOfSources,
+                       const float bound, float* const distances);
+
+  /** BatchBoundedSSD for interleaved 8-bit RGB images, which uses SumOfSquaredDifferences. It returns exactly the
+    * same values as BoundedSSD. */
+  void BatchBoundedSSD(const RGBImageType* const image, const itk::ImageRegion<2>& targetRegion,
+                       const itk::Index<2>* const sourceCorners, const unsigned int numberOfSources,
+                       const float bound, float* const distances);
+}
+
+template <typename TImage>
+float SSDKernels::BoundedSSD(const TImage* const image, const itk::ImageRegion<2>& region1,
+                             const itk::ImageRegion<2>& region2, const float bound)
+{
+  if(region1.GetSize() != region2.GetSize())
+  {
+    throw std::runtime_error("BoundedSSD: The regions must be the same size!");
+  }
+
+  itk::ImageRegionConstIterator<TImage> iterator1(image, region1);
+  itk::ImageRegionConstIterator<TImage> iterator2(image, region2);
+
+  const unsigned int numberOfComponents = image->GetNumberOfComponentsPerPixel();
+  const unsigned int rowLength = region1.GetSize()[0];
+  const unsigned int numberOfRows = region1.GetSize()[1];
+
+  double sum = 0;
+  for(unsigned int row = 0; row < numberOfRows; ++row)
+  {
+    for(unsigned int column = 0; column < rowLength; ++column)
+    {
+      typename TImage::PixelType pixel1 = iterator1.Get();
+      typename TImage::PixelType pixel2 = iterator2.Get();
+      for(unsigned int component = 0; component < numberOfComponents; ++component)
+      {
+        double difference = static_cast<double>(pixel1[component]) - static_cast<double>(pixel2[component]);
+        sum += difference * difference;
+      }
+      ++iterator1;
+      ++iterator2;
+    }
+
+    // The sum can only grow, so once it passes the bound the remaining rows cannot change the outcome.
+    // The comparison is done after rounding to float, the same as the final result is rounded.
+    if(static_cast<float>(sum) > bound && row + 1 < numberOfRows)
+    {
+      return std::numeric_limits<float>::infinity();
+    }
+  }
+
+  return static_cast<float>(sum);
+}
+
+template <typename TImage>
+void SSDKernels::BatchBoundedSSD(const TImage* const image, const itk::ImageRegion<2>& targetRegion,
+                                 const itk::Index<2>* const sourceCorners, const unsigned int numberOfSources,
+                                 const float bound, float* const distances)
+{
+  const unsigned int numberOfComponents = image->GetNumberOfComponentsPerPixel();
+  const unsigned int rowLength = targetRegion.GetSize()[0];
+  const unsigned int numberOfRows = targetRegion.GetSize()[1];
+
+  // The target values, in the order they are visited.
+  std::vector<double> targetValues(static_cast<size_t>(targetRegion.GetNumberOfPixels()) * numberOfComponents);
+  itk::ImageRegionConstIterator<TImage> targetIterator(image, targetRegion);
+  for(size_t valueId = 0; !targetIterator.IsAtEnd(); ++targetIterator)
+  {
+    typename TImage::PixelType pixel = targetIterator.Get();
+    for(unsigned int component = 0; component < numberOfComponents; ++component, ++valueId)
+    {
+      targetValues[valueId] = static_cast<double>(pixel[component]);
+    }
+  }
+
+  itk::ImageRegion<2> sourceRegion(targetRegion.GetSize());
+  for(unsigned int sourceId = 0; sourceId < numberOfSources; ++sourceId)
+  {
+    sourceRegion.SetIndex(sourceCorners[sourceId]);
+    itk::ImageRegionConstIterator<TImage> sourceIterator(image, sourceRegion);
+
+    // The same order of operations as BoundedSSD, so the results are identical.
+    double sum = 0;
+    size_t valueId = 0;
+    distances[sourceId] = std::numeric_limits<float>::infinity();
+    bool stopped = false;
+    for(unsigned int row = 0; row < numberOfRows && !stopped; ++row)
+    {
+      for(unsigned int column = 0; column < rowLength; ++column, ++sourceIterator)
+      {
+        typename TImage::PixelType pixel = sourceIterator.Get();
+        for(unsigned int component = 0; component < numberOfComponents; ++component, ++valueId)
+        {
+          double difference = static_cast<double>(pixel[component]) - targetValues[valueId];
+          sum += difference * difference;
+        }
+      }
+
+      stopped = static_cast<float>(sum) > bound && row + 1 < numberOfRows;
+    }
+
+    if(!stopped)
+    {
+      distances[sourceId] = static_cast<float>(sum);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef SearchBackend_H
+#define SearchBackend_H
+
+// Qt
+#include <QAtomicInt>
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <string>
+#include <vector>
+
+// Submodules
+#include "PatchComparison/Mask/Mask.h"
+#include "PatchComparison/PatchDistance.h"
+#include "PatchComparison/SelfPatchCompare.h"
+
+// Custom
+#include "TopPatchCollector.h"
+#include "ValidSourceCornerList.h"
+
+/** A way other than the exhaustive scan for ParallelSelfPatchCompare to find the best source patches of a target
+  * patch (see ParallelSelfPatchCompare::BackendEnum). A backend may keep data (e.g. a spectrum, a field, an index,
+  * or a pyramid) between queries, but is told everything about each query when it is run. A backend that cannot
+  * answer a query says why, and ParallelSelfPatchCompare scans exhaustively instead.
+  */
+template <typename TImage>
+class SearchBackend
+{
+public:
+
+  /** The (source region, score) pairs that are produced. */
+  typedef typename SelfPatchCompare<TImage>::PatchDataType PatchDataType;
+
+  /** Everything about one query. */
+  struct Query
+  {
+    /** The image to search. */
+    TImage* Image;
+
+    /** The mask, or NULL if every pixel is valid. */
+    Mask* MaskImage;
+
+    /** The corners of the entirely valid source patches of the size of the target, or NULL if every pixel is
+      * valid. It is up to date. */
+    const ValidSourceCornerList* ValidSourceCorners;
+
+    /** The query/target region. */
+    itk::ImageRegion<2> TargetRegion;
+
+    /** The functor that scores the patches. */
+    PatchDistance<TImage>* PatchDistanceFunctor;
+
+    /** The number of best patches to keep (0 means all). */
+    unsigned int NumberOfPatchesToKeep;
+  };
+
+  /** Destructor. */
+  virtual ~SearchBackend(){}
+
+  /** True if the backend can rank patches with this functor at all. */
+  virtual bool SupportsPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor) const = 0;
+
+  /** True if the backend can answer the query. If not, 'reason' is set to why. This may build data that is kept
+    * between queries. */
+  virtual bool CanComputePatchScores(const Query& query, std::string& reason) = 0;
+
+  /** Find the best source patches of the query, best first. Only called if CanComputePatchScores() is true for the
+    * query. Returns no patches if the search is canceled. */
+  virtual std::vector<PatchDataType> ComputePatchScores(const Query& query) = 0;
+
+  /** Set a flag that the backend checks while it works. When it becomes non-zero, ComputePatchScores() returns soon
+    * after. NULL (the default) means the search cannot be canceled. */
+  virtual void SetCancelFlag(const QAtomicInt* const cancelFlag) = 0;
+
+  /** Get the position of a source patch corner in the raster scan of the image, used to break ties. */
+  static size_t GetRasterOrder(const TImage* const image, const itk::Index<2>& corner);
+
+  /** Add the scores of the valid source patches of the query from a map of the scores of every corner of the image
+    * (see FFTSSDScoreMap::ComputeScores()) to a collector, skipping those above 'maximumScore'. */
+  static void AddScoreMap(const Query& query, const std::vector<double>& scores, const itk::Size<2>& scoreSize,
+                          const double maximumScore, TopPatchCollector<PatchDataType>& collector);
+};
+
+#include "SearchBackend.hpp"
+
+#endif
@@ -0,0 +1,79 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef SearchBackend_HPP
+#define SearchBackend_HPP
+
+#include "SearchBackend.h"
+
+template <typename TImage>
+size_t SearchBackend<TImage>::GetRasterOrder(const TImage* const image, const itk::Index<2>& corner)
+{
+  itk::ImageRegion<2> fullRegion = image->GetLargestPossibleRegion();
+  return (corner[1] - fullRegion.GetIndex()[1]) * fullRegion.GetSize()[0] + (corner[0] - fullRegion.GetIndex()[0]);
+}
+
+template <typename TImage>
+void SearchBackend<TImage>::AddScoreMap(const Query& query, const std::vector<double>& scores,
+                                        const itk::Size<2>& scoreSize, const double maximumScore,
+                                        TopPatchCollector<PatchDataType>& collector)
+{
+  itk::ImageRegion<2> fullRegion = query.Image->GetLargestPossibleRegion();
+  itk::ImageRegion<2> sourceRegion(query.TargetRegion.GetSize());
+
+  for(unsigned int row = 0; row < scoreSize[1]; ++row)
+  {
+    const itk::IndexValueType imageRow = fullRegion.GetIndex()[1] + row;
+    const size_t rowRasterOrder = static_cast<size_t>(row) * fullRegion.GetSize()[0];
+
+    // The scores are rounded the same way as the SSD functors, so the results match the exhaustive scan.
+    if(!query.ValidSourceCorners)
+    {
+      // The score map has a score for every corner of the row.
+      for(unsigned int column = 0; column < scoreSize[0]; ++column)
+      {
+        const double score = scores[row * scoreSize[0] + column];
+        if(score > maximumScore)
+        {
+          continue;
+        }
+        itk::Index<2> sourceCorner = {{fullRegion.GetIndex()[0] + column, imageRow}};
+        sourceRegion.SetIndex(sourceCorner);
+        collector.Add(PatchDataType(sourceRegion, static_cast<float>(score)), rowRasterOrder + column);
+      }
+      continue;
+    }
+
+    unsigned int numberOfRowCorners = 0;
+    const itk::Index<2>* rowCorners = query.ValidSourceCorners->GetRowCorners(imageRow, numberOfRowCorners);
+    for(unsigned int cornerId = 0; cornerId < numberOfRowCorners; ++cornerId)
+    {
+      unsigned int column = rowCorners[cornerId][0] - fullRegion.GetIndex()[0];
+      const double score = scores[row * scoreSize[0] + column];
+      if(score > maximumScore)
+      {
+        continue;
+      }
+      sourceRegion.SetIndex(rowCorners[cornerId]);
+      collector.Add(PatchDataType(sourceRegion, static_cast<float>(score)), rowRasterOrder + column);
+    }
+  }
+}
+
+#endif
@@ -32,6 +32,7 @@
 
 // Custom
 #include "PatchComparison/SelfPatchCompare.h"
+#include "PatchThumbnailCache.h"
 
 template <typename TImage>
 class TableModelTopPatches : public QAbstractTableModel
@@ -47,7 +48,9 @@ public:
   /** Return the number of columns.*/
   int columnCount(const QModelIndex& parent) const;
 
-  /** Display the data.*/
+  /** Display the data. The size of the patch cells (Qt::SizeHintRole) is the patch display size, so it is
+    * reported without rendering the patch. Each patch is rendered once per display size and then drawn from the
+    * thumbnail cache.*/
   QVariant data(const QModelIndex& index, int role) const;
 
   /** Display the headers.*/
@@ -58,7 +61,7 @@ public:
 
   /** Set the maximum number of patches to display. This function is not just called SetTopPatchesToDisplay
     * because if the number of total patches is less than this, the number of total patches is used as the number of
-    * patches to display. */
+    * patches to display. The rows that appear or disappear are inserted or removed. */
   void SetMaxTopPatchesToDisplay(const unsigned int maxTopPatchesToDisplay);
 
   /** Respond when the user clicks a row.*/
@@ -70,17 +73,33 @@ public:
   /** Set the size to display the patches.*/
   void SetPatchDisplaySize(const unsigned int value);
 
+  /** Get the size to display the patches.*/
+  unsigned int GetPatchDisplaySize() const;
+
   /** Set the image from which to get the patches.*/
   void SetImage(TImage* const image);
 
   /** Set the data for the top patches.*/
   void SetTopPatchData(const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>& topPatchData);
 
+  /** Replace the data for the top patches without resetting the model. Only the rows that change are updated, and
+    * rows are inserted or removed at the end, so the view keeps its scroll position and selection. This is used to
+    * show partial results while the top patches are still being computed. */
+  void UpdateTopPatchData(const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>& topPatchData);
+
   /** Get the data for the top patches.*/
   std::vector<typename SelfPatchCompare<TImage>::PatchDataType> GetTopPatchData();
 
+  /** Set the cache of the rendered patches (which is not owned). By default the shared cache is used, so the
+    * models of several widgets showing the same image render each patch once. */
+  void SetThumbnailCache(PatchThumbnailCache* const thumbnailCache);
+
 private:
 
+  /** Replace the data and the maximum number of rows, and notify the views of the rows that changed. */
+  void ReplaceRows(const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>& topPatchData,
+                   const unsigned int maxTopPatchesToDisplay);
+
   /** The size to draw the patches in the table. */
   // TODO: This should be set by the size of the target patch, or a multiplier, or something
   unsigned int PatchDisplaySize;
@@ -93,6 +112,9 @@ private:
 
   /** The image from which to get the patches.*/
   TImage* Image;
+
+  /** The rendered patches.*/
+  PatchThumbnailCache* ThumbnailCache;
 };
 
 #include "TableModelTopPatches.hpp"
@@ -34,7 +34,7 @@ template <typename TImage>
 TableModelTopPatches<TImage>::TableModelTopPatches(
     const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>& patchData, QObject * parent) :
     QAbstractTableModel(parent), PatchDisplaySize(20), MaxTopPatchesToDisplay(0),
-    TopPatchData(patchData), Image(NULL)
+    TopPatchData(patchData), Image(NULL), ThumbnailCache(PatchThumbnailCache::GetSharedCache())
 {
 }
 
@@ -44,6 +44,12 @@ void TableModelTopPatches<TImage>::SetPatchDisplaySize(const unsigned int value)
   this->PatchDisplaySize = value;
 }
 
+template <typename TImage>
+unsigned int TableModelTopPatches<TImage>::GetPatchDisplaySize() const
+{
+  return this->PatchDisplaySize;
+}
+
 template <typename TImage>
 Qt::ItemFlags TableModelTopPatches<TImage>::flags(const QModelIndex& index) const
 {
@@ -69,13 +75,18 @@ int TableModelTopPatches<TImage>::columnCount(const QModelIndex& parent) const
 template <typename TImage>
 void TableModelTopPatches<TImage>::SetMaxTopPatchesToDisplay(const unsigned int maxTopPatchesToDisplay)
 {
-  this->MaxTopPatchesToDisplay = maxTopPatchesToDisplay;
+  ReplaceRows(this->TopPatchData, maxTopPatchesToDisplay);
 }
 
 template <typename TImage>
 QVariant TableModelTopPatches<TImage>::data(const QModelIndex& index, int role) const
 {
   QVariant returnValue;
+  if(role == Qt::SizeHintRole && index.column() == 0)
+    {
+    return QSize(this->PatchDisplaySize, this->PatchDisplaySize);
+    }
+
   if(role == Qt::DisplayRole && index.row() >= 0)
     {
     itk::ImageRegion<2> sourceRegion = this->TopPatchData[index.row()].first;
@@ -84,11 +95,10 @@ QVariant TableModelTopPatches<TImage>::data(const QModelIndex& index, int role)
       {
       case 0:
         {
-        QImage patchImage = ITKQtHelpers::GetQImageColor(this->Image, sourceRegion);
-
-        patchImage = patchImage.scaledToHeight(this->PatchDisplaySize);
-
-        returnValue = QPixmap::fromImage(patchImage);
+        // The cache is keyed by the region and the display size (and the image and its MTime), so the patches of
+        // new top patch data or a new display size are rendered when they are first drawn, and the old ones are
+        // evicted when the cache is full.
+        returnValue = this->ThumbnailCache->GetThumbnail(this->Image, sourceRegion, this->PatchDisplaySize);
         break;
         }
       case 1:
@@ -147,6 +157,13 @@ void TableModelTopPatches<TImage>::SetImage(TImage* const image)
   this->Image = image;
 }
 
+template <typename TImage>
+void TableModelTopPatches<TImage>::SetThumbnailCache(PatchThumbnailCache* const thumbnailCache)
+{
+  this->ThumbnailCache = thumbnailCache;
+  Refresh();
+}
+
 template <typename TImage>
 void TableModelTopPatches<TImage>::SetTopPatchData(
   const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>& topPatchData)
@@ -156,6 +173,63 @@ void TableModelTopPatches<TImage>::SetTopPatchData(
   Refresh();
 }
 
+template <typename TImage>
+void TableModelTopPatches<TImage>::UpdateTopPatchData(
+  const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>& topPatchData)
+{
+  ReplaceRows(topPatchData, this->MaxTopPatchesToDisplay);
+}
+
+template <typename TImage>
+void TableModelTopPatches<TImage>::ReplaceRows(
+  const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>& topPatchData,
+  const unsigned int maxTopPatchesToDisplay)
+{
+  const int oldNumberOfRows = std::min<size_t>(this->TopPatchData.size(), this->MaxTopPatchesToDisplay);
+  const int newNumberOfRows = std::min<size_t>(topPatchData.size(), maxTopPatchesToDisplay);
+
+  // Find the range of the rows that are displayed both before and after, but show a different patch.
+  int firstChangedRow = -1;
+  int lastChangedRow = -1;
+  for(int row = 0; row < std::min(oldNumberOfRows, newNumberOfRows); ++row)
+  {
+    if(this->TopPatchData[row].first != topPatchData[row].first ||
+       this->TopPatchData[row].second != topPatchData[row].second)
+    {
+      if(firstChangedRow < 0)
+      {
+        firstChangedRow = row;
+      }
+      lastChangedRow = row;
+    }
+  }
+
+  if(newNumberOfRows > oldNumberOfRows)
+  {
+    beginInsertRows(QModelIndex(), oldNumberOfRows, newNumberOfRows - 1);
+    this->TopPatchData = topPatchData;
+    this->MaxTopPatchesToDisplay = maxTopPatchesToDisplay;
+    endInsertRows();
+  }
+  else if(newNumberOfRows < oldNumberOfRows)
+  {
+    beginRemoveRows(QModelIndex(), newNumberOfRows, oldNumberOfRows - 1);
+    this->TopPatchData = topPatchData;
+    this->MaxTopPatchesToDisplay = maxTopPatchesToDisplay;
+    endRemoveRows();
+  }
+  else
+  {
+    this->TopPatchData = topPatchData;
+    this->MaxTopPatchesToDisplay = maxTopPatchesToDisplay;
+  }
+
+  if(firstChangedRow >= 0)
+  {
+    emit dataChanged(index(firstChangedRow, 0), index(lastChangedRow, columnCount(QModelIndex()) - 1));
+  }
+}
+
 template <typename TImage>
 std::vector<typename SelfPatchCompare<TImage>::PatchDataType>
 TableModelTopPatches<TImage>::GetTopPatchData()
@@ -28,16 +28,25 @@
 #include "ITKQtHelpers/ITKQtHelpers.h"
 
 TableModelViewAllMatches::TableModelViewAllMatches(QObject * parent) :
-QAbstractTableModel(parent), PatchDisplaySize(20), MaxPairsToDisplay(0), Image(NULL)
+QAbstractTableModel(parent), PatchDisplaySize(20), MaxPairsToDisplay(0), PairFile(NULL), Image(NULL),
+ThumbnailCache(PatchThumbnailCache::GetSharedCache()), NumberOfPrefetchRows(100)
 {
 }
 
 TableModelViewAllMatches::TableModelViewAllMatches(ImageType* const image,
     const std::vector<PairType>& allPairs, QObject * parent) :
     QAbstractTableModel(parent), PatchDisplaySize(20), MaxPairsToDisplay(0),
-    AllPairs(allPairs), Image(image)
+    AllPairs(allPairs), PairFile(NULL), Image(image),
+    ThumbnailCache(PatchThumbnailCache::GetSharedCache()), NumberOfPrefetchRows(100)
+{
+}
+
+TableModelViewAllMatches::TableModelViewAllMatches(ImageType* const image,
+    const MatchPairFile* const pairFile, QObject * parent) :
+    QAbstractTableModel(parent), PatchDisplaySize(20), MaxPairsToDisplay(0),
+    PairFile(pairFile), Image(image),
+    ThumbnailCache(PatchThumbnailCache::GetSharedCache()), NumberOfPrefetchRows(100)
 {
-  std::cout << "There are " << this->AllPairs.size() << " pairs." << std::endl;
 }
 
 void TableModelViewAllMatches::SetPatchDisplaySize(const unsigned int value)
@@ -45,6 +54,11 @@ void TableModelViewAllMatches::SetPatchDisplaySize(const unsigned int value)
   this->PatchDisplaySize = value;
 }
 
+unsigned int TableModelViewAllMatches::GetPatchDisplaySize() const
+{
+  return this->PatchDisplaySize;
+}
+
 Qt::ItemFlags TableModelViewAllMatches::flags(const QModelIndex& index) const
 {
   //Qt::ItemFlags itemFlags = (!Qt::ItemIsEditable) | Qt::ItemIsSelectable | Qt::ItemIsEnabled | (!Qt::ItemIsUserCheckable) | (!Qt::ItemIsTristate);
@@ -54,7 +68,7 @@ Qt::ItemFlags TableModelViewAllMatches::flags(const QModelIndex& index) const
 
 int TableModelViewAllMatches::rowCount(const QModelIndex& parent) const
 {
-  unsigned int numberOfRowsToDisplay = std::min(this->AllPairs.size(), this->MaxPairsToDisplay);
+  unsigned int numberOfRowsToDisplay = std::min<size_t>(GetNumberOfPairs(), this->MaxPairsToDisplay);
 
   //std::cout << "There are " << numberOfRowsToDisplay << " rows to display." << std::endl;
   return numberOfRowsToDisplay;
@@ -76,8 +90,13 @@ QVariant TableModelViewAllMatches::data(const QModelIndex& index, int role) cons
   //std::cout << "data()" << std::endl;
   QVariant returnValue;
 
+  if(role == Qt::SizeHintRole && (index.column() == 1 || index.column() == 2))
+    {
+    return QSize(this->PatchDisplaySize, this->PatchDisplaySize);
+    }
+
   if(role == Qt::DisplayRole && index.row() >= 0 &&
-     index.row() < static_cast<int>(this->AllPairs.size()) &&
+     static_cast<size_t>(index.row()) < GetNumberOfPairs() &&
      index.row() < static_cast<int>(this->MaxPairsToDisplay))
     {
     switch(index.column())
@@ -88,21 +107,21 @@ QVariant TableModelViewAllMatches::data(const QModelIndex& index, int role) cons
         break;
         }
       case 1:
-        {
-        itk::ImageRegion<2> targetRegion = this->AllPairs[index.row()].first;
-        //std::cout << "Target region: " << targetRegion << std::endl;
-        QImage patchImage = ITKQtHelpers::GetQImageColor(this->Image, targetRegion);
-        patchImage = patchImage.scaledToHeight(this->PatchDisplaySize);
-        returnValue = QPixmap::fromImage(patchImage);
-        break;
-        }
       case 2:
         {
-        itk::ImageRegion<2> sourceRegion = this->AllPairs[index.row()].second;
-        //std::cout << "Source region: " << sourceRegion << std::endl;
-        QImage patchImage = ITKQtHelpers::GetQImageColor(this->Image, sourceRegion);
-        patchImage = patchImage.scaledToHeight(this->PatchDisplaySize);
-        returnValue = QPixmap::fromImage(patchImage);
+        itk::ImageRegion<2> region = GetCellRegion(index.row(), index.column());
+        QPixmap thumbnail;
+        if(!this->ThumbnailCache->GetCachedThumbnail(
+             PatchThumbnailCache::CreateKey(this->Image, region, this->PatchDisplaySize), thumbnail))
+        {
+          // Rendering here would stall the view, so the thumbnail is left to the workers (see PrefetchRows).
+          if(this->Placeholder.height() != static_cast<int>(this->PatchDisplaySize))
+          {
+            this->Placeholder = PatchThumbnailCache::GetPlaceholder(region, this->PatchDisplaySize);
+          }
+          thumbnail = this->Placeholder;
+        }
+        returnValue = thumbnail;
         break;
         }
       } // end switch
@@ -145,6 +164,7 @@ void TableModelViewAllMatches::Refresh()
 
 void TableModelViewAllMatches::SetImage(ImageType* const image)
 {
+  ReleaseImage();
   this->Image = image;
   Refresh();
 }
@@ -152,6 +172,96 @@ void TableModelViewAllMatches::SetImage(ImageType* const image)
 void TableModelViewAllMatches::SetTopPatchData(const std::vector<PairType>& topPatchData)
 {
   this->AllPairs = topPatchData;
+  this->PairFile = NULL;
 
   Refresh();
 }
+
+void TableModelViewAllMatches::SetPairFile(const MatchPairFile* const pairFile)
+{
+  this->PairFile = pairFile;
+  this->AllPairs.clear();
+
+  Refresh();
+}
+
+void TableModelViewAllMatches::SetThumbnailCache(PatchThumbnailCache* const thumbnailCache)
+{
+  this->ThumbnailCache = thumbnailCache;
+  Refresh();
+}
+
+PatchThumbnailCache* TableModelViewAllMatches::GetThumbnailCache() const
+{
+  return this->ThumbnailCache;
+}
+
+void TableModelViewAllMatches::SetNumberOfPrefetchRows(const unsigned int numberOfPrefetchRows)
+{
+  this->NumberOfPrefetchRows = numberOfPrefetchRows;
+}
+
+void TableModelViewAllMatches::PrefetchRows(const int firstVisibleRow, const int lastVisibleRow)
+{
+  this->ThumbnailCache->CancelPendingRequests();
+
+  const int numberOfRows = rowCount(QModelIndex());
+  if(!this->Image || numberOfRows == 0)
+  {
+    return;
+  }
+
+  const int firstRow = std::max(0, firstVisibleRow);
+  const int lastRow = std::min(numberOfRows - 1, lastVisibleRow);
+  const int numberOfPrefetchRows = static_cast<int>(this->NumberOfPrefetchRows);
+
+  // The workers start the requests in order, so the visible rows are requested first, then the rows after them
+  // (the usual scroll direction), then the rows before them.
+  for(int row = firstRow; row <= lastRow; ++row)
+  {
+    for(int column = 1; column <= 2; ++column)
+    {
+      this->ThumbnailCache->RequestThumbnail(this->Image, GetCellRegion(row, column), this->PatchDisplaySize);
+    }
+  }
+
+  for(int row = lastRow + 1; row < std::min(numberOfRows, lastRow + 1 + numberOfPrefetchRows); ++row)
+  {
+    for(int column = 1; column <= 2; ++column)
+    {
+      this->ThumbnailCache->RequestThumbnail(this->Image, GetCellRegion(row, column), this->PatchDisplaySize);
+    }
+  }
+
+  for(int row = firstRow - 1; row >= std::max(0, firstRow - numberOfPrefetchRows); --row)
+  {
+    for(int column = 1; column <= 2; ++column)
+    {
+      this->ThumbnailCache->RequestThumbnail(this->Image, GetCellRegion(row, column), this->PatchDisplaySize);
+    }
+  }
+}
+
+void TableModelViewAllMatches::ReleaseImage()
+{
+  if(this->Image)
+  {
+    this->ThumbnailCache->RemoveImage(this->Image);
+  }
+}
+
+itk::ImageRegion<2> TableModelViewAllMatches::GetCellRegion(const int row, const int column) const
+{
+  PairType pair = GetPair(row);
+  return column == 1 ? pair.first : pair.second;
+}
+
+size_t TableModelViewAllMatches::GetNumberOfPairs() const
+{
+  return this->PairFile ? this->PairFile->GetNumberOfPairs() : this->AllPairs.size();
+}
+
+TableModelViewAllMatches::PairType TableModelViewAllMatches::GetPair(const size_t pairId) const
+{
+  return this->PairFile ? this->PairFile->GetPair(pairId) : this->AllPairs[pairId];
+}
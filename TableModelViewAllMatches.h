@@ -30,6 +30,10 @@
 // STL
 #include <vector>
 
+// Custom
+#include "MatchPairFile.h"
+#include "PatchThumbnailCache.h"
+
 class TableModelViewAllMatches : public QAbstractTableModel
 {
 public:
@@ -46,13 +50,19 @@ public:
   TableModelViewAllMatches(ImageType* const image, const std::vector<PairType>& allPairs,
                            QObject * parent);
 
+  /** Constructor that displays the pairs of a mapped pair file (which is not owned, and must stay open). The pairs
+    * are read from the file as they are displayed, so they are never copied. */
+  TableModelViewAllMatches(ImageType* const image, const MatchPairFile* const pairFile, QObject * parent);
+
   /** Report the number of rows to display */
   int rowCount(const QModelIndex& parent) const;
 
   /** Report the number of columns to display. */
   int columnCount(const QModelIndex& parent) const;
 
-  /** Draw the patches in the table. */
+  /** Draw the patches in the table. Patches whose thumbnails are not cached are drawn as placeholders until
+    * PrefetchRows has them rendered. The size of the patch cells (Qt::SizeHintRole) is the patch display size,
+    * so it is reported without rendering anything. */
   QVariant data(const QModelIndex& index, int role) const;
 
   /** Setup the column headers. */
@@ -70,14 +80,46 @@ public:
   /** Set the size of the patches to display */
   void SetPatchDisplaySize(const unsigned int value);
 
+  /** Get the size of the patches to display. Every patch cell is this size (see Qt::SizeHintRole in data()). */
+  unsigned int GetPatchDisplaySize() const;
+
   /** Set the image from which to extract the patches */
   void SetImage(ImageType* const image);
 
   /** Set the pairs to display */
   void SetTopPatchData(const std::vector<PairType>& allPairs);
 
+  /** Display the pairs of a mapped pair file instead (which is not owned, and must stay open). */
+  void SetPairFile(const MatchPairFile* const pairFile);
+
+  /** Set the cache of the thumbnails (which is not owned). By default the shared cache is used. */
+  void SetThumbnailCache(PatchThumbnailCache* const thumbnailCache);
+
+  /** Get the cache of the thumbnails, e.g. to repaint the views when thumbnails are ready. */
+  PatchThumbnailCache* GetThumbnailCache() const;
+
+  /** Render the thumbnails of the rows that are visible, and of the rows within the prefetch window around them,
+    * in the background. The requests for other rows that have not started are canceled. */
+  void PrefetchRows(const int firstVisibleRow, const int lastVisibleRow);
+
+  /** Set the number of rows before and after the visible rows that PrefetchRows renders. */
+  void SetNumberOfPrefetchRows(const unsigned int numberOfPrefetchRows);
+
+  /** Wait for the thumbnails being rendered and remove the thumbnails of the image, which must be done before the
+    * image is modified or deleted. */
+  void ReleaseImage();
+
 private:
 
+  /** Get the number of pairs, from the pair file if there is one. */
+  size_t GetNumberOfPairs() const;
+
+  /** Get a pair, from the pair file if there is one. */
+  PairType GetPair(const size_t pairId) const;
+
+  /** Get the region a cell displays. */
+  itk::ImageRegion<2> GetCellRegion(const int row, const int column) const;
+
   /** This is how big to draw the patches in the table. */
   // TODO: This should be set by the size of the target patch, or a multiplier, or something
   unsigned int PatchDisplaySize;
@@ -88,8 +130,20 @@ private:
   /** The pairs to display */
   std::vector<PairType> AllPairs;
 
+  /** The file of the pairs to display, which replaces AllPairs if it is set. */
+  const MatchPairFile* PairFile;
+
   /** The image from which to extract the pair regions. */
   ImageType* Image;
+
+  /** The rendered thumbnails. */
+  PatchThumbnailCache* ThumbnailCache;
+
+  /** The number of rows before and after the visible rows to render. */
+  unsigned int NumberOfPrefetchRows;
+
+  /** The placeholder of the patches that are not rendered yet, which is created once per size. */
+  mutable QPixmap Placeholder;
 };
 
 #endif
@@ -0,0 +1,115 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+/** Writes pairs the way BatchMatcher does (MatchPairFile::MakeRecord() and MatchPairFile::Write()), maps the file
+  * again and checks that every pair and score reads back unchanged. Returns EXIT_FAILURE if anything differs.
+  */
+
+// Qt
+#include <QFile>
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Custom
+#include "MatchPairFile.h"
+
+/** Write numberOfPairs pairs of patches with the given radius, read them back and compare. */
+static bool TestRoundTrip(const std::string& fileName, const unsigned int patchRadius, const size_t numberOfPairs)
+{
+  const itk::Size<2> patchSize = {{2 * patchRadius + 1, 2 * patchRadius + 1}};
+
+  std::vector<MatchPairFile::PairType> pairs;
+  std::vector<float> scores;
+  std::vector<MatchPairFile::Record> records;
+  for(size_t pairId = 0; pairId < numberOfPairs; ++pairId)
+  {
+    const itk::Index<2> targetCorner = {{static_cast<itk::IndexValueType>(pairId % 7),
+                                         static_cast<itk::IndexValueType>(pairId / 7)}};
+    const itk::Index<2> sourceCorner = {{static_cast<itk::IndexValueType>(3 * pairId + 1),
+                                         static_cast<itk::IndexValueType>(1000 - pairId)}};
+    pairs.push_back(MatchPairFile::PairType(itk::ImageRegion<2>(targetCorner, patchSize),
+                                            itk::ImageRegion<2>(sourceCorner, patchSize)));
+    scores.push_back(0.25f * pairId + 0.1f);
+    records.push_back(MatchPairFile::MakeRecord(pairs.back(), scores.back()));
+  }
+
+  MatchPairFile::Write(fileName, patchRadius, records);
+
+  bool passed = true;
+  if(!MatchPairFile::IsMatchPairFile(fileName))
+  {
+    std::cerr << fileName << " is not recognized as a pair file." << std::endl;
+    passed = false;
+  }
+
+  MatchPairFile pairFile;
+  pairFile.Open(fileName);
+  if(pairFile.GetNumberOfPairs() != numberOfPairs || pairFile.GetPatchRadius() != patchRadius)
+  {
+    std::cerr << "Read " << pairFile.GetNumberOfPairs() << " pairs of radius " << pairFile.GetPatchRadius()
+              << ", wrote " << numberOfPairs << " pairs of radius " << patchRadius << "." << std::endl;
+    passed = false;
+  }
+  else
+  {
+    for(size_t pairId = 0; pairId < numberOfPairs; ++pairId)
+    {
+      const MatchPairFile::PairType pair = pairFile.GetPair(pairId);
+      if(pair.first != pairs[pairId].first || pair.second != pairs[pairId].second ||
+         pairFile.GetRecord(pairId).Score != scores[pairId])
+      {
+        std::cerr << "Pair " << pairId << " was written as " << pairs[pairId].first << " " << pairs[pairId].second
+                  << " " << scores[pairId] << " but read as " << pair.first << " " << pair.second << " "
+                  << pairFile.GetRecord(pairId).Score << std::endl;
+        passed = false;
+        break;
+      }
+    }
+  }
+
+  pairFile.Close();
+  QFile::remove(QString::fromStdString(fileName));
+
+  return passed;
+}
+
+int main(int, char*[])
+{
+  const std::string fileName = "TestMatchPairFile.pairs";
+
+  bool passed = TestRoundTrip(fileName, 3, 100);
+  passed = TestRoundTrip(fileName, 7, 1) && passed;
+  passed = TestRoundTrip(fileName, 3, 0) && passed;
+
+  if(!passed)
+  {
+    std::cerr << "MatchPairFile does not read back what it wrote!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "MatchPairFile reads back what it wrote." << std::endl;
+  return EXIT_SUCCESS;
+}
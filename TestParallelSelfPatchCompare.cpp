@@ -0,0 +1,823 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+/** Compares ParallelSelfPatchCompare to the serial SelfPatchCompare (followed by a stable sort, which is the
+  * order ParallelSelfPatchCompare promises) on small synthetic masked images. The pixel values are small integers,
+  * so every SSD is exact in float and the scores must be identical, and parts of the image are copied so that
+  * there are ties. The exhaustive scan and incremental re-query are also run on random non-integer floats, and
+  * every backend is canceled part way through a search. Returns EXIT_FAILURE if any result differs.
+  */
+
+// Qt
+#include <QAtomicInt>
+
+// ITK
+#include "itkCovariantVector.h"
+#include "itkImage.h"
+#include "itkImageRegionIterator.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// C
+#include <stdint.h>
+
+// Submodules
+#include "PatchComparison/Mask/ITKHelpers/Helpers/Helpers.h"
+#include "PatchComparison/Mask/Mask.h"
+#include "PatchComparison/SelfPatchCompare.h"
+#include "PatchComparison/SSD.h"
+
+// Custom
+#include "BoundedPatchDistance.h"
+#include "ParallelSelfPatchCompare.h"
+#include "PartialSSD.h"
+#include "SSDKernels.h"
+
+/** An SSD that can stop early, but (unlike PartialSSD) does not compare patches in batches, so the tiled scan
+  * calls BoundedDistance() for every source patch. */
+template <typename TImage>
+class BoundedOnlySSD : public SSD<TImage>, public BoundedPatchDistance<TImage>
+{
+public:
+
+  float Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2)
+  {
+    return BoundedDistance(region1, region2, std::numeric_limits<float>::max());
+  }
+
+  float BoundedDistance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2, const float bound)
+  {
+    return SSDKernels::BoundedSSD(this->Image, region1, region2, bound);
+  }
+};
+
+/** An SSD that sets a cancel flag once it has compared a number of patches, so that a search is canceled part way
+  * through. */
+template <typename TImage>
+class CancelingSSD : public SSD<TImage>
+{
+public:
+
+  CancelingSSD(QAtomicInt* const cancelFlag, const int numberOfDistancesBeforeCancel) : CancelFlag(cancelFlag),
+  NumberOfDistancesBeforeCancel(numberOfDistancesBeforeCancel)
+  {
+  }
+
+  float Distance(const itk::ImageRegion<2>& region1, const itk::ImageRegion<2>& region2)
+  {
+    // This is called from several threads at once, so the count is atomic.
+    if(this->NumberOfDistances.fetchAndAddOrdered(1) + 1 == this->NumberOfDistancesBeforeCancel)
+    {
+      this->CancelFlag->fetchAndStoreOrdered(1);
+    }
+    return SSD<TImage>::Distance(region1, region2);
+  }
+
+  int GetNumberOfDistances() const
+  {
+    return this->NumberOfDistances;
+  }
+
+  void ResetNumberOfDistances()
+  {
+    this->NumberOfDistances = 0;
+  }
+
+private:
+
+  QAtomicInt* CancelFlag;
+
+  int NumberOfDistancesBeforeCancel;
+
+  QAtomicInt NumberOfDistances;
+};
+
+/** The size of the test images. */
+static const unsigned int ImageWidth = 48;
+static const unsigned int ImageHeight = 40;
+
+/** The pixels of the test images are in [0, NumberOfValues). */
+static const unsigned int NumberOfValues = 16;
+
+/** Create an image of small random values. Two blocks of it are copies of a third, so some patches are
+  * identical. */
+template <typename TImage>
+static typename TImage::Pointer CreateImage(const unsigned int seed)
+{
+  itk::Size<2> size = {{ImageWidth, ImageHeight}};
+  typename TImage::Pointer image = TImage::New();
+  image->SetRegions(itk::ImageRegion<2>(size));
+  image->Allocate();
+
+  std::mt19937 generator(seed);
+  const unsigned int numberOfComponents = image->GetNumberOfComponentsPerPixel();
+  itk::ImageRegionIterator<TImage> imageIterator(image, image->GetLargestPossibleRegion());
+  while(!imageIterator.IsAtEnd())
+  {
+    typename TImage::PixelType pixel = imageIterator.Get();
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      pixel[component] = generator() % NumberOfValues;
+    }
+    imageIterator.Set(pixel);
+    ++imageIterator;
+  }
+
+  const unsigned int blockSize = 12;
+  const itk::IndexValueType copyOffsets[2][2] = {{30, 4}, {4, 26}};
+  for(unsigned int copyId = 0; copyId < 2; ++copyId)
+  {
+    for(itk::IndexValueType row = 0; row < static_cast<itk::IndexValueType>(blockSize); ++row)
+    {
+      for(itk::IndexValueType column = 0; column < static_cast<itk::IndexValueType>(blockSize); ++column)
+      {
+        itk::Index<2> sourcePixel = {{2 + column, 2 + row}};
+        itk::Index<2> copyPixel = {{copyOffsets[copyId][0] + column, copyOffsets[copyId][1] + row}};
+        image->SetPixel(copyPixel, image->GetPixel(sourcePixel));
+      }
+    }
+  }
+
+  return image;
+}
+
+/** Create an image that repeats a small tile, so many patches are identical to each other. */
+template <typename TImage>
+static typename TImage::Pointer CreateRepeatedImage()
+{
+  itk::Size<2> size = {{ImageWidth, ImageHeight}};
+  typename TImage::Pointer image = TImage::New();
+  image->SetRegions(itk::ImageRegion<2>(size));
+  image->Allocate();
+
+  const unsigned int numberOfComponents = image->GetNumberOfComponentsPerPixel();
+  itk::ImageRegionIterator<TImage> imageIterator(image, image->GetLargestPossibleRegion());
+  while(!imageIterator.IsAtEnd())
+  {
+    typename TImage::PixelType pixel = imageIterator.Get();
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      pixel[component] = (imageIterator.GetIndex()[0] % 4 + 4 * (imageIterator.GetIndex()[1] % 3) + component) %
+                         NumberOfValues;
+    }
+    imageIterator.Set(pixel);
+    ++imageIterator;
+  }
+
+  return image;
+}
+
+/** Create a mask with a rectangular hole in the middle of the image. */
+static Mask::Pointer CreateMask()
+{
+  itk::Size<2> size = {{ImageWidth, ImageHeight}};
+  Mask::Pointer mask = Mask::New();
+  mask->SetRegions(itk::ImageRegion<2>(size));
+  mask->Allocate();
+  mask->FillBuffer(mask->GetValidValue());
+
+  for(itk::IndexValueType row = 14; row < 22; ++row)
+  {
+    for(itk::IndexValueType column = 18; column < 26; ++column)
+    {
+      itk::Index<2> pixel = {{column, row}};
+      mask->SetPixel(pixel, mask->GetHoleValue());
+    }
+  }
+
+  return mask;
+}
+
+/** The best patches found by the serial SelfPatchCompare with an SSD functor, stably sorted. */
+template <typename TImage>
+static std::vector<typename SelfPatchCompare<TImage>::PatchDataType>
+ComputeReferencePatchData(TImage* const image, Mask* const mask, const itk::ImageRegion<2>& targetRegion,
+                          const unsigned int numberOfPatchesToKeep)
+{
+  typedef typename SelfPatchCompare<TImage>::PatchDataType PatchDataType;
+
+  SSD<TImage> ssdFunctor;
+  ssdFunctor.SetImage(image);
+
+  SelfPatchCompare<TImage> selfPatchCompare;
+  selfPatchCompare.SetImage(image);
+  selfPatchCompare.SetMask(mask);
+  selfPatchCompare.SetTargetRegion(targetRegion);
+  selfPatchCompare.SetPatchDistanceFunctor(&ssdFunctor);
+  selfPatchCompare.ComputePatchScores();
+
+  std::vector<PatchDataType> patchData = selfPatchCompare.GetPatchData();
+  std::stable_sort(patchData.begin(), patchData.end(), Helpers::SortBySecondAccending<PatchDataType>);
+  if(numberOfPatchesToKeep > 0 && patchData.size() > numberOfPatchesToKeep)
+  {
+    patchData.resize(numberOfPatchesToKeep);
+  }
+
+  return patchData;
+}
+
+/** Check that two lists of patches are identical (the same regions in the same order, with the same scores). */
+template <typename TPatchData>
+static bool ComparePatchData(const std::string& testName, const std::vector<TPatchData>& referencePatchData,
+                             const std::vector<TPatchData>& patchData)
+{
+  if(patchData.size() != referencePatchData.size())
+  {
+    std::cerr << testName << ": Found " << patchData.size() << " patches instead of "
+              << referencePatchData.size() << "!" << std::endl;
+    return false;
+  }
+
+  for(size_t patchId = 0; patchId < patchData.size(); ++patchId)
+  {
+    if(patchData[patchId].first != referencePatchData[patchId].first ||
+       patchData[patchId].second != referencePatchData[patchId].second)
+    {
+      std::cerr << testName << ": Patch " << patchId << " is " << patchData[patchId].first.GetIndex()
+                << " with score " << patchData[patchId].second << " instead of "
+                << referencePatchData[patchId].first.GetIndex() << " with score "
+                << referencePatchData[patchId].second << "!" << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/** The target regions that are tested: corners near the image border, on the copied blocks, and overlapping
+  * the hole, with patch widths that do and do not have unrolled kernels. */
+static std::vector<itk::ImageRegion<2> > GetTargetRegions()
+{
+  const itk::IndexValueType corners[4][2] = {{3, 3}, {0, 0}, {15, 12}, {37, 29}};
+  const unsigned int patchSizes[4] = {7, 5, 9, 11};
+
+  std::vector<itk::ImageRegion<2> > targetRegions;
+  for(unsigned int cornerId = 0; cornerId < 4; ++cornerId)
+  {
+    for(unsigned int sizeId = 0; sizeId < 4; ++sizeId)
+    {
+      itk::Index<2> corner = {{corners[cornerId][0], corners[cornerId][1]}};
+      itk::Size<2> size = {{patchSizes[sizeId], patchSizes[sizeId]}};
+      targetRegions.push_back(itk::ImageRegion<2>(corner, size));
+    }
+  }
+
+  return targetRegions;
+}
+
+/** The EXHAUSTIVE backend with a functor without a bound, with a bound, and with a bound and batches, with and
+  * without the mask, keeping some or all of the patches. */
+template <typename TImage>
+static bool TestExhaustive(const std::string& imageName)
+{
+  typename TImage::Pointer image = CreateImage<TImage>(1);
+  Mask::Pointer holeMask = CreateMask();
+  Mask::Pointer fullyValidMask = Mask::New();
+  fullyValidMask->SetRegions(image->GetLargestPossibleRegion());
+  fullyValidMask->Allocate();
+  fullyValidMask->FillBuffer(fullyValidMask->GetValidValue());
+
+  SSD<TImage> ssdFunctor;
+  ssdFunctor.SetImage(image);
+  BoundedOnlySSD<TImage> boundedFunctor;
+  boundedFunctor.SetImage(image);
+  PartialSSD<TImage> partialSSDFunctor;
+  partialSSDFunctor.SetImage(image);
+
+  PatchDistance<TImage>* functors[3] = {&ssdFunctor, &boundedFunctor, &partialSSDFunctor};
+  const char* functorNames[3] = {"unbounded", "bounded", "batch"};
+  Mask* masks[2] = {holeMask, fullyValidMask};
+  const unsigned int numbersOfPatchesToKeep[3] = {1, 15, 0};
+
+  const std::vector<itk::ImageRegion<2> > targetRegions = GetTargetRegions();
+
+  bool passed = true;
+  for(unsigned int maskId = 0; maskId < 2; ++maskId)
+  {
+    for(size_t targetId = 0; targetId < targetRegions.size(); ++targetId)
+    {
+      for(unsigned int keepId = 0; keepId < 3; ++keepId)
+      {
+        std::vector<typename SelfPatchCompare<TImage>::PatchDataType> referencePatchData =
+          ComputeReferencePatchData(image.GetPointer(), masks[maskId], targetRegions[targetId],
+                                    numbersOfPatchesToKeep[keepId]);
+
+        for(unsigned int functorId = 0; functorId < 3; ++functorId)
+        {
+          // One row per tile gives the most tiles (and merges), and 0 is the automatic choice.
+          for(unsigned int rowsPerTile = 0; rowsPerTile < 2; ++rowsPerTile)
+          {
+            ParallelSelfPatchCompare<TImage> parallelSelfPatchCompare;
+            parallelSelfPatchCompare.SetImage(image);
+            if(maskId == 0)
+            {
+              parallelSelfPatchCompare.SetMask(holeMask);
+            }
+            else
+            {
+              parallelSelfPatchCompare.CreateFullyValidMask();
+            }
+            parallelSelfPatchCompare.SetPatchDistanceFunctor(functors[functorId]);
+            parallelSelfPatchCompare.SetNumberOfPatchesToKeep(numbersOfPatchesToKeep[keepId]);
+            parallelSelfPatchCompare.SetRowsPerTile(rowsPerTile);
+            parallelSelfPatchCompare.SetTargetRegion(targetRegions[targetId]);
+            parallelSelfPatchCompare.ComputePatchScores();
+
+            std::stringstream testName;
+            testName << imageName << " exhaustive " << functorNames[functorId] << (maskId == 0 ? " masked" : "")
+                     << " target " << targetRegions[targetId].GetIndex() << " size "
+                     << targetRegions[targetId].GetSize()[0] << " keep " << numbersOfPatchesToKeep[keepId]
+                     << " rows per tile " << rowsPerTile;
+            passed = ComparePatchData(testName.str(), referencePatchData, parallelSelfPatchCompare.GetPatchData()) &&
+                     passed;
+          }
+        }
+      }
+    }
+  }
+
+  return passed;
+}
+
+/** The FFT_SSD backend on one image. */
+template <typename TImage>
+static bool TestFFT(const std::string& imageName, TImage* const image)
+{
+  Mask::Pointer mask = CreateMask();
+
+  PartialSSD<TImage> ssdFunctor;
+  ssdFunctor.SetImage(image);
+
+  ParallelSelfPatchCompare<TImage> parallelSelfPatchCompare;
+  parallelSelfPatchCompare.SetImage(image);
+  parallelSelfPatchCompare.SetMask(mask);
+  parallelSelfPatchCompare.SetPatchDistanceFunctor(&ssdFunctor);
+  parallelSelfPatchCompare.SetBackend(ParallelSelfPatchCompare<TImage>::FFT_SSD);
+
+  const unsigned int numberOfPatchesToKeep = 15;
+  const std::vector<itk::ImageRegion<2> > targetRegions = GetTargetRegions();
+
+  bool passed = true;
+  for(size_t targetId = 0; targetId < targetRegions.size(); ++targetId)
+  {
+    parallelSelfPatchCompare.SetNumberOfPatchesToKeep(numberOfPatchesToKeep);
+    parallelSelfPatchCompare.SetTargetRegion(targetRegions[targetId]);
+    parallelSelfPatchCompare.ComputePatchScores();
+
+    std::stringstream testName;
+    testName << imageName << " FFT target " << targetRegions[targetId].GetIndex() << " size "
+             << targetRegions[targetId].GetSize()[0];
+
+    // A fallback to the exhaustive scan would match the reference without testing the FFT scores.
+    if(parallelSelfPatchCompare.GetUsedBackend() != ParallelSelfPatchCompare<TImage>::FFT_SSD)
+    {
+      std::cerr << testName.str() << ": the FFT_SSD backend was not used: "
+                << parallelSelfPatchCompare.GetFallbackReason() << std::endl;
+      passed = false;
+    }
+
+    passed = ComparePatchData(testName.str(),
+                              ComputeReferencePatchData(image, mask.GetPointer(), targetRegions[targetId],
+                                                        numberOfPatchesToKeep),
+                              parallelSelfPatchCompare.GetPatchData()) && passed;
+  }
+
+  return passed;
+}
+
+/** The FFT_SSD backend, whose candidates are re-scored with the functor, on a random image and on an image where
+  * many patches tie. */
+template <typename TImage>
+static bool TestFFT(const std::string& imageName)
+{
+  typename TImage::Pointer image = CreateImage<TImage>(2);
+  typename TImage::Pointer repeatedImage = CreateRepeatedImage<TImage>();
+
+  bool passed = TestFFT(imageName, image.GetPointer());
+  passed = TestFFT(imageName + " repeated", repeatedImage.GetPointer()) && passed;
+  return passed;
+}
+
+/** Incremental re-query: the scores of the previous query are updated as the target moves by a few pixels. */
+template <typename TImage>
+static bool TestIncremental(const std::string& imageName)
+{
+  typename TImage::Pointer image = CreateImage<TImage>(3);
+  Mask::Pointer mask = CreateMask();
+
+  PartialSSD<TImage> ssdFunctor;
+  ssdFunctor.SetImage(image);
+
+  ParallelSelfPatchCompare<TImage> parallelSelfPatchCompare;
+  parallelSelfPatchCompare.SetImage(image);
+  parallelSelfPatchCompare.SetMask(mask);
+  parallelSelfPatchCompare.SetPatchDistanceFunctor(&ssdFunctor);
+  parallelSelfPatchCompare.SetNumberOfPatchesToKeep(15);
+  parallelSelfPatchCompare.SetIncrementalRequery(true);
+
+  // The first query and the jump score every patch with the tiled scan, and the other moves are small shifts,
+  // which use the kept scores (on integer images only).
+  const unsigned int numberOfMoves = 8;
+  const itk::IndexValueType moves[numberOfMoves][2] = {{0, 0}, {1, 0}, {0, 1}, {-2, 1}, {2, -1}, {20, 15}, {-1, -1},
+                                                        {0, -2}};
+  const bool incremental[numberOfMoves] = {false, true, true, true, true, false, true, true};
+  itk::Index<2> corner = {{6, 5}};
+  itk::Size<2> size = {{7, 7}};
+
+  bool passed = true;
+  for(unsigned int moveId = 0; moveId < numberOfMoves; ++moveId)
+  {
+    corner[0] += moves[moveId][0];
+    corner[1] += moves[moveId][1];
+    itk::ImageRegion<2> targetRegion(corner, size);
+
+    const bool expectIncremental = incremental[moveId] && IncrementalSSDScoreMap<TImage>::IsExact();
+    if(parallelSelfPatchCompare.CanUpdateIncrementally(targetRegion) != expectIncremental)
+    {
+      std::cerr << imageName << " incremental: Move " << moveId << (expectIncremental ? " is not" : " is")
+                << " an incremental update!" << std::endl;
+      passed = false;
+    }
+
+    parallelSelfPatchCompare.SetTargetRegion(targetRegion);
+    parallelSelfPatchCompare.ComputePatchScores();
+
+    std::stringstream testName;
+    testName << imageName << " incremental target " << corner;
+    passed = ComparePatchData(testName.str(),
+                              ComputeReferencePatchData(image.GetPointer(), mask.GetPointer(), targetRegion, 15),
+                              parallelSelfPatchCompare.GetPatchData()) && passed;
+  }
+
+  return passed;
+}
+
+/** Create an image of random non-integer values, whose squared differences are not exact in float or double. */
+template <typename TImage>
+static typename TImage::Pointer CreateRandomFloatImage(const unsigned int seed)
+{
+  itk::Size<2> size = {{ImageWidth, ImageHeight}};
+  typename TImage::Pointer image = TImage::New();
+  image->SetRegions(itk::ImageRegion<2>(size));
+  image->Allocate();
+
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<float> distribution(0.0f, 255.0f);
+  const unsigned int numberOfComponents = image->GetNumberOfComponentsPerPixel();
+  itk::ImageRegionIterator<TImage> imageIterator(image, image->GetLargestPossibleRegion());
+  while(!imageIterator.IsAtEnd())
+  {
+    typename TImage::PixelType pixel = imageIterator.Get();
+    for(unsigned int component = 0; component < numberOfComponents; ++component)
+    {
+      pixel[component] = distribution(generator);
+    }
+    imageIterator.Set(pixel);
+    ++imageIterator;
+  }
+
+  return image;
+}
+
+/** Incremental re-query on an image of non-integer floats, for which updated scores would drift. Every move must
+  * give exactly the results of a query without kept scores. */
+template <typename TImage>
+static bool TestIncrementalFloat(const std::string& imageName)
+{
+  typename TImage::Pointer image = CreateRandomFloatImage<TImage>(5);
+  Mask::Pointer mask = CreateMask();
+
+  PartialSSD<TImage> ssdFunctor;
+  ssdFunctor.SetImage(image);
+
+  ParallelSelfPatchCompare<TImage> requerySelfPatchCompare;
+  requerySelfPatchCompare.SetImage(image);
+  requerySelfPatchCompare.SetMask(mask);
+  requerySelfPatchCompare.SetPatchDistanceFunctor(&ssdFunctor);
+  requerySelfPatchCompare.SetNumberOfPatchesToKeep(15);
+  requerySelfPatchCompare.SetIncrementalRequery(true);
+
+  ParallelSelfPatchCompare<TImage> freshSelfPatchCompare;
+  freshSelfPatchCompare.SetImage(image);
+  freshSelfPatchCompare.SetMask(mask);
+  freshSelfPatchCompare.SetPatchDistanceFunctor(&ssdFunctor);
+  freshSelfPatchCompare.SetNumberOfPatchesToKeep(15);
+
+  // Many one pixel steps, which is where updated scores would have accumulated the most round off.
+  itk::Index<2> corner = {{4, 4}};
+  itk::Size<2> size = {{7, 7}};
+  bool passed = true;
+  for(unsigned int moveId = 0; moveId < 30; ++moveId)
+  {
+    corner[moveId % 2] += 1;
+    itk::ImageRegion<2> targetRegion(corner, size);
+
+    if(requerySelfPatchCompare.CanUpdateIncrementally(targetRegion))
+    {
+      std::cerr << imageName << " incremental float: Move " << moveId << " is an incremental update!" << std::endl;
+      passed = false;
+    }
+
+    requerySelfPatchCompare.SetTargetRegion(targetRegion);
+    requerySelfPatchCompare.ComputePatchScores();
+
+    freshSelfPatchCompare.SetTargetRegion(targetRegion);
+    freshSelfPatchCompare.ComputePatchScores();
+
+    std::stringstream testName;
+    testName << imageName << " incremental float target " << corner;
+    passed = ComparePatchData(testName.str(), freshSelfPatchCompare.GetPatchData(),
+                              requerySelfPatchCompare.GetPatchData()) && passed;
+  }
+
+  return passed;
+}
+
+/** Check that two lists of patches agree within a relative tolerance: the scores of the same rank are close to each
+  * other, and every score is close to the score the reference functor gives its own patch. Near ties may be in
+  * either order, since the sums of non-integer floats depend on the order of the terms. */
+template <typename TImage>
+static bool ComparePatchDataWithTolerance(const std::string& testName,
+                                          const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>&
+                                            referencePatchData,
+                                          const std::vector<typename SelfPatchCompare<TImage>::PatchDataType>&
+                                            patchData,
+                                          PatchDistance<TImage>* const referenceFunctor,
+                                          const itk::ImageRegion<2>& targetRegion, const float tolerance)
+{
+  if(patchData.size() != referencePatchData.size())
+  {
+    std::cerr << testName << ": Found " << patchData.size() << " patches instead of "
+              << referencePatchData.size() << "!" << std::endl;
+    return false;
+  }
+
+  for(size_t patchId = 0; patchId < patchData.size(); ++patchId)
+  {
+    const float score = patchData[patchId].second;
+    const float referenceScore = referencePatchData[patchId].second;
+    const float ownReferenceScore = referenceFunctor->Distance(patchData[patchId].first, targetRegion);
+    if(std::abs(score - referenceScore) > tolerance * std::max(std::max(score, referenceScore), 1.0f) ||
+       std::abs(score - ownReferenceScore) > tolerance * std::max(std::max(score, ownReferenceScore), 1.0f))
+    {
+      std::cerr << testName << ": Patch " << patchId << " is " << patchData[patchId].first.GetIndex()
+                << " with score " << score << " (" << ownReferenceScore << " by the reference functor) instead of "
+                << referencePatchData[patchId].first.GetIndex() << " with score " << referenceScore << "!"
+                << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/** The EXHAUSTIVE backend with each kind of functor on an image of random non-integer floats, compared to the serial
+  * SSD within a relative tolerance. */
+template <typename TImage>
+static bool TestExhaustiveFloat(const std::string& imageName)
+{
+  typename TImage::Pointer image = CreateRandomFloatImage<TImage>(6);
+  Mask::Pointer mask = CreateMask();
+
+  SSD<TImage> ssdFunctor;
+  ssdFunctor.SetImage(image);
+  BoundedOnlySSD<TImage> boundedFunctor;
+  boundedFunctor.SetImage(image);
+  PartialSSD<TImage> partialSSDFunctor;
+  partialSSDFunctor.SetImage(image);
+
+  PatchDistance<TImage>* functors[3] = {&ssdFunctor, &boundedFunctor, &partialSSDFunctor};
+  const char* functorNames[3] = {"unbounded", "bounded", "batch"};
+
+  // The serial SSD accumulates in float, so it can be off by about (number of terms) * epsilon relative to the
+  // score, which is below 2e-5 for the largest test patches.
+  const float tolerance = 1e-4f;
+  const unsigned int numberOfPatchesToKeep = 15;
+  const std::vector<itk::ImageRegion<2> > targetRegions = GetTargetRegions();
+
+  bool passed = true;
+  for(size_t targetId = 0; targetId < targetRegions.size(); ++targetId)
+  {
+    std::vector<typename SelfPatchCompare<TImage>::PatchDataType> referencePatchData =
+      ComputeReferencePatchData(image.GetPointer(), mask.GetPointer(), targetRegions[targetId],
+                                numberOfPatchesToKeep);
+
+    for(unsigned int functorId = 0; functorId < 3; ++functorId)
+    {
+      ParallelSelfPatchCompare<TImage> parallelSelfPatchCompare;
+      parallelSelfPatchCompare.SetImage(image);
+      parallelSelfPatchCompare.SetMask(mask);
+      parallelSelfPatchCompare.SetPatchDistanceFunctor(functors[functorId]);
+      parallelSelfPatchCompare.SetNumberOfPatchesToKeep(numberOfPatchesToKeep);
+      parallelSelfPatchCompare.SetTargetRegion(targetRegions[targetId]);
+      parallelSelfPatchCompare.ComputePatchScores();
+
+      std::stringstream testName;
+      testName << imageName << " exhaustive float " << functorNames[functorId] << " target "
+               << targetRegions[targetId].GetIndex() << " size " << targetRegions[targetId].GetSize()[0];
+      passed = ComparePatchDataWithTolerance<TImage>(testName.str(), referencePatchData,
+                                                     parallelSelfPatchCompare.GetPatchData(), &ssdFunctor,
+                                                     targetRegions[targetId], tolerance) && passed;
+    }
+  }
+
+  return passed;
+}
+
+/** Every backend is canceled part way through a search (by the functor, once it has compared a few patches), and
+  * must then produce no patches. A search after the flag is cleared must give full results again. */
+template <typename TImage>
+static bool TestCancel(const std::string& imageName)
+{
+  typedef ParallelSelfPatchCompare<TImage> ParallelSelfPatchCompareType;
+
+  typename TImage::Pointer image = CreateImage<TImage>(4);
+  Mask::Pointer mask = CreateMask();
+
+  QAtomicInt cancelFlag;
+  CancelingSSD<TImage> cancelingFunctor(&cancelFlag, 10);
+  cancelingFunctor.SetImage(image);
+
+  const itk::Index<2> corner = {{3, 3}};
+  const itk::Size<2> size = {{9, 9}};
+  const itk::ImageRegion<2> targetRegion(corner, size);
+  const unsigned int numberOfPatchesToKeep = 15;
+
+  const size_t numberOfValidPatches =
+    ComputeReferencePatchData(image.GetPointer(), mask.GetPointer(), targetRegion, 0).size();
+  const std::vector<typename SelfPatchCompare<TImage>::PatchDataType> referencePatchData =
+    ComputeReferencePatchData(image.GetPointer(), mask.GetPointer(), targetRegion, numberOfPatchesToKeep);
+
+  const typename ParallelSelfPatchCompareType::BackendEnum backends[5] =
+    {ParallelSelfPatchCompareType::EXHAUSTIVE, ParallelSelfPatchCompareType::FFT_SSD,
+     ParallelSelfPatchCompareType::PATCH_MATCH, ParallelSelfPatchCompareType::PCA_INDEX,
+     ParallelSelfPatchCompareType::PYRAMID};
+  const char* backendNames[5] = {"exhaustive", "FFT", "PatchMatch", "PCA index", "pyramid"};
+
+  bool passed = true;
+  for(unsigned int backendId = 0; backendId < 5; ++backendId)
+  {
+    const std::string testName = imageName + " cancel " + backendNames[backendId];
+
+    ParallelSelfPatchCompareType parallelSelfPatchCompare;
+    parallelSelfPatchCompare.SetImage(image);
+    parallelSelfPatchCompare.SetMask(mask);
+    parallelSelfPatchCompare.SetPatchDistanceFunctor(&cancelingFunctor);
+    parallelSelfPatchCompare.SetNumberOfPatchesToKeep(numberOfPatchesToKeep);
+    parallelSelfPatchCompare.SetBackend(backends[backendId]);
+    // One row per tile, so the scan has many rows left to skip.
+    parallelSelfPatchCompare.SetRowsPerTile(1);
+    parallelSelfPatchCompare.SetCancelFlag(&cancelFlag);
+    parallelSelfPatchCompare.SetTargetRegion(targetRegion);
+
+    cancelFlag = 0;
+    cancelingFunctor.ResetNumberOfDistances();
+    parallelSelfPatchCompare.ComputePatchScores();
+
+    if(static_cast<int>(cancelFlag) == 0)
+    {
+      std::cerr << testName << ": The search finished before it was canceled!" << std::endl;
+      passed = false;
+    }
+    else if(!parallelSelfPatchCompare.GetPatchData().empty())
+    {
+      std::cerr << testName << ": Found " << parallelSelfPatchCompare.GetPatchData().size()
+                << " patches after the search was canceled!" << std::endl;
+      passed = false;
+    }
+
+    if(backends[backendId] == ParallelSelfPatchCompareType::EXHAUSTIVE &&
+       static_cast<size_t>(cancelingFunctor.GetNumberOfDistances()) >= numberOfValidPatches)
+    {
+      std::cerr << testName << ": The scan compared every patch after it was canceled!" << std::endl;
+      passed = false;
+    }
+
+    // The count is past the cancel point, so the functor does not cancel again.
+    cancelFlag = 0;
+    parallelSelfPatchCompare.ComputePatchScores();
+
+    if(backends[backendId] == ParallelSelfPatchCompareType::EXHAUSTIVE ||
+       backends[backendId] == ParallelSelfPatchCompareType::FFT_SSD)
+    {
+      passed = ComparePatchData(testName + " resumed", referencePatchData, parallelSelfPatchCompare.GetPatchData()) &&
+               passed;
+    }
+    else if(parallelSelfPatchCompare.GetPatchData().size() != numberOfPatchesToKeep)
+    {
+      std::cerr << testName << " resumed: Found " << parallelSelfPatchCompare.GetPatchData().size()
+                << " patches instead of " << numberOfPatchesToKeep << "!" << std::endl;
+      passed = false;
+    }
+  }
+
+  return passed;
+}
+
+/** The vectorized byte SSD kernel against a plain loop, for every length up to a few vectors and unaligned
+  * starts, with the full range of byte values. */
+static bool TestSumOfSquaredDifferences()
+{
+  std::mt19937 generator(4);
+  std::vector<unsigned char> a(300);
+  std::vector<unsigned char> b(300);
+  for(size_t valueId = 0; valueId < a.size(); ++valueId)
+  {
+    a[valueId] = generator() % 256;
+    b[valueId] = generator() % 256;
+  }
+  // The largest difference in every lane.
+  std::fill(a.begin() + 200, a.end(), 255);
+  std::fill(b.begin() + 200, b.end(), 0);
+
+  // The start of each buffer moves through every alignment of the vectors.
+  const unsigned int maximumLength = 280;
+  for(unsigned int startA = 0; startA < 4; ++startA)
+  {
+    for(unsigned int startB = 0; startB < 4; ++startB)
+    {
+      for(unsigned int length = 0; length <= maximumLength; ++length)
+      {
+        uint64_t expected = 0;
+        for(unsigned int valueId = 0; valueId < length; ++valueId)
+        {
+          int difference = static_cast<int>(a[startA + valueId]) - static_cast<int>(b[startB + valueId]);
+          expected += difference * difference;
+        }
+
+        uint64_t result = SSDKernels::SumOfSquaredDifferences(&a[startA], &b[startB], length);
+        if(result != expected)
+        {
+          std::cerr << SSDKernels::GetInstructionSetName() << " SumOfSquaredDifferences of length " << length
+                    << " is " << result << " instead of " << expected << "!" << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+int main(int, char*[])
+{
+  std::cout << "SSD kernels: " << SSDKernels::GetInstructionSetName() << std::endl;
+
+  typedef itk::Image<itk::CovariantVector<unsigned char, 3>, 2> RGBImageType;
+  typedef itk::Image<itk::CovariantVector<unsigned char, 4>, 2> FourChannelImageType;
+  typedef itk::Image<itk::CovariantVector<float, 2>, 2> TwoChannelFloatImageType;
+  typedef itk::Image<itk::CovariantVector<float, 3>, 2> RGBFloatImageType;
+
+  bool passed = TestSumOfSquaredDifferences();
+
+  passed = TestExhaustive<RGBImageType>("RGB") && passed;
+  passed = TestExhaustive<FourChannelImageType>("4 channel") && passed;
+  passed = TestExhaustive<TwoChannelFloatImageType>("2 channel float") && passed;
+  passed = TestExhaustiveFloat<TwoChannelFloatImageType>("2 channel float") && passed;
+  passed = TestExhaustiveFloat<RGBFloatImageType>("RGB float") && passed;
+
+  passed = TestFFT<RGBImageType>("RGB") && passed;
+  passed = TestFFT<FourChannelImageType>("4 channel") && passed;
+  passed = TestFFT<TwoChannelFloatImageType>("2 channel float") && passed;
+
+  passed = TestIncremental<RGBImageType>("RGB") && passed;
+  passed = TestIncremental<FourChannelImageType>("4 channel") && passed;
+  passed = TestIncremental<TwoChannelFloatImageType>("2 channel float") && passed;
+  passed = TestIncrementalFloat<TwoChannelFloatImageType>("2 channel float") && passed;
+
+  passed = TestCancel<RGBImageType>("RGB") && passed;
+
+  if(!passed)
+  {
+    std::cerr << "ParallelSelfPatchCompare does not match SelfPatchCompare!" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "ParallelSelfPatchCompare matches SelfPatchCompare." << std::endl;
+  return EXIT_SUCCESS;
+}
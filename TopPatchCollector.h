@@ -0,0 +1,89 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef TopPatchCollector_H
+#define TopPatchCollector_H
+
+// STL
+#include <cstddef>
+#include <vector>
+
+/** Keep the best (lowest score) patches seen so far, without storing the rest.
+  * TPatchData is a (region, score) pair such as SelfPatchCompare::PatchDataType.
+  * Each patch is added with an order key (e.g. its position in the raster scan) that is used to break ties,
+  * so the collected patches are exactly the first patches of a stable sort of everything that was added,
+  * regardless of how the patches were split between collectors before they were merged.
+  * The patches are kept in a max-heap, so adding a patch is O(log K) and rejecting one is O(1).
+  */
+template <typename TPatchData>
+class TopPatchCollector
+{
+public:
+
+  /** Constructor. If maximumNumberOfPatches is 0, every patch is kept. */
+  TopPatchCollector(const unsigned int maximumNumberOfPatches = 0);
+
+  /** Set the number of patches to keep (0 means keep every patch). This clears the collector. */
+  void SetMaximumNumberOfPatches(const unsigned int maximumNumberOfPatches);
+
+  /** Get the number of patches to keep. */
+  unsigned int GetMaximumNumberOfPatches() const;
+
+  /** Add a patch. It is dropped if the collector is full and the patch is not better than the worst kept patch. */
+  void Add(const TPatchData& patchData, const size_t order);
+
+  /** Add all of the patches of another collector. */
+  void Merge(const TopPatchCollector& other);
+
+  /** True if the maximum number of patches has been reached. */
+  bool IsFull() const;
+
+  /** Get the score a new patch has to beat to be kept (the largest float if the collector is not full). */
+  float GetAdmissionThreshold() const;
+
+  /** Get the number of patches currently kept. */
+  size_t GetNumberOfPatches() const;
+
+  /** Remove all of the patches. */
+  void Clear();
+
+  /** Get the kept patches, best first. */
+  std::vector<TPatchData> GetSortedPatchData() const;
+
+private:
+
+  /** A kept patch and its tie breaking key. */
+  struct Entry
+  {
+    TPatchData PatchData;
+    size_t Order;
+  };
+
+  /** Order entries by score, then by order key. With std::push_heap this makes the worst entry the front. */
+  static bool IsBetter(const Entry& a, const Entry& b);
+
+  /** The kept patches. This is a max-heap (worst patch first) when the collector is bounded. */
+  std::vector<Entry> Entries;
+
+  /** The number of patches to keep (0 means all). */
+  unsigned int MaximumNumberOfPatches;
+};
+
+#include "TopPatchCollector.hpp"
+
+#endif
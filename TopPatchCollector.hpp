@@ -0,0 +1,139 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef TopPatchCollector_HPP
+#define TopPatchCollector_HPP
+
+#include "TopPatchCollector.h"
+
+// STL
+#include <algorithm>
+#include <limits>
+
+template <typename TPatchData>
+TopPatchCollector<TPatchData>::TopPatchCollector(const unsigned int maximumNumberOfPatches) :
+MaximumNumberOfPatches(maximumNumberOfPatches)
+{
+}
+
+template <typename TPatchData>
+void TopPatchCollector<TPatchData>::SetMaximumNumberOfPatches(const unsigned int maximumNumberOfPatches)
+{
+  this->MaximumNumberOfPatches = maximumNumberOfPatches;
+  Clear();
+}
+
+template <typename TPatchData>
+unsigned int TopPatchCollector<TPatchData>::GetMaximumNumberOfPatches() const
+{
+  return this->MaximumNumberOfPatches;
+}
+
+template <typename TPatchData>
+bool TopPatchCollector<TPatchData>::IsBetter(const Entry& a, const Entry& b)
+{
+  if(a.PatchData.second != b.PatchData.second)
+  {
+    return a.PatchData.second < b.PatchData.second;
+  }
+  return a.Order < b.Order;
+}
+
+template <typename TPatchData>
+void TopPatchCollector<TPatchData>::Add(const TPatchData& patchData, const size_t order)
+{
+  Entry entry;
+  entry.PatchData = patchData;
+  entry.Order = order;
+
+  if(this->MaximumNumberOfPatches == 0)
+  {
+    this->Entries.push_back(entry);
+    return;
+  }
+
+  if(this->Entries.size() < this->MaximumNumberOfPatches)
+  {
+    this->Entries.push_back(entry);
+    std::push_heap(this->Entries.begin(), this->Entries.end(), IsBetter);
+    return;
+  }
+
+  // The collector is full. Replace the worst entry if the new one is better.
+  if(IsBetter(entry, this->Entries.front()))
+  {
+    std::pop_heap(this->Entries.begin(), this->Entries.end(), IsBetter);
+    this->Entries.back() = entry;
+    std::push_heap(this->Entries.begin(), this->Entries.end(), IsBetter);
+  }
+}
+
+template <typename TPatchData>
+void TopPatchCollector<TPatchData>::Merge(const TopPatchCollector& other)
+{
+  for(size_t i = 0; i < other.Entries.size(); ++i)
+  {
+    Add(other.Entries[i].PatchData, other.Entries[i].Order);
+  }
+}
+
+template <typename TPatchData>
+bool TopPatchCollector<TPatchData>::IsFull() const
+{
+  return this->MaximumNumberOfPatches > 0 && this->Entries.size() >= this->MaximumNumberOfPatches;
+}
+
+template <typename TPatchData>
+float TopPatchCollector<TPatchData>::GetAdmissionThreshold() const
+{
+  if(!IsFull())
+  {
+    return std::numeric_limits<float>::max();
+  }
+
+  return this->Entries.front().PatchData.second;
+}
+
+template <typename TPatchData>
+size_t TopPatchCollector<TPatchData>::GetNumberOfPatches() const
+{
+  return this->Entries.size();
+}
+
+template <typename TPatchData>
+void TopPatchCollector<TPatchData>::Clear()
+{
+  this->Entries.clear();
+}
+
+template <typename TPatchData>
+std::vector<TPatchData> TopPatchCollector<TPatchData>::GetSortedPatchData() const
+{
+  std::vector<Entry> sortedEntries = this->Entries;
+  std::sort(sortedEntries.begin(), sortedEntries.end(), IsBetter);
+
+  std::vector<TPatchData> sortedPatchData(sortedEntries.size());
+  for(size_t i = 0; i < sortedEntries.size(); ++i)
+  {
+    sortedPatchData[i] = sortedEntries[i].PatchData;
+  }
+
+  return sortedPatchData;
+}
+
+#endif
@@ -22,15 +22,20 @@
 #include "ui_TopPatchesWidget.h"
 
 // Qt
+#include <QAtomicInt>
 #include <QDialog>
 #include <QObject>
 #include <QFutureWatcher>
 class QProgressDialog;
 class QSortFilterProxyModel;
+class QTimer;
 
 // ITK
 #include "itkVectorImage.h"
 
+// STL
+#include <string>
+
 // Submodules
 #include "PatchComparison/Mask/Mask.h"
 #include "PatchComparison/PatchDistance.h"
@@ -38,6 +43,7 @@ class QSortFilterProxyModel;
 #include "PatchComparison/SelfPatchCompareLocalOptimization.h"
 
 // Custom
+#include "ParallelSelfPatchCompare.h"
 #include "TableModelTopPatches.h" // Can't forward declare a class template
 
 /** This class is necessary because a class template cannot have the Q_OBJECT macro directly. */
@@ -70,6 +76,12 @@ public slots:
   /** Called when the number of patches to display is changed. */
   virtual void on_spinNumberOfBestPatches_valueChanged(int) = 0;
 
+  /** Called periodically while the top patches are computed to update the progress bar. */
+  virtual void slot_UpdateProgress() = 0;
+
+  /** Called when the cancel button of the progress bar is clicked. */
+  virtual void slot_Canceled() = 0;
+
 signals:
 
   /** Emit a signal when a patch is selected. Note: this is not repeated in the templated
@@ -87,6 +99,9 @@ public:
   /** Constructor. */
   TopPatchesWidget(QWidget* parent = NULL);
 
+  /** Destructor. Stops a running computation, since it uses this widget. */
+  ~TopPatchesWidget();
+
   /** Set the target/query region. */
   void SetTargetRegion(const itk::ImageRegion<2>& targetRegion);
 
@@ -100,7 +115,7 @@ public:
   void SetSecondaryPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor);
 
   /** Set the SelfPatchCompareFunctor to use. */
-  void SetSelfPatchCompareFunctor(const SelfPatchCompare<TImage>& selfPatchCompareFunctor);
+  void SetSelfPatchCompareFunctor(const ParallelSelfPatchCompare<TImage>& selfPatchCompareFunctor);
 
 // public slots:
 
@@ -119,6 +134,13 @@ public:
   /** Called when the number of patches to display is changed. */
   void on_spinNumberOfBestPatches_valueChanged(int);
 
+  /** Called periodically while the top patches are computed to update the progress bar and show the best
+    * patches found so far. */
+  void slot_UpdateProgress();
+
+  /** Called when the cancel button of the progress bar is clicked. */
+  void slot_Canceled();
+
 private:
   /** The image that the patches reference. */
   TImage* Image;
@@ -126,9 +148,27 @@ private:
   /** Handle events (not signals) of other widgets. */
   bool eventFilter(QObject *object, QEvent *event);
 
-  /** The main computation. */
+  /** The main computation. This can run in another thread, so it does not touch the widgets. */
   void Compute();
 
+  /** Run Compute() on a worker thread with the current settings. slot_Finished() displays the results. The
+    * progress dialog is only shown if 'showProgress' is true. */
+  void StartComputation(const bool showProgress);
+
+  /** Display the patches found by the last (not canceled) Compute(). */
+  void DisplayResults();
+
+  /** Stop a running computation, and wait (a few milliseconds) for it to finish. */
+  void CancelComputation();
+
+  /** Set the patch display size of the model to the size of the target patch view, and size the cells to fit it.
+    * All of the rows are the same height, so the view never measures the rows (which would render every patch). */
+  void UpdatePatchDisplaySize();
+
+  /** Disable the items of cmbSearchBackend that cannot be used with the current PatchDistance functor, and select
+    * the exhaustive search if the selected one is disabled. */
+  void UpdateSearchBackends();
+
   /** The scene for the target patch. */
   QGraphicsScene* TargetPatchScene;
 
@@ -153,8 +193,20 @@ private:
   /** The progress bar. */
   QProgressDialog* ProgressDialog;
 
+  /** The timer that updates the progress bar. */
+  QTimer* ProgressTimer;
+
+  /** Set to non-zero to stop the running computation. */
+  QAtomicInt CancelFlag;
+
+  /** The id of the partial results of the running computation that are displayed. */
+  int DisplayedSnapshotId;
+
+  /** The reason the selected backend could not be used that the user was last told about. */
+  std::string ReportedFallbackReason;
+
   /** The functor to use to find the best patch. */
-  SelfPatchCompare<TImage> SelfPatchCompareFunctor;
+  ParallelSelfPatchCompare<TImage> SelfPatchCompareFunctor;
   //SelfPatchCompareLocalOptimization<TImage> SelfPatchCompareFunctor;
 
   PatchDistance<TImage>* SecondaryPatchDistanceFunctor;
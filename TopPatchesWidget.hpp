@@ -31,11 +31,19 @@
 // Qt
 #include <QGraphicsPixmapItem>
 #include <QLineEdit>
+#include <QMessageBox>
 #include <QProgressDialog>
 #include <QSortFilterProxyModel>
+#include <QStandardItemModel>
+#include <QTimer>
 
 #include <QtConcurrentRun>
 
+// STL
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 // Submodules
 #include "Helpers/Helpers.h"
 #include "ITKVTKHelpers/ITKVTKHelpers.h"
@@ -44,6 +52,7 @@
 #include "Mask/Mask.h"
 
 // Custom
+#include "BatchPatchDistance.h"
 #include "PixmapDelegate.h"
 
 template<typename TImage>
@@ -52,8 +61,9 @@ SecondaryPatchDistanceFunctor(NULL)
 {
   this->setupUi(this);
 
-  // Make the cells fit the images (based on the sizeHint from the PixmapDelegate)
-  this->tblviewTopPatches->verticalHeader()->setResizeMode(QHeaderView::ResizeToContents);
+  // The rows are sized by UpdatePatchDisplaySize, the columns fit the visible cells (based on the sizeHint from the
+  // PixmapDelegate, which the model reports without rendering the patches).
+  this->tblviewTopPatches->verticalHeader()->setResizeMode(QHeaderView::Fixed);
   this->tblviewTopPatches->horizontalHeader()->setResizeMode(QHeaderView::ResizeToContents);
 
   this->TargetPatchItem = new QGraphicsPixmapItem;
@@ -66,8 +76,7 @@ SecondaryPatchDistanceFunctor(NULL)
   this->tblviewTopPatches->setModel(ProxyModel);
   this->TopPatchesModel->SetMaxTopPatchesToDisplay(this->spinNumberOfBestPatches->value());
 
-  std::cout << "Set patch display size to: " << this->gfxTargetPatch->size().height() << std::endl;
-  this->TopPatchesModel->SetPatchDisplaySize(this->gfxTargetPatch->size().height());
+  UpdatePatchDisplaySize();
 
   PixmapDelegate* pixmapDelegate = new PixmapDelegate;
 
@@ -77,28 +86,109 @@ SecondaryPatchDistanceFunctor(NULL)
           SIGNAL(selectionChanged(const QItemSelection &, const QItemSelection &)),
           this, SLOT(slot_SelectionChanged(const QItemSelection &, const QItemSelection &)));
 
-  // Setup progress bar
-  this->ProgressDialog = new QProgressDialog();
+  // Setup progress bar. It only blocks this window, so a new target patch can still be selected in the main
+  // window, which cancels the running computation.
+  this->ProgressDialog = new QProgressDialog(this);
+  this->ProgressDialog->setLabelText("Finding top patches...");
   this->ProgressDialog->setMinimum(0);
-  this->ProgressDialog->setMaximum(0);
+  this->ProgressDialog->setMaximum(100);
+  this->ProgressDialog->setAutoReset(false);
+  this->ProgressDialog->setAutoClose(false);
   this->ProgressDialog->setWindowModality(Qt::WindowModal);
   this->ProgressDialog->hide();
 
+  this->ProgressTimer = new QTimer(this);
+  this->ProgressTimer->setInterval(50);
+  connect(this->ProgressTimer, SIGNAL(timeout()), this, SLOT(slot_UpdateProgress()));
+
+  this->SelfPatchCompareFunctor.SetCancelFlag(&this->CancelFlag);
+  // Publish the best patches found so far about as often as the progress bar is updated.
+  this->SelfPatchCompareFunctor.SetSnapshotInterval(this->ProgressTimer->interval());
+  this->DisplayedSnapshotId = 0;
+
   connect(&this->FutureWatcher, SIGNAL(finished()), this, SLOT(slot_Finished()));
-  connect(&this->FutureWatcher, SIGNAL(finished()), this->ProgressDialog , SLOT(cancel()));
+  connect(this->ProgressDialog, SIGNAL(canceled()), this, SLOT(slot_Canceled()));
+}
+
+template<typename TImage>
+TopPatchesWidget<TImage>::~TopPatchesWidget()
+{
+  CancelComputation();
 }
 
 template<typename TImage>
 void TopPatchesWidget<TImage>::slot_Finished()
 {
-  std::cout << "Finshed" << std::endl;
+  this->ProgressTimer->stop();
+  this->ProgressDialog->hide();
+
+  if(this->CancelFlag != 0)
+  {
+    return;
+  }
+
+  // Only tell the user once, rather than after every query of the moving target.
+  std::string fallbackReason = this->SelfPatchCompareFunctor.GetFallbackReason();
+  if(!fallbackReason.empty() && fallbackReason != this->ReportedFallbackReason)
+  {
+    QMessageBox::warning(this, "Search backend",
+                         QString::fromStdString(fallbackReason + " Searched every patch instead."));
+  }
+  this->ReportedFallbackReason = fallbackReason;
+
+  DisplayResults();
+}
+
+template<typename TImage>
+void TopPatchesWidget<TImage>::slot_UpdateProgress()
+{
+  // Setting the value of a hidden dialog would show it after its minimum duration.
+  if(this->ProgressDialog->isVisible())
+  {
+    this->ProgressDialog->setValue(static_cast<int>(100.0f * this->SelfPatchCompareFunctor.GetProgress()));
+  }
+
+  int snapshotId = this->SelfPatchCompareFunctor.GetSnapshotId();
+  if(snapshotId != this->DisplayedSnapshotId)
+  {
+    this->DisplayedSnapshotId = snapshotId;
+    this->TopPatchesModel->UpdateTopPatchData(this->SelfPatchCompareFunctor.GetPartialPatchData());
+  }
+}
+
+template<typename TImage>
+void TopPatchesWidget<TImage>::slot_Canceled()
+{
+  this->CancelFlag = 1;
+}
+
+template<typename TImage>
+void TopPatchesWidget<TImage>::CancelComputation()
+{
+  if(!this->FutureWatcher.isRunning())
+  {
+    return;
+  }
+
+  // The scan checks the flag once per row, so this does not wait long.
+  this->CancelFlag = 1;
+  this->FutureWatcher.waitForFinished();
 }
 
 template<typename TImage>
 void TopPatchesWidget<TImage>::SetTargetRegion(const itk::ImageRegion<2>& targetRegion)
 {
+  // This is also called when only the source patch moved, which must not restart (or cancel) anything.
+  const bool targetMoved = (targetRegion != this->TargetRegion);
+
+  if(targetMoved)
+  {
+    // The results of a computation for the old target are not wanted anymore.
+    CancelComputation();
+  }
+
   this->TargetRegion = targetRegion;
-  
+
   QImage patchImage = ITKQtHelpers::GetQImageColor(this->Image, targetRegion);
 
   QPixmap pixmap = QPixmap::fromImage(patchImage);
@@ -110,6 +200,13 @@ void TopPatchesWidget<TImage>::SetTargetRegion(const itk::ImageRegion<2>& target
   this->gfxTargetPatch->setScene(TargetPatchScene);
 
   this->TargetPatchScene->addPixmap(pixmap);
+
+  // Small moves use the kept scores, which is quick, so no progress dialog is shown for them.
+  if(targetMoved && this->chkUpdateOnMove->isChecked() && !this->TopPatchData.empty() &&
+     this->SelfPatchCompareFunctor.CanUpdateIncrementally(targetRegion))
+  {
+    StartComputation(false);
+  }
 }
 
 template<typename TImage>
@@ -140,16 +237,35 @@ void TopPatchesWidget<TImage>::SetImage(TImage* const image)
 {
   this->Image = image;
   this->TopPatchesModel->SetImage(this->Image);
+
+  this->SelfPatchCompareFunctor.SetImage(this->Image);
+  this->SelfPatchCompareFunctor.CreateFullyValidMask();
 }
 
 template<typename TImage>
 void TopPatchesWidget<TImage>::on_btnComputeSecondary_clicked()
 {
-  // Replace the data using the secondary distance functor
-  for(int i = 0; i < this->spinNumberOfBestPatches->value(); ++i)
+  // Replace the data using the secondary distance functor. All of the patches are scored against the target in one call.
+  unsigned int numberOfPatches = std::min<size_t>(this->spinNumberOfBestPatches->value(), this->TopPatchData.size());
+  if(numberOfPatches == 0)
+  {
+    return;
+  }
+
+  std::vector<itk::Index<2> > sourceCorners(numberOfPatches);
+  for(unsigned int i = 0; i < numberOfPatches; ++i)
   {
-    float secondaryDistance = this->SecondaryPatchDistanceFunctor->Distance(this->TargetRegion, this->TopPatchData[i].first);
-    this->TopPatchData[i].second = secondaryDistance;
+    sourceCorners[i] = this->TopPatchData[i].first.GetIndex();
+  }
+
+  std::vector<float> secondaryDistances(numberOfPatches);
+  BatchPatchDistance<TImage>::ComputeDistances(this->SecondaryPatchDistanceFunctor, this->TargetRegion,
+                                               &sourceCorners[0], numberOfPatches,
+                                               std::numeric_limits<float>::max(), &secondaryDistances[0]);
+
+  for(unsigned int i = 0; i < numberOfPatches; ++i)
+  {
+    this->TopPatchData[i].second = secondaryDistances[i];
   }
 
   // Update the data in the model
@@ -158,11 +274,18 @@ void TopPatchesWidget<TImage>::on_btnComputeSecondary_clicked()
 }
 
 template<typename TImage>
-void TopPatchesWidget<TImage>::on_btnFindTopPatches_clicked()
+void TopPatchesWidget<TImage>::UpdatePatchDisplaySize()
 {
-  std::cout << "Set patch display size to: " << this->gfxTargetPatch->size().height() << std::endl;
   this->TopPatchesModel->SetPatchDisplaySize(this->gfxTargetPatch->size().height());
-  this->tblviewTopPatches->resizeRowsToContents();
+
+  // The extra pixel is for the grid line.
+  this->tblviewTopPatches->verticalHeader()->setDefaultSectionSize(this->TopPatchesModel->GetPatchDisplaySize() + 1);
+}
+
+template<typename TImage>
+void TopPatchesWidget<TImage>::on_btnFindTopPatches_clicked()
+{
+  UpdatePatchDisplaySize();
 
   // Lock in the settings. That is, once "Compute" is clicked,
   // the values in the spin boxes correspond to what is being displayed.
@@ -171,48 +294,82 @@ void TopPatchesWidget<TImage>::on_btnFindTopPatches_clicked()
   bestPatchesPalette.setColor( QPalette::Normal, QPalette::Base, normalColor);
   this->spinNumberOfBestPatches->findChild<QLineEdit*>()->setPalette(bestPatchesPalette);
 
-  // Start the computation.
+  // A running search reads the settings, so stop it before changing them.
+  CancelComputation();
+
+  // The items of cmbSearchBackend are in the same order as ParallelSelfPatchCompare::BackendEnum.
+  this->SelfPatchCompareFunctor.SetBackend(
+    static_cast<typename ParallelSelfPatchCompare<TImage>::BackendEnum>(this->cmbSearchBackend->currentIndex()));
+  this->SelfPatchCompareFunctor.SetIncrementalRequery(this->chkUpdateOnMove->isChecked());
+  this->SelfPatchCompareFunctor.SetPatchMatchIterations(this->spinPatchMatchIterations->value());
+  this->SelfPatchCompareFunctor.SetRandomSeed(this->spinRandomSeed->value());
+  this->SelfPatchCompareFunctor.SetNumberOfPatchesToKeep(this->spinNumberOfBestPatches->value());
+
+  StartComputation(true);
+}
+
+template<typename TImage>
+void TopPatchesWidget<TImage>::StartComputation(const bool showProgress)
+{
+  // The previous results stay in the table until the first partial results replace them.
+  this->CancelFlag = 0;
+  this->DisplayedSnapshotId = this->SelfPatchCompareFunctor.GetSnapshotId();
+  this->TopPatchesModel->SetMaxTopPatchesToDisplay(this->spinNumberOfBestPatches->value());
   QFuture<void> future = QtConcurrent::run(this, &TopPatchesWidget::Compute);
   this->FutureWatcher.setFuture(future);
 
-  this->ProgressDialog->exec();
+  if(showProgress)
+  {
+    this->ProgressDialog->setValue(0);
+    this->ProgressDialog->show();
+  }
+  this->ProgressTimer->start();
 }
 
 template<typename TImage>
 void TopPatchesWidget<TImage>::Compute()
 {
-  this->SelfPatchCompareFunctor.SetImage(this->Image);
+  // The image and (fully valid) mask are given to the SelfPatchCompareFunctor in SetImage().
   //this->PatchCompare.SetMask(this->MaskImage);
-  this->SelfPatchCompareFunctor.CreateFullyValidMask();
-
   this->SelfPatchCompareFunctor.SetTargetRegion(this->TargetRegion);
 
+  // Only the best patches are kept (already sorted) during the scan, so there is nothing to sort here. The number
+  // of patches to keep was set on the GUI thread when the search was started, since this runs on a worker thread.
   this->SelfPatchCompareFunctor.ComputePatchScores();
+}
 
+template<typename TImage>
+void TopPatchesWidget<TImage>::DisplayResults()
+{
   this->TopPatchData = this->SelfPatchCompareFunctor.GetPatchData();
 
-  //std::sort(topPatchData.begin(), topPatchData.end(), Helpers::SortBySecondAccending<PatchDataType>);
-  unsigned int numberOfPatches = this->spinNumberOfBestPatches->value();
-//   std::partial_sort(this->TopPatchData.begin(), this->TopPatchData.begin() + numberOfPatches,
-//                     this->TopPatchData.end(),
-//                     Helpers::SortBySecondAccending<SelfPatchCompare<ImageType>::PatchDataType>);
-
-  // Perform a full sort
-  std::sort(this->TopPatchData.begin(), this->TopPatchData.end(),
-                    Helpers::SortBySecondAccending<typename SelfPatchCompare<TImage>::PatchDataType>);
-
-  this->TopPatchData.resize(numberOfPatches);
-  std::cout << "There are " << this->TopPatchData.size() << " top patches." << std::endl;
-
+  // The partial results are usually already close, so only update the rows that changed.
   this->TopPatchesModel->SetMaxTopPatchesToDisplay(this->spinNumberOfBestPatches->value());
-  this->TopPatchesModel->SetTopPatchData(this->TopPatchData);
-  this->TopPatchesModel->Refresh();
+  this->TopPatchesModel->UpdateTopPatchData(this->TopPatchData);
 }
 
 template<typename TImage>
 void TopPatchesWidget<TImage>::SetPatchDistanceFunctor(PatchDistance<TImage>* const patchDistanceFunctor)
 {
   this->SelfPatchCompareFunctor.SetPatchDistanceFunctor(patchDistanceFunctor);
+  UpdateSearchBackends();
+}
+
+template<typename TImage>
+void TopPatchesWidget<TImage>::UpdateSearchBackends()
+{
+  // The items of cmbSearchBackend are in the same order as ParallelSelfPatchCompare::BackendEnum.
+  QStandardItemModel* backendModel = qobject_cast<QStandardItemModel*>(this->cmbSearchBackend->model());
+  for(int backend = 0; backend < this->cmbSearchBackend->count(); ++backend)
+  {
+    bool supported = this->SelfPatchCompareFunctor.IsBackendSupported(
+      static_cast<typename ParallelSelfPatchCompare<TImage>::BackendEnum>(backend));
+    backendModel->item(backend)->setEnabled(supported);
+    if(!supported && this->cmbSearchBackend->currentIndex() == backend)
+    {
+      this->cmbSearchBackend->setCurrentIndex(ParallelSelfPatchCompare<TImage>::EXHAUSTIVE);
+    }
+  }
 }
 
 template<typename TImage>
@@ -248,9 +405,13 @@ void TopPatchesWidget<TImage>::on_spinNumberOfBestPatches_valueChanged(int value
 
 template<typename TImage>
 void TopPatchesWidget<TImage>::SetSelfPatchCompareFunctor(
-     const SelfPatchCompare<TImage>& selfPatchCompareFunctor)
+     const ParallelSelfPatchCompare<TImage>& selfPatchCompareFunctor)
 {
+  CancelComputation();
   this->SelfPatchCompareFunctor = selfPatchCompareFunctor;
+  this->SelfPatchCompareFunctor.SetCancelFlag(&this->CancelFlag);
+  this->SelfPatchCompareFunctor.SetSnapshotInterval(this->ProgressTimer->interval());
+  UpdateSearchBackends();
 }
 
 template<typename TImage>
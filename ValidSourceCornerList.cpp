@@ -0,0 +1,215 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#include "ValidSourceCornerList.h"
+
+// STL
+#include <algorithm>
+#include <stdexcept>
+
+ValidSourceCornerList::ValidSourceCornerList() : MaskImage(NULL), CachedMask(NULL), CachedMaskMTime(0), Invalid(true),
+HasChangedRegion(false)
+{
+  this->PatchSize.Fill(0);
+  this->CachedPatchSize.Fill(0);
+}
+
+void ValidSourceCornerList::SetMask(const Mask* const mask)
+{
+  this->MaskImage = mask;
+}
+
+void ValidSourceCornerList::SetPatchSize(const itk::Size<2>& patchSize)
+{
+  this->PatchSize = patchSize;
+}
+
+void ValidSourceCornerList::Invalidate()
+{
+  this->Invalid = true;
+}
+
+void ValidSourceCornerList::InvalidateRegion(const itk::ImageRegion<2>& region)
+{
+  if(!this->HasChangedRegion)
+  {
+    this->ChangedRegion = region;
+    this->HasChangedRegion = true;
+    return;
+  }
+
+  // Grow the changed region to the bounding box of both.
+  itk::Index<2> corner;
+  itk::Index<2> endCorner;
+  for(unsigned int dimension = 0; dimension < 2; ++dimension)
+  {
+    corner[dimension] = std::min(this->ChangedRegion.GetIndex()[dimension], region.GetIndex()[dimension]);
+    endCorner[dimension] = std::max(this->ChangedRegion.GetUpperIndex()[dimension], region.GetUpperIndex()[dimension]) + 1;
+  }
+
+  itk::Size<2> size = {{static_cast<itk::SizeValueType>(endCorner[0] - corner[0]),
+                        static_cast<itk::SizeValueType>(endCorner[1] - corner[1])}};
+  this->ChangedRegion = itk::ImageRegion<2>(corner, size);
+}
+
+void ValidSourceCornerList::Update()
+{
+  if(!this->MaskImage)
+  {
+    throw std::runtime_error("ValidSourceCornerList: Must call SetMask() before Update()!");
+  }
+
+  const bool maskReplaced = this->Invalid || this->MaskImage != this->CachedMask ||
+                            this->MaskImage->GetLargestPossibleRegion() != this->FullRegion;
+  const bool maskModified = this->MaskImage->GetMTime() != this->CachedMaskMTime;
+
+  if(maskReplaced || (maskModified && !this->HasChangedRegion))
+  {
+    this->FullRegion = this->MaskImage->GetLargestPossibleRegion();
+    this->RowDistances.resize(this->FullRegion.GetNumberOfPixels());
+    ComputeRowDistances(0, this->FullRegion.GetSize()[1]);
+    this->CachedPatchSize.Fill(0);
+  }
+  else if(this->HasChangedRegion)
+  {
+    itk::ImageRegion<2> changedRegion = this->ChangedRegion;
+    if(changedRegion.Crop(this->FullRegion))
+    {
+      unsigned int firstRow = changedRegion.GetIndex()[1] - this->FullRegion.GetIndex()[1];
+      unsigned int endRow = firstRow + changedRegion.GetSize()[1];
+      ComputeRowDistances(firstRow, endRow);
+
+      // The corners whose patches overlap the changed rows
+      if(this->PatchSize == this->CachedPatchSize && !this->RowCorners.empty())
+      {
+        unsigned int firstCornerRow = firstRow + 1 > this->PatchSize[1] ? firstRow + 1 - this->PatchSize[1] : 0;
+        ComputeCornerRows(firstCornerRow, std::min<unsigned int>(endRow, this->RowCorners.size()));
+      }
+    }
+  }
+
+  if(this->PatchSize != this->CachedPatchSize)
+  {
+    unsigned int numberOfCornerRows = 0;
+    if(this->PatchSize[0] > 0 && this->PatchSize[1] > 0 &&
+       this->PatchSize[0] <= this->FullRegion.GetSize()[0] && this->PatchSize[1] <= this->FullRegion.GetSize()[1])
+    {
+      numberOfCornerRows = this->FullRegion.GetSize()[1] - this->PatchSize[1] + 1;
+    }
+
+    this->RowCorners.assign(numberOfCornerRows, std::vector<itk::Index<2> >());
+    ComputeCornerRows(0, numberOfCornerRows);
+    this->CachedPatchSize = this->PatchSize;
+  }
+
+  this->CachedMask = this->MaskImage;
+  this->CachedMaskMTime = this->MaskImage->GetMTime();
+  this->Invalid = false;
+  this->HasChangedRegion = false;
+}
+
+const itk::Index<2>* ValidSourceCornerList::GetRowCorners(const itk::IndexValueType row,
+                                                          unsigned int& numberOfCorners) const
+{
+  itk::IndexValueType cornerRow = row - this->FullRegion.GetIndex()[1];
+  if(cornerRow < 0 || cornerRow >= static_cast<itk::IndexValueType>(this->RowCorners.size()) ||
+     this->RowCorners[cornerRow].empty())
+  {
+    numberOfCorners = 0;
+    return NULL;
+  }
+
+  numberOfCorners = this->RowCorners[cornerRow].size();
+  return &this->RowCorners[cornerRow][0];
+}
+
+size_t ValidSourceCornerList::GetNumberOfCorners() const
+{
+  size_t numberOfCorners = 0;
+  for(size_t cornerRow = 0; cornerRow < this->RowCorners.size(); ++cornerRow)
+  {
+    numberOfCorners += this->RowCorners[cornerRow].size();
+  }
+  return numberOfCorners;
+}
+
+void ValidSourceCornerList::ComputeRowDistances(const unsigned int firstRow, const unsigned int endRow)
+{
+  const unsigned int width = this->FullRegion.GetSize()[0];
+  for(unsigned int row = firstRow; row < endRow; ++row)
+  {
+    unsigned int* distances = &this->RowDistances[static_cast<size_t>(row) * width];
+    unsigned int distance = 0;
+    for(unsigned int column = 0; column < width; ++column)
+    {
+      itk::Index<2> pixel = {{this->FullRegion.GetIndex()[0] + column, this->FullRegion.GetIndex()[1] + row}};
+      distance = this->MaskImage->IsValid(pixel) ? distance + 1 : 0;
+      distances[column] = distance;
+    }
+  }
+}
+
+void ValidSourceCornerList::CountBadCorners(const unsigned int row, const int increment,
+                                            std::vector<int>& badCounts) const
+{
+  const unsigned int width = this->FullRegion.GetSize()[0];
+  const unsigned int* distances = &this->RowDistances[static_cast<size_t>(row) * width + this->PatchSize[0] - 1];
+  for(unsigned int cornerColumn = 0; cornerColumn < badCounts.size(); ++cornerColumn)
+  {
+    if(distances[cornerColumn] < this->PatchSize[0])
+    {
+      badCounts[cornerColumn] += increment;
+    }
+  }
+}
+
+void ValidSourceCornerList::ComputeCornerRows(const unsigned int firstRow, const unsigned int endRow)
+{
+  if(firstRow >= endRow)
+  {
+    return;
+  }
+
+  // The number of rows of each corner's patch that are cut by a hole, over a window of PatchSize[1] rows that
+  // slides down the mask.
+  std::vector<int> badCounts(this->FullRegion.GetSize()[0] - this->PatchSize[0] + 1, 0);
+  for(unsigned int row = firstRow; row + 1 < firstRow + this->PatchSize[1]; ++row)
+  {
+    CountBadCorners(row, 1, badCounts);
+  }
+
+  for(unsigned int cornerRow = firstRow; cornerRow < endRow; ++cornerRow)
+  {
+    CountBadCorners(cornerRow + this->PatchSize[1] - 1, 1, badCounts);
+
+    std::vector<itk::Index<2> >& corners = this->RowCorners[cornerRow];
+    corners.clear();
+    for(unsigned int cornerColumn = 0; cornerColumn < badCounts.size(); ++cornerColumn)
+    {
+      if(badCounts[cornerColumn] == 0)
+      {
+        itk::Index<2> corner = {{this->FullRegion.GetIndex()[0] + cornerColumn,
+                                 this->FullRegion.GetIndex()[1] + cornerRow}};
+        corners.push_back(corner);
+      }
+    }
+
+    CountBadCorners(cornerRow, -1, badCounts);
+  }
+}
@@ -0,0 +1,117 @@
+/*=========================================================================
+ *
+ *  Copyright David Doria 2012 daviddoria@gmail.com
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         http://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+
+#ifndef ValidSourceCornerList_H
+#define ValidSourceCornerList_H
+
+// ITK
+#include "itkImageRegion.h"
+
+// STL
+#include <vector>
+
+// Submodules
+#include "PatchComparison/Mask/Mask.h"
+
+/** The corners of the source patches of a given size that lie entirely in the valid part of a mask, stored as one
+  * dense array per row, so a scan can visit them without testing the mask for each candidate.
+  * The list is built from a distance map of the holes along the rows: the number of consecutive valid pixels
+  * ending at each pixel. A patch is valid if, on each of its rows, that distance at its right column is at least
+  * the patch width. The distance map does not depend on the patch size, so changing the size only repeats the
+  * (cheap) vertical pass, and when the mask is modified in place only the rows of the changed region (reported
+  * with InvalidateRegion()) and the corners whose patches overlap them are recomputed.
+  * Call Update() before using the list from several threads; GetRowCorners() is safe to call concurrently.
+  */
+class ValidSourceCornerList
+{
+public:
+
+  /** Constructor. */
+  ValidSourceCornerList();
+
+  /** Set the mask. */
+  void SetMask(const Mask* const mask);
+
+  /** Set the size of the source patches. */
+  void SetPatchSize(const itk::Size<2>& patchSize);
+
+  /** Force the list to be rebuilt by the next Update(). */
+  void Invalidate();
+
+  /** Report that the pixels of the mask in 'region' were modified in place, so that the next Update() only
+    * recomputes the part of the list that depends on them. */
+  void InvalidateRegion(const itk::ImageRegion<2>& region);
+
+  /** Rebuild the parts of the list that are out of date. If the mask was modified without InvalidateRegion()
+    * (its modified time changed), the whole list is rebuilt. */
+  void Update();
+
+  /** Get the valid corners whose row is 'row' (an index of the mask), in increasing column order. Returns NULL if
+    * there are none. */
+  const itk::Index<2>* GetRowCorners(const itk::IndexValueType row, unsigned int& numberOfCorners) const;
+
+  /** Get the total number of valid corners. */
+  size_t GetNumberOfCorners() const;
+
+private:
+
+  /** Compute the hole distances of the mask rows [firstRow, endRow) (relative to FullRegion). */
+  void ComputeRowDistances(const unsigned int firstRow, const unsigned int endRow);
+
+  /** Compute the valid corners of the corner rows [firstRow, endRow) (relative to FullRegion). */
+  void ComputeCornerRows(const unsigned int firstRow, const unsigned int endRow);
+
+  /** Count (add 'increment' to) the corners of each column whose patch is cut by a hole in mask row 'row'. */
+  void CountBadCorners(const unsigned int row, const int increment, std::vector<int>& badCounts) const;
+
+  /** The mask. */
+  const Mask* MaskImage;
+
+  /** The size of the source patches. */
+  itk::Size<2> PatchSize;
+
+  /** The mask the list was built from. */
+  const Mask* CachedMask;
+
+  /** The modified time of the mask when the list was built. */
+  unsigned long CachedMaskMTime;
+
+  /** The patch size the list was built for. */
+  itk::Size<2> CachedPatchSize;
+
+  /** True if the list has to be rebuilt regardless of the modified time. */
+  bool Invalid;
+
+  /** The bounding box of the regions reported with InvalidateRegion() since the last Update(). */
+  itk::ImageRegion<2> ChangedRegion;
+
+  /** True if ChangedRegion holds a region. */
+  bool HasChangedRegion;
+
+  /** The region of the mask the list covers. */
+  itk::ImageRegion<2> FullRegion;
+
+  /** The number of consecutive valid pixels ending at each pixel of the mask (counting the pixel itself). */
+  std::vector<unsigned int> RowDistances;
+
+  /** The valid corners of each row of corners. */
+  std::vector<std::vector<itk::Index<2> > > RowCorners;
+};
+
+#endif
@@ -29,6 +29,7 @@
 #include <QGraphicsPixmapItem>
 #include <QLineEdit>
 #include <QProgressDialog>
+#include <QScrollBar>
 #include <QSortFilterProxyModel>
 
 // Submodules
@@ -53,12 +54,26 @@ ViewAllMatchesWidget::ViewAllMatchesWidget(const std::string& imageFileName,
   ITKHelpers::DeepCopy(imageReader->GetOutput(), this->Image.GetPointer());
   std::cout << "Image size: " << this->Image->GetLargestPossibleRegion().GetSize() << std::endl;
 
-  itk::Size<2> patchSize = {{patchRadius*2 + 1, patchRadius*2 + 1}};
-
-  this->Pairs = PairReader::Read(matchFileName, patchSize);
-
-  std::cout << "There are " << this->Pairs.size() << " pairs." << std::endl;
-  this->TableModel = new TableModelViewAllMatches(this->Image, this->Pairs, this);
+  if(MatchPairFile::IsMatchPairFile(matchFileName))
+  {
+    // The binary files are mapped and read in place, however many pairs they hold.
+    this->PairFile.Open(matchFileName);
+    if(this->PairFile.GetPatchRadius() != patchRadius)
+    {
+      std::cerr << "The patch radius of " << matchFileName << " is " << this->PairFile.GetPatchRadius()
+                << ", using it instead of " << patchRadius << "." << std::endl;
+    }
+    this->TableModel = new TableModelViewAllMatches(this->Image, &this->PairFile, this);
+  }
+  else
+  {
+    itk::Size<2> patchSize = {{patchRadius*2 + 1, patchRadius*2 + 1}};
+
+    this->Pairs = PairReader::Read(matchFileName, patchSize);
+
+    std::cout << "There are " << this->Pairs.size() << " pairs." << std::endl;
+    this->TableModel = new TableModelViewAllMatches(this->Image, this->Pairs, this);
+  }
 
   SharedConstructor();
 }
@@ -72,13 +87,20 @@ ViewAllMatchesWidget::ViewAllMatchesWidget(QWidget* parent) : QWidget(parent), I
 void ViewAllMatchesWidget::SharedConstructor()
 {
   this->setupUi(this);
-  // Make the cells fit the images (based on the sizeHint from the PixmapDelegate)
-  this->tblviewAllMatches->verticalHeader()->setResizeMode(QHeaderView::ResizeToContents);
-  this->tblviewAllMatches->horizontalHeader()->setResizeMode(QHeaderView::ResizeToContents);
+
+  // Make the cells fit the images. Every row is the same height, so the sizes are set once (before the rows are
+  // added) instead of being computed from the contents, which would ask for the size of every one of the
+  // (possibly millions of) rows. The extra pixel is for the grid line.
+  const int cellSize = this->TableModel->GetPatchDisplaySize() + 1;
+  this->tblviewAllMatches->verticalHeader()->setResizeMode(QHeaderView::Fixed);
+  this->tblviewAllMatches->verticalHeader()->setDefaultSectionSize(cellSize);
 
   this->tblviewAllMatches->setModel(this->TableModel);
   this->TableModel->SetMaxPairsToDisplay(500000);
 
+  this->tblviewAllMatches->horizontalHeader()->resizeSection(1, cellSize);
+  this->tblviewAllMatches->horizontalHeader()->resizeSection(2, cellSize);
+
 //   std::cout << "Set patch display size to: " << this->gfxTargetPatch->size().height() << std::endl;
 //   this->TableModel->SetPatchDisplaySize(this->gfxTargetPatch->size().height());
 
@@ -88,6 +110,36 @@ void ViewAllMatchesWidget::SharedConstructor()
   connect(this->tblviewAllMatches->selectionModel(),
           SIGNAL(selectionChanged(const QItemSelection &, const QItemSelection &)),
           this, SLOT(slot_SelectionChanged(const QItemSelection &, const QItemSelection &)));
+
+  // The thumbnails are rendered in the background, starting with the rows in view, and the view is repainted as
+  // they arrive. The range of the scroll bar changes when rows are added or the table is resized.
+  connect(this->tblviewAllMatches->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          this, SLOT(slot_PrefetchVisibleRows()));
+  connect(this->tblviewAllMatches->verticalScrollBar(), SIGNAL(rangeChanged(int, int)),
+          this, SLOT(slot_PrefetchVisibleRows()));
+  connect(this->TableModel->GetThumbnailCache(), SIGNAL(signal_ThumbnailsReady()),
+          this->tblviewAllMatches->viewport(), SLOT(update()));
+  slot_PrefetchVisibleRows();
+}
+
+ViewAllMatchesWidget::~ViewAllMatchesWidget()
+{
+  this->TableModel->ReleaseImage();
+}
+
+void ViewAllMatchesWidget::slot_PrefetchVisibleRows()
+{
+  QTableView* view = this->tblviewAllMatches;
+  int firstVisibleRow = view->rowAt(0);
+  int lastVisibleRow = view->rowAt(view->viewport()->height() - 1);
+
+  // rowAt returns -1 below the last row.
+  if(lastVisibleRow < 0)
+  {
+    lastVisibleRow = this->TableModel->rowCount(QModelIndex()) - 1;
+  }
+
+  this->TableModel->PrefetchRows(std::max(firstVisibleRow, 0), lastVisibleRow);
 }
 
 std::istream& ViewAllMatchesWidget::MyIgnore(std::istream& ss)
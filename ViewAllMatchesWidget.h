@@ -32,6 +32,7 @@
 #include "Mask/Mask.h"
 
 // Custom
+#include "MatchPairFile.h"
 #include "TableModelViewAllMatches.h"
 
 /** This class is necessary because a class template cannot have the Q_OBJECT macro directly. */
@@ -48,11 +49,17 @@ public:
                        const unsigned int patchRadius, QWidget* parent = NULL);
   void SharedConstructor();
 
+  /** Destructor. Stops the rendering of the thumbnails, which reads the image. */
+  ~ViewAllMatchesWidget();
+
 public slots:
 
   /** When a patch (or patches) is clicked or the arrow keys are used, emit a signal. */
   void slot_SelectionChanged(const QItemSelection &, const QItemSelection &);
 
+  /** Render the thumbnails of the rows around the ones in view. Called when the table is scrolled or resized. */
+  void slot_PrefetchVisibleRows();
+
 private:
   /** The image that the regions/patches reference. */
   ImageType::Pointer Image;
@@ -60,9 +67,12 @@ private:
   /** The type of patch pairs. */
   typedef std::pair<itk::ImageRegion<2>, itk::ImageRegion<2> > PairType;
 
-  /** All of the patch pairs. */
+  /** All of the patch pairs (read from a text match file). */
   std::vector<PairType> Pairs;
 
+  /** The mapped binary match file, whose pairs are displayed without being copied into Pairs. */
+  MatchPairFile PairFile;
+
   // TODO: this should be added to helpers
   /** A function to ignore input from a stream. */
   std::istream& MyIgnore(std::istream& ss);